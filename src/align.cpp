@@ -0,0 +1,460 @@
+#include "align.h"
+#include "arena.h"
+#include "envelope.h"
+#include "fft.h"
+#include "job_pool.h"
+#include "lod.h"
+#include "profiler.h"
+#include "timer.h"
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#if defined(_WIN32) || defined(__SSE2__)
+#include <emmintrin.h>
+#define ALIGN_SSE2
+#endif
+
+namespace {
+
+	const std::size_t MIN_POINTS = 16;			// envelope points; anything shorter isn't worth a guess
+	const std::size_t DIFFERENCE_CHUNK = 1 << 16;
+
+	struct segment {
+		int file;					// 0 the document, 1 the reference
+		std::size_t first, count;	// samples, whole blocks
+	};
+
+	struct excerpt {
+		std::size_t first;			// in the document
+		bool valid;
+		long long lag;
+		float correlation, gain;
+	};
+
+	const WavSource *sources[2] = { NULL, NULL };
+	std::size_t decimation = ALIGN_MIN_DECIMATION;
+	std::vector<float> envelopes[2];
+	std::vector<segment> segments;
+	excerpt excerpts[ALIGN_EXCERPTS];
+
+	fft_plan coarse_plan, fine_plan;
+	bool planned = false;
+
+	std::atomic<int> remaining(0);		// of the envelope jobs, then of the excerpt jobs
+	std::atomic<int> outstanding(0);	// jobs submitted and not returned yet; up before the next step's submits, so never 0 in between
+	std::atomic<bool> finished(false);
+	timer_tick_t started = 0;
+	align_result last;
+
+	// the difference, built last; the arena is only touched by that job until finished
+	Arena difference_arena(4*1024*1024);
+	lod_pyramid difference_lod;
+	std::vector<short> staging;
+
+	std::size_t nextPowerOfTwo(std::size_t n) {
+		std::size_t p = 1;
+		while (p < n) p *= 2;
+		return p;
+	}
+
+	// samples [first, first + n) of a file into out, zeros where that's outside it
+	void readSamples(const WavSource &source, long long first, std::size_t n, short *out) {
+
+		std::fill(out, out + n, (short)0);
+		const std::size_t skip = first < 0 ? (std::size_t)std::min((long long)n, -first) : 0;
+		if (skip < n) source.read((std::size_t)(first + (long long)skip), n - skip, out + skip);
+
+	}
+
+	void readSamples(const WavSource &source, long long first, std::size_t n, float *out) {
+
+		std::fill(out, out + n, 0.0f);
+		const std::size_t skip = first < 0 ? (std::size_t)std::min((long long)n, -first) : 0;
+		if (skip < n) source.read((std::size_t)(first + (long long)skip), n - skip, out + skip);
+
+	}
+
+	// mean |x| of every decimation samples of in, count a multiple of it
+	void blockMeans(const short *in, std::size_t count, float *out) {
+
+		const float scale = 1.0f/decimation;
+
+		for (std::size_t b = 0; b < count/decimation; ++b) {
+
+			const short *x = in + b*decimation;
+			std::size_t i = 0;
+			long long sum = 0;
+
+#ifdef ALIGN_SSE2
+			// |x| saturates -32768 to 32767, and pairs of them add up in 32 bits
+			const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+			__m128i acc = zero;
+			for (; i + 8 <= decimation; i += 8) {
+				const __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+				const __m128i a = _mm_max_epi16(v, _mm_subs_epi16(zero, v));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(a, ones));
+			}
+			int lanes[4];
+			_mm_storeu_si128((__m128i*)lanes, acc);
+			sum = (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+			for (; i < decimation; ++i) sum += x[i] < 0 ? -x[i] : x[i];
+			out[b] = sum*scale;
+		}
+
+	}
+
+	// document - gain*reference(sample - lag) for samples [first, first + count), saturated to int16
+	void differenceSamples(std::size_t first, std::size_t count, short *out) {
+
+		thread_local std::vector<short> other;
+		other.resize(count);
+
+		readSamples(*sources[0], (long long)first, count, out);
+		readSamples(*sources[1], (long long)first - last.lag, count, &other[0]);
+
+		const float g = last.gain;
+		std::size_t i = 0;
+
+#ifdef ALIGN_SSE2
+		const __m128 gain = _mm_set1_ps(g);
+		for (; i + 8 <= count; i += 8) {
+			const __m128i a = _mm_loadu_si128((const __m128i*)(out + i)), b = _mm_loadu_si128((const __m128i*)(&other[i]));
+			// sign extended by unpacking into the high halves and shifting back
+			const __m128 alo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16));
+			const __m128 ahi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16));
+			const __m128 blo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16));
+			const __m128 bhi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16));
+			const __m128i dlo = _mm_cvtps_epi32(_mm_sub_ps(alo, _mm_mul_ps(gain, blo)));
+			const __m128i dhi = _mm_cvtps_epi32(_mm_sub_ps(ahi, _mm_mul_ps(gain, bhi)));
+			_mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(dlo, dhi));
+		}
+#endif
+
+		for (; i < count; ++i) {
+			const float d = floorf(out[i] - g*other[i] + 0.5f);
+			out[i] = (short)(d > 32767.0f ? 32767 : (d < -32768.0f ? -32768 : d));
+		}
+
+	}
+
+	void buildDifference() {
+
+		PROFILE_ZONE("align difference");
+
+		const WavSource &document = *sources[0];
+		const std::size_t count = document.sampleCount();
+
+		// a state of its own, the main thread may be building a pyramid at the same time
+		std::vector<short> chunk(DIFFERENCE_CHUNK);
+		lod_build_state state;
+		LOD::begin(count, difference_arena, &difference_lod, &state, document.header().sampleRate);
+		for (std::size_t first = 0; first < count; first += DIFFERENCE_CHUNK) {
+			const std::size_t n = std::min(DIFFERENCE_CHUNK, count - first);
+			differenceSamples(first, n, &chunk[0]);
+			LOD::add(&difference_lod, &state, first, &chunk[0], n);
+		}
+		LOD::finish(difference_arena, &difference_lod);
+
+	}
+
+	// all excerpts are in: the lag most of them found, the best correlated one on a tie
+	void decide() {
+
+		int best = -1, best_votes = 0, valid = 0;
+		for (int i = 0; i < ALIGN_EXCERPTS; ++i) {
+			if (!excerpts[i].valid) continue;
+			++valid;
+			int votes = 0;
+			for (int j = 0; j < ALIGN_EXCERPTS; ++j) {
+				if (excerpts[j].valid && excerpts[j].lag == excerpts[i].lag) ++votes;
+			}
+			if (votes > best_votes || (votes == best_votes && fabsf(excerpts[i].correlation) > fabsf(excerpts[best].correlation))) {
+				best = i;
+				best_votes = votes;
+			}
+		}
+
+		last.excerpts = valid;
+		last.agreeing = best_votes;
+		if (best >= 0) {
+			last.lag = excerpts[best].lag;
+			last.correlation = excerpts[best].correlation;
+			last.gain = excerpts[best].gain;
+		}
+
+	}
+
+	void finish() {
+
+		decide();
+		buildDifference();
+
+		last.milliseconds = Timer::ticksToMicroSeconds(Timer::get() - started)/1000.0;
+		finished.store(true, std::memory_order_release);
+
+	}
+
+	// on a worker: one excerpt of the document against the reference around the coarse lag, at the full rate
+	void refineExcerpt(void *user) {
+
+		PROFILE_ZONE("align refine");
+
+		excerpt &e = *static_cast<excerpt*>(user);
+
+		const std::size_t n = ALIGN_EXCERPT, w = 2*decimation, m = fine_plan.n/2;
+		const long long reference_first = (long long)e.first - last.coarse_lag - (long long)w;
+
+		std::vector<float> re(m, 0.0f), im(m, 0.0f);
+		readSamples(*sources[0], (long long)e.first, n, &re[0]);
+		readSamples(*sources[1], reference_first, n + 2*w, &im[0]);
+
+		// energies: the excerpt's, and the reference's under it for every shift
+		double energy = 0.0;
+		for (std::size_t i = 0; i < n; ++i) energy += (double)re[i]*re[i];
+		std::vector<double> prefix(n + 2*w + 1, 0.0);
+		for (std::size_t i = 0; i < n + 2*w; ++i) prefix[i + 1] = prefix[i] + (double)im[i]*im[i];
+
+		FFT::correlate(fine_plan, &re[0], &im[0]);
+
+		// shift j puts reference sample reference_first + j under the excerpt's first: re[-j mod m]
+		double best = 0.0;
+		e.valid = false;
+		for (std::size_t j = 0; j <= 2*w; ++j) {
+			const double c = re[j ? m - j : 0], reference_energy = prefix[j + n] - prefix[j];
+			if (energy <= 0.0 || reference_energy <= 0.0) continue;
+			const double r = c/sqrt(energy*reference_energy);
+			if (!e.valid || fabs(r) > fabs(best)) {
+				best = r;
+				e.valid = true;
+				e.lag = (long long)e.first - (reference_first + (long long)j);
+				e.correlation = (float)r;
+				e.gain = (float)(c/reference_energy);
+			}
+		}
+
+		if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) finish();
+		outstanding.fetch_sub(1, std::memory_order_release);
+
+	}
+
+	// the loudest stretch of ALIGN_EXCERPT samples in each part of the overlap, by the document's envelope
+	void placeExcerpts() {
+
+		const long long a = std::max(0LL, last.coarse_lag);
+		const long long b = std::min((long long)sources[0]->sampleCount(), (long long)sources[1]->sampleCount() + last.coarse_lag);
+		const std::vector<float> &envelope = envelopes[0];
+		const std::size_t points = ALIGN_EXCERPT/decimation;
+
+		std::vector<double> prefix(envelope.size() + 1, 0.0);
+		for (std::size_t i = 0; i < envelope.size(); ++i) prefix[i + 1] = prefix[i] + envelope[i];
+
+		for (int i = 0; i < ALIGN_EXCERPTS; ++i) {
+
+			const long long part_first = a + (b - a)*i/ALIGN_EXCERPTS, part_last = a + (b - a)*(i + 1)/ALIGN_EXCERPTS;
+			std::size_t p0 = part_first > 0 ? (std::size_t)(part_first/(long long)decimation) : 0;
+			std::size_t p1 = part_last > 0 ? (std::size_t)(part_last/(long long)decimation) : 0;
+			p1 = std::min(p1, envelope.size());
+			p1 = p1 >= points ? std::max(p1 - points, p0) : p0;
+
+			std::size_t loudest = p0;
+			for (std::size_t p = p0; p <= p1 && p + points <= envelope.size(); ++p) {
+				if (prefix[p + points] - prefix[p] > prefix[loudest + points] - prefix[loudest]) loudest = p;
+			}
+			excerpts[i].first = loudest*decimation;
+			excerpts[i].valid = false;
+		}
+
+	}
+
+	// on whichever envelope job finishes last: the lag between the envelopes, then the excerpts
+	void correlateEnvelopes() {
+
+		PROFILE_ZONE("align coarse");
+
+		const std::vector<float> &ea = envelopes[0], &eb = envelopes[1];
+		const std::size_t m = coarse_plan.n/2;
+
+		// without their means, or the overlap itself would be what correlates best
+		double mean_a = 0.0, mean_b = 0.0;
+		for (std::size_t i = 0; i < ea.size(); ++i) mean_a += ea[i];
+		for (std::size_t i = 0; i < eb.size(); ++i) mean_b += eb[i];
+		mean_a /= ea.size();
+		mean_b /= eb.size();
+
+		std::vector<float> re(m, 0.0f), im(m, 0.0f);
+		for (std::size_t i = 0; i < ea.size(); ++i) re[i] = (float)(ea[i] - mean_a);
+		for (std::size_t i = 0; i < eb.size(); ++i) im[i] = (float)(eb[i] - mean_b);
+
+		FFT::correlate(coarse_plan, &re[0], &im[0]);
+
+		// re[t]: document point i + t against reference point i. at least a quarter of the shorter one has to overlap
+		const long long na = (long long)ea.size(), nb = (long long)eb.size(), min_overlap = std::min(na, nb)/4;
+		long long best = 0;
+		float best_c = -1e30f;
+		for (long long t = -nb + 1; t < na; ++t) {
+			const long long overlap = std::min(na, nb + t) - std::max(0LL, t);
+			if (overlap < min_overlap) continue;
+			const float c = re[t < 0 ? (std::size_t)(t + (long long)m) : (std::size_t)t];
+			if (c > best_c) {
+				best_c = c;
+				best = t;
+			}
+		}
+
+		last.coarse_lag = last.lag = best*(long long)decimation;
+
+		placeExcerpts();
+		remaining.store(ALIGN_EXCERPTS, std::memory_order_relaxed);
+		outstanding.fetch_add(ALIGN_EXCERPTS, std::memory_order_relaxed);
+		for (int i = 0; i < ALIGN_EXCERPTS; ++i) {
+			JobPool::submit(refineExcerpt, &excerpts[i]);
+		}
+
+	}
+
+	// on a worker: the envelope of one stretch of one of the files
+	void envelopeSegment(void *user) {
+
+		PROFILE_ZONE("align envelope");
+
+		const segment &s = *static_cast<segment*>(user);
+		const WavSource &source = *sources[s.file];
+		float *out = &envelopes[s.file][s.first/decimation];
+
+		if (source.direct()) {
+			blockMeans(source.direct() + s.first, s.count, out);
+		}
+		else {
+			thread_local std::vector<short> buffer;
+			const std::size_t piece = std::max(decimation, DIFFERENCE_CHUNK);
+			buffer.resize(piece);
+			for (std::size_t i = 0; i < s.count; i += piece) {
+				const std::size_t n = std::min(piece, s.count - i);
+				source.read(s.first + i, n, &buffer[0]);
+				blockMeans(&buffer[0], n, out + i/decimation);
+			}
+		}
+
+		if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) correlateEnvelopes();
+		outstanding.fetch_sub(1, std::memory_order_release);
+
+	}
+
+	const short *visibleDifference(void *, std::size_t first, std::size_t count) {
+
+		staging.resize(count);
+		differenceSamples(first, count, &staging[0]);
+		return &staging[0];
+
+	}
+
+}
+
+void Align::setSources(const WavSource *document, const WavSource *reference) {
+
+	// nothing of the old pair may still be in the works; the other owners' jobs can carry on
+	JobPool::wait(outstanding);
+
+	sources[0] = sources[1] = NULL;
+	envelopes[0].clear();
+	envelopes[1].clear();
+	segments.clear();
+	remaining = 0;
+	finished = false;
+	last = align_result();
+	last.gain = 1.0f;
+	difference_lod = lod_pyramid();
+	difference_arena.reset();
+	std::vector<short>().swap(staging);
+
+	if (planned) {
+		FFT::release(&coarse_plan);
+		FFT::release(&fine_plan);
+		planned = false;
+	}
+
+	if (!document || !reference) return;
+
+	sources[0] = document;
+	sources[1] = reference;
+
+	const std::size_t longest = std::max(document->sampleCount(), reference->sampleCount());
+	decimation = ALIGN_MIN_DECIMATION;
+	while (longest/decimation > ALIGN_COARSE_POINTS) decimation *= 2;
+	last.decimation = decimation;
+
+	const std::size_t na = document->sampleCount()/decimation, nb = reference->sampleCount()/decimation;
+	if (na < MIN_POINTS || nb < MIN_POINTS) {
+		printf("Align: too short to line up.\n");
+		finished = true;
+		return;
+	}
+
+	// plans are for n real points, the correlations use n/2 complex ones
+	const std::size_t coarse_n = std::max(FFT_MIN_SIZE, 2*nextPowerOfTwo(na + nb));
+	const std::size_t fine_n = std::max(FFT_MIN_SIZE, 2*nextPowerOfTwo(2*ALIGN_EXCERPT + 4*decimation));
+	planned = FFT::plan(coarse_n, &coarse_plan);
+	if (planned && !FFT::plan(fine_n, &fine_plan)) {
+		FFT::release(&coarse_plan);
+		planned = false;
+	}
+	if (!planned) {
+		printf("Align: no FFT plan for %u points.\n", (unsigned)coarse_n);
+		finished = true;
+		return;
+	}
+
+	envelopes[0].assign(na, 0.0f);
+	envelopes[1].assign(nb, 0.0f);
+
+	// whole blocks only, the tail of a file is left out
+	const std::size_t segment_size = std::max(ALIGN_SEGMENT, decimation);
+	for (int f = 0; f < 2; ++f) {
+		const std::size_t count = envelopes[f].size()*decimation;
+		for (std::size_t first = 0; first < count; first += segment_size) {
+			const segment s = { f, first, std::min(segment_size, count - first) };
+			segments.push_back(s);
+		}
+	}
+
+	// all of them before the first submit, the vector doesn't move after that
+	last.found = true;
+	started = Timer::get();
+	remaining = (int)segments.size();
+	outstanding = (int)segments.size();
+	for (std::size_t i = 0; i < segments.size(); ++i) {
+		JobPool::submit(envelopeSegment, &segments[i]);
+	}
+
+}
+
+bool Align::ready() {
+	return finished.load(std::memory_order_acquire);
+}
+
+void Align::wait() {
+
+	if (!sources[0]) return;
+	JobPool::wait(outstanding);
+
+}
+
+const align_result &Align::result() {
+	return last;
+}
+
+bool Align::difference(double first_sample, double samples_per_column, std::size_t columns, short *mins, short *maxs) {
+
+	if (!ready() || !last.found) return false;
+
+	Envelope::reduce(visibleDifference, NULL, sources[0]->sampleCount(), difference_lod, first_sample, samples_per_column,
+					 columns, mins, maxs);
+	return true;
+
+}
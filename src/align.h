@@ -0,0 +1,58 @@
+#ifndef ALIGN_H
+#define ALIGN_H
+
+#include <cstddef>
+
+#include "wav_source.h"
+
+// Where a second file (the reference, say the take before processing)
+// lines up with the open one, worked out on the job pool. First both files
+// are cut into ALIGN_SEGMENT sample jobs that reduce them to envelopes, the
+// mean absolute value of every `decimation` samples (SSE2), with the
+// decimation picked so neither is over ALIGN_COARSE_POINTS long. The two
+// envelopes are cross-correlated in one FFT (fft.h, packed as the real and
+// imaginary parts), which gives the lag to within a block or so. Then
+// ALIGN_EXCERPTS stretches of ALIGN_EXCERPT samples, the loudest in each
+// part of the overlap, are correlated again at the full rate, one job each,
+// over two blocks either side of that; the lag most of them agree on wins.
+// Last, a pyramid of the difference (document minus the reference, moved
+// by the lag and matched in gain) is built for drawing.
+
+static const std::size_t ALIGN_COARSE_POINTS = 1 << 19;
+static const std::size_t ALIGN_MIN_DECIMATION = 64;
+static const std::size_t ALIGN_SEGMENT = 1 << 21;		// samples per envelope job
+static const std::size_t ALIGN_EXCERPT = 1 << 15;
+static const int ALIGN_EXCERPTS = 4;
+
+struct align_result {
+	bool found;				// false if either file is too short to go by
+	long long lag;			// reference sample r lines up with document sample r + lag
+	long long coarse_lag;	// what the envelopes said
+	std::size_t decimation;	// samples per envelope point
+	float correlation;		// normalized, at the lag, in the excerpt that decided it; negative for flipped polarity
+	float gain;				// the reference times this matches the document best (least squares)
+	int agreeing;			// excerpts that found the lag,
+	int excerpts;			// out of the ones that had anything in them
+	double milliseconds;	// from setSources() to the difference pyramid done
+};
+
+namespace Align {
+
+	// waits for the jobs still reading the old pair, then queues the new one's. NULL for either drops it.
+	void setSources(const WavSource *document, const WavSource *reference);
+
+	// true once everything including the difference pyramid is done
+	bool ready();
+
+	// until ready(), for the headless run
+	void wait();
+
+	// of the last ready() pair
+	const align_result &result();
+
+	// min/max of document - gain*reference(sample - lag) per column, like Envelope::reduce; false until ready()
+	bool difference(double first_sample, double samples_per_column, std::size_t columns, short *mins, short *maxs);
+
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "arena.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+	static const std::size_t huge_page_size = 2*1024*1024;
+
+	std::size_t roundUp(std::size_t n, std::size_t to) {
+		return (n + to - 1) / to * to;
+	}
+
+}
+
+Arena::Arena(std::size_t region_size_, bool huge_pages_)
+	: current(0), region_size(region_size_), huge_pages(huge_pages_) {
+	memset(used_by, 0, sizeof(used_by));
+}
+
+Arena::~Arena() {
+	release();
+}
+
+Arena::region Arena::mapRegion(std::size_t bytes) {
+
+	region r;
+	r.base = NULL;
+	r.offset = 0;
+
+#ifdef _WIN32
+
+	r.size = roundUp(bytes, 64*1024);
+	r.base = (char*)VirtualAlloc(NULL, r.size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+#elif __linux__
+
+	const bool huge = huge_pages && bytes >= huge_page_size;
+	r.size = roundUp(bytes, huge ? huge_page_size : 4096);
+
+	if (!huge) {
+		void *p = mmap(NULL, r.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		r.base = (p == MAP_FAILED) ? NULL : (char*)p;
+	}
+	else {
+		// over-map by a huge page and trim, so the region starts on a 2 MiB boundary
+		void *p = mmap(NULL, r.size + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p != MAP_FAILED) {
+			char *raw = (char*)p;
+			char *aligned = (char*)roundUp((std::size_t)raw, huge_page_size);
+			if (aligned > raw) munmap(raw, aligned - raw);
+			const std::size_t tail = (raw + r.size + huge_page_size) - (aligned + r.size);
+			if (tail) munmap(aligned + r.size, tail);
+
+			madvise(aligned, r.size, MADV_HUGEPAGE);	// just a hint, fine if THP is off
+			r.base = aligned;
+		}
+	}
+
+#endif
+
+	if (!r.base) {
+		printf("Arena: couldn't map a %u KiB region.\n", (unsigned)(r.size/1024));
+		throw std::bad_alloc();
+	}
+
+	return r;
+
+}
+
+void Arena::unmapRegion(region &r) {
+
+#ifdef _WIN32
+	VirtualFree(r.base, 0, MEM_RELEASE);
+#elif __linux__
+	munmap(r.base, r.size);
+#endif
+	r.base = NULL;
+
+}
+
+void *Arena::allocate(int subsystem, std::size_t bytes) {
+
+	// regions past the current one are empty (after a rewind/reset), take the first that fits
+	for (; current < regions.size(); ++current) {
+		region &r = regions[current];
+		const std::size_t begin = roundUp(r.offset, alignment);
+		if (begin + bytes <= r.size) {
+			r.offset = begin + bytes;
+			used_by[subsystem] += bytes;
+			MemStats::hostAllocated(subsystem, bytes);
+			return r.base + begin;
+		}
+	}
+
+	regions.push_back(mapRegion(bytes > region_size ? bytes : region_size));
+	current = regions.size() - 1;
+
+	region &r = regions[current];
+	r.offset = bytes;
+	used_by[subsystem] += bytes;
+	MemStats::hostAllocated(subsystem, bytes);
+
+	return r.base;
+
+}
+
+Arena::marker Arena::mark() const {
+
+	marker m;
+	m.region = current;
+	m.offset = current < regions.size() ? regions[current].offset : 0;
+	memcpy(m.used, used_by, sizeof(used_by));
+	return m;
+
+}
+
+void Arena::rewind(const marker &m) {
+
+	for (std::size_t i = m.region + 1; i < regions.size(); ++i) {
+		regions[i].offset = 0;
+	}
+	if (m.region < regions.size()) {
+		regions[m.region].offset = m.offset;
+	}
+	current = m.region;
+
+	for (int s = 0; s < MEM_SUBSYSTEM_COUNT; ++s) {
+		MemStats::hostReleased(s, used_by[s] - m.used[s]);
+		used_by[s] = m.used[s];
+	}
+
+}
+
+void Arena::reset() {
+
+	marker empty;
+	empty.region = 0;
+	empty.offset = 0;
+	memset(empty.used, 0, sizeof(empty.used));
+	rewind(empty);
+
+}
+
+void Arena::release() {
+
+	reset();
+	for (std::size_t i = 0; i < regions.size(); ++i) {
+		unmapRegion(regions[i]);
+	}
+	regions.clear();
+
+}
+
+std::size_t Arena::used() const {
+
+	std::size_t n = 0;
+	for (int s = 0; s < MEM_SUBSYSTEM_COUNT; ++s) {
+		n += used_by[s];
+	}
+	return n;
+
+}
+
+std::size_t Arena::reserved() const {
+
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < regions.size(); ++i) {
+		n += regions[i].size;
+	}
+	return n;
+
+}
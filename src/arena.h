@@ -0,0 +1,83 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "mem_stats.h"
+
+// Bump allocator for everything that lives exactly as long as an open
+// document: the samples, and the staging vertices of the bake. Blocks are
+// 64-byte aligned (cache line, and plenty for _mm_load_ps), carved out of
+// big regions that are kept mapped across reset(), so reopening a file
+// doesn't go back to the OS at all. mark()/rewind() drop just the staging
+// data once it's been uploaded.
+//
+// With huge_pages, regions of 2 MiB and up are 2 MiB aligned and
+// madvise(MADV_HUGEPAGE)d on linux. Windows large pages need the
+// SeLockMemoryPrivilege, so the flag is ignored there.
+//
+// Not thread safe; the document arena is only touched from the main thread.
+
+class Arena {
+
+public:
+
+	static const std::size_t alignment = 64;
+
+	struct marker {
+		std::size_t region;
+		std::size_t offset;
+		std::size_t used[MEM_SUBSYSTEM_COUNT];
+	};
+
+	explicit Arena(std::size_t region_size = 16*1024*1024, bool huge_pages = false);
+	~Arena();
+
+	void *allocate(int subsystem, std::size_t bytes);
+
+	// as with MemStats::allocArray, only for the plain vertex/sample structs
+	template <typename T>
+	T *allocArray(int subsystem, std::size_t count) {
+		T *p = static_cast<T*>(allocate(subsystem, count*sizeof(T)));
+		for (std::size_t i = 0; i < count; ++i) {
+			new (p + i) T;
+		}
+		return p;
+	}
+
+	marker mark() const;
+	void rewind(const marker &m);
+
+	// forgets every allocation, keeps the regions
+	void reset();
+	// gives the regions back to the OS
+	void release();
+
+	std::size_t used() const;
+	std::size_t reserved() const;
+
+private:
+
+	struct region {
+		char *base;
+		std::size_t size;
+		std::size_t offset;
+	};
+
+	Arena(const Arena&);
+	Arena &operator=(const Arena&);
+
+	region mapRegion(std::size_t bytes);
+	void unmapRegion(region &r);
+
+	std::vector<region> regions;
+	std::size_t current;
+	std::size_t region_size;
+	bool huge_pages;
+	std::size_t used_by[MEM_SUBSYSTEM_COUNT];
+
+};
+
+#endif
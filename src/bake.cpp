@@ -0,0 +1,295 @@
+#include "bake.h"
+#include "profiler.h"
+#include "mem_stats.h"
+
+#include <cmath>
+
+// The drawback of this algorithm is that some of the
+// really "tight turns" in the waveform produce unwanted artifacts.
+
+triangle *bakeWaveVertexArrayUsingLineIntersections(float* samples, const std::size_t& samplecount, Arena &arena) {
+	
+	const std::size_t triangle_count = 2*samplecount-1;
+	triangle* triangles = arena.allocArray<triangle>(MEM_BAKE, triangle_count);
+
+	static const float h = half_linewidth;
+
+	float x1 = 0.0;
+	float y1 = half_WIN_H*samples[0] + half_WIN_H;
+
+	float x2 = x1 + dx;
+	float y2 = half_WIN_H*samples[1] + half_WIN_H;
+
+	float x3 = x2 + dx;
+	float y3 = half_WIN_H*samples[2] + half_WIN_H;
+
+	float k1 = (y2-y1)/dx;
+	float alpha_1 = atan(k1);
+	
+	float k2 = (y3-y2)/dx;
+	float alpha_2 = atan(k2);
+
+	float px_2 = h*sin(alpha_1);
+	float py_2 = h*cos(alpha_1);
+
+	triangles[0].v1 = vertex(x2+px_2, WIN_H - (y2-py_2), 1.0, 0.0);
+	triangles[0].v2 = vertex(x2-px_2, WIN_H - (y2+py_2), 1.0, 1.0);
+	triangles[0].v3 = vertex(x1, y1, 0.0, 0.5);
+	
+	int i = 1, j = 1;
+
+	float x2_c, y2_c;
+	float dk;
+	float px_3, py_3;
+	float res_x2_1, res_y2_1, res_x2_2, res_y2_2;
+
+	while (i < triangle_count - 1) 
+	{
+		//    y - y0 = k(x - x0)
+		// =>      y = k(x - x0) + y0
+
+		x1 = x2; y1 = y2;
+		x2 = x3; y2 = y3;
+		x3 = x2+dx;
+		y3 = half_WIN_H*samples[j+2] + half_WIN_H;
+
+		k1 = (y2-y1)/dx;	// dx = constant
+		alpha_1 = atan(k1);	// can be copied from previous result
+							// also, this temporary isn't necessary
+	
+		k2 = (y3-y2)/dx;
+		alpha_2 = atan(k2);
+
+		px_2 = h*sin(alpha_1);
+		py_2 = h*cos(alpha_1);
+		
+		px_3 = h*sin(alpha_2);
+		py_3 = h*cos(alpha_2);
+
+		dk = k1-k2;
+
+		if (fabs(dk) < 0.3) {
+
+			res_x2_1 = x2 - px_2;
+			res_y2_1 = y2 + py_2;
+
+			res_x2_2 = x2 + px_2;
+			res_y2_2 = y2 - py_2;
+
+		}
+
+		else {
+			
+			x2_c = (x2 - px_2);
+			y2_c = (y2 + py_2);
+			
+			res_x2_1 = (k1*x2_c - y2_c - k2*(x3-px_3) + (y3+py_3))/dk;
+			res_y2_1 = k1*(res_x2_1 - x2_c) + y2_c;
+		
+			x2_c = (x2 + px_2);
+			y2_c = (y2 - py_2);
+
+			res_x2_2 = (k1*x2_c - y2_c - k2*(x3+px_3) + (y3-py_3))/dk;
+			res_y2_2 = k1*(res_x2_2 - x2_c) + y2_c;
+		
+		}
+		
+		// invert computed y values
+
+		res_y2_1 = (WIN_H - res_y2_1);
+		res_y2_2 = (WIN_H - res_y2_2);	
+	
+		triangles[i].v1 = triangles[i-1].v2;
+		triangles[i].v2 = triangles[i-1].v1;
+		triangles[i].v3 = vertex(res_x2_1, res_y2_1, 1.0, 1.0);
+
+		triangles[i+1].v1 = vertex(res_x2_2, res_y2_2, 1.0, 0.0);
+		triangles[i+1].v2 = triangles[i].v3;
+		triangles[i+1].v3 = triangles[i].v2;
+		
+		++j;
+		i += 2;
+
+	}
+
+	triangles[triangle_count-1].v1 = triangles[triangle_count-2].v2;	
+	triangles[triangle_count-1].v2 = triangles[triangle_count-2].v1;	
+	triangles[triangle_count-1].v3 = vertex(triangles[triangle_count-2].v1.x()+dx, half_WIN_H*samples[samplecount-1] + half_WIN_H, 1.0, 0.5);
+
+	return triangles;
+}
+
+
+// y = scale*sample + half_WIN_H; the scale folds in the int16 normalization
+template <typename S>
+static vertex* bakeVertexBuffer(const S* samples, const std::size_t& samplecount, Arena &arena, const float scale) {
+	
+	const std::size_t vertex_count = 2*samplecount-2;
+	vertex* vertices = arena.allocArray<vertex>(MEM_BAKE, vertex_count);
+	static const float h = half_linewidth;
+
+	float x1 = 0.0;
+	float y1 = scale*samples[0] + half_WIN_H;
+
+	float x2 = x1 + dx;
+	float y2 = scale*samples[1] + half_WIN_H;
+
+	float x3 = x2 + dx;
+	float y3 = scale*samples[2] + half_WIN_H;
+
+	float k1 = (y2-y1)/dx;
+	float alpha_1 = atan(k1);
+	
+	float k2 = (y3-y2)/dx;
+	float alpha_2 = atan(k2);
+
+	float px_2 = h*sin(alpha_2);
+	float py_2 = h*cos(alpha_2);
+
+	// special case
+	vertices[0] = vertex(x1, WIN_H - y1, 0.0, 0.5);
+	vertices[2] = vertex(x2+px_2, WIN_H - (y2-py_2), 0.0, 0.0);
+	vertices[1] = vertex(x2-px_2, WIN_H - (y2+py_2), 0.0, 1.0);
+		
+	int i = 3, j = 3;
+	
+	float alpha_3 = atan(((scale*samples[3] + half_WIN_H)-y3)/dx);
+	float x2_c, y2_c;
+	float dk;
+	float px_3 = h*sin(alpha_3), py_3 = h*cos(alpha_3);
+	float res_x2_1, res_y2_1, res_x2_2, res_y2_2;
+
+	while (i < vertex_count - 1) 
+	{
+		//    y - y0 = k(x - x0)
+		// =>      y = k(x - x0) + y0
+
+		x1 = x2; y1 = y2;
+		x2 = x3; y2 = y3;
+		x3 = x2+dx;
+		y3 = scale*samples[j] + half_WIN_H;
+
+		//k1 = (y2-y1)/dx;	// dx = constant
+		k1 = k2;
+		alpha_1 = alpha_2;	// can be copied from previous result
+							// also, this temporary isn't necessary
+	
+		k2 = (y3-y2)/dx;
+		alpha_2 = atan(k2);
+
+		//px_2 = h*sin(alpha_1);
+		//py_2 = h*cos(alpha_1);
+		
+		px_2 = px_3;
+		py_2 = py_3;
+
+		px_3 = h*sin(alpha_2);
+		py_3 = h*cos(alpha_2);
+
+		dk = k1-k2;
+
+		if (fabs(dk) < 0.3) {
+
+			res_x2_1 = x2 - px_2;
+			res_y2_1 = y2 + py_2;
+
+			res_x2_2 = x2 + px_2;
+			res_y2_2 = y2 - py_2;
+
+		}
+
+		else {
+			
+			// calculate line intersections
+			
+			//    y - y0 = k(x - x0)
+			// =>      y = k(x - x0) + y0
+			
+			//	  set y1 = y2 
+			// => k1(x - x1) + y01 = k2(x - x2) + y02
+			//
+			// solving for x yields:
+			// x = (k1x1 - y01 - k2x2 + y02)/(k1 - k2).
+			// then solve for y.
+
+			x2_c = (x2 - px_2);
+			y2_c = (y2 + py_2);
+			
+			res_x2_1 = (k1*x2_c - y2_c - k2*(x3-px_3) + (y3+py_3))/dk;
+			res_y2_1 = k1*(res_x2_1 - x2_c) + y2_c;
+		
+			x2_c = (x2 + px_2);
+			y2_c = (y2 - py_2);
+
+			res_x2_2 = (k1*x2_c - y2_c - k2*(x3+px_3) + (y3-py_3))/dk;
+			res_y2_2 = k1*(res_x2_2 - x2_c) + y2_c;
+		
+		}
+		
+		// invert computed y values
+
+		res_y2_1 = (WIN_H - res_y2_1);
+		res_y2_2 = (WIN_H - res_y2_2);	
+	
+		vertices[i] = vertex(res_x2_1, res_y2_1, 1.0, 1.0); 
+		vertices[i+1] = vertex(res_x2_2, res_y2_2, 1.0, 0.0);
+		
+		
+		++j;
+		i += 2;
+
+	}
+	// these are still bugged
+	vertices[vertex_count-2] = vertex(30000, 0, 0, 0);
+	vertices[vertex_count-1] = vertex(vertices[vertex_count-2].x()+dx, scale*samples[samplecount-1] + half_WIN_H, 1.0, 0.5);
+
+	return vertices;
+
+}
+
+vertex* bakeWaveVertexBufferUsingLineIntersections(const float* samples, const std::size_t& samplecount, Arena &arena) {
+	return bakeVertexBuffer(samples, samplecount, arena, half_WIN_H);
+}
+
+vertex* bakeWaveVertexBufferUsingLineIntersections(const short* samples, const std::size_t& samplecount, Arena &arena) {
+	return bakeVertexBuffer(samples, samplecount, arena, half_WIN_H/32768.0f);
+}
+
+
+GLuint *generateIndexBufferWithSharedVertices() {
+
+	PROFILE_ZONE("index");
+
+	// just use BUFSIZE_MAX :D
+	GLuint *indexBuffer = MemStats::allocArray<GLuint>(MEM_INDEX, BUFSIZE_MAX);
+
+	indexBuffer[0] = 0;
+	indexBuffer[1] = 2;
+	indexBuffer[2] = 1;
+
+	int i = 3, j = 1;
+
+	while (i < BUFSIZE_MAX - 6) {
+
+		// 1, 2, 3, 4, 3, 2
+
+		indexBuffer[i] = j;
+		indexBuffer[i+1] = j+1;
+		indexBuffer[i+2] = j+2;
+
+		indexBuffer[i+3] = j+3;
+		indexBuffer[i+4] = j+2;
+		indexBuffer[i+5] = j+1;
+
+		i += 6;
+		j += 2;
+
+	}
+	// this is probably wrong
+	indexBuffer[i] = j;
+	indexBuffer[i+1] = j+1;
+	indexBuffer[i+2] = j+2;
+
+	return indexBuffer;
+
+}
@@ -0,0 +1,21 @@
+#ifndef BAKE_H
+#define BAKE_H
+
+#include "definitions.h"
+#include "arena.h"
+
+static float half_WIN_H = (float) WIN_H / 2.0;
+
+static float linewidth = 1.8; 
+static float half_linewidth = linewidth/2.0;
+
+static const double dx = 1.0/4.0;	// horizontal distance between two consecutive samples, in pixels
+
+// the baked arrays are staging data, allocated from the given arena
+triangle *bakeWaveVertexArrayUsingLineIntersections(float* samples, const std::size_t& samplecount, Arena &arena);
+vertex* bakeWaveVertexBufferUsingLineIntersections(const float* samples, const std::size_t& samplecount, Arena &arena);
+vertex* bakeWaveVertexBufferUsingLineIntersections(const short* samples, const std::size_t& samplecount, Arena &arena);
+
+GLuint *generateIndexBufferWithSharedVertices();
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * bench.cpp - micro-benchmarks for the load and bake hot paths.
+ *
+ * Generates synthetic 16-bit WAV files of a few sizes and channel counts,
+ * then times each stage with warmup runs and repetitions. Results are
+ * written as JSON (percentiles in milliseconds) so runs can be diffed.
+ *
+ * Then writes one long mono file (a hundred million samples, 200 MB, unless
+ * -q says otherwise; 0 skips it) and times RangeStats::query on random ranges of it.
+ *
+ * usage: waveplot_bench [-r reps] [-w warmups] [-q query_samples] [-o results.json]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "utils.h"
+#include "bake.h"
+#include "timer.h"
+#include "mem_stats.h"
+#include "arena.h"
+#include "lod.h"
+#include "fft.h"
+#include "wav_source.h"
+#include "range_stats.h"
+
+#pragma warning(disable:4996)
+
+namespace {
+
+	struct bench_result {
+		std::string name;
+		std::size_t samples;
+		int channels;
+		std::vector<double> ms;
+	};
+
+	int reps = 20;
+	int warmups = 3;
+
+	void write32(FILE *fp, unsigned int v) { fwrite(&v, 4, 1, fp); }
+	void write16(FILE *fp, unsigned short v) { fwrite(&v, 2, 1, fp); }
+
+	// a canonical 44-byte header followed by a sine sweep with some noise on top,
+	// so the bake doesn't just see flat lines
+	bool writeSyntheticWAV(const std::string &filename, std::size_t num_samples, int channels) {
+
+		FILE *fp = fopen(filename.c_str(), "wb");
+		if (!fp) {
+			printf("bench: couldn't create %s\n", filename.c_str());
+			return false;
+		}
+
+		const unsigned int rate = 44100;
+		const unsigned int data_size = num_samples*2;
+
+		fwrite("RIFF", 1, 4, fp);
+		write32(fp, 36 + data_size);
+		fwrite("WAVEfmt ", 1, 8, fp);
+		write32(fp, 16);
+		write16(fp, 1);		// PCM
+		write16(fp, channels);
+		write32(fp, rate);
+		write32(fp, rate*channels*2);
+		write16(fp, channels*2);
+		write16(fp, 16);
+		fwrite("data", 1, 4, fp);
+		write32(fp, data_size);
+
+		// a chunk at a time, the query file doesn't fit in memory twice
+		std::vector<short> data(std::min(num_samples, (std::size_t)1 << 20));
+		unsigned int seed = 12345;
+		for (std::size_t first = 0; first < num_samples; first += data.size()) {
+			const std::size_t n = std::min(data.size(), num_samples - first);
+			for (std::size_t k = 0; k < n; ++k) {
+				const std::size_t i = first + k;
+				const double t = double(i/channels)/rate;
+				seed = seed*1103515245 + 12345;
+				const double noise = double((seed >> 16) & 0x7FFF)/32768.0 - 0.5;
+				data[k] = (short)(20000.0*sin(2*M_PI*(110.0 + 40.0*t)*t) + 2000.0*noise);
+			}
+			fwrite(&data[0], 2, n, fp);
+		}
+		fclose(fp);
+
+		return true;
+	}
+
+	double percentile(const std::vector<double> &sorted, double p) {
+		const std::size_t i = (std::size_t)(p*(sorted.size()-1) + 0.5);
+		return sorted[i];
+	}
+
+	// setup and teardown run outside the timed region
+	bench_result run(const std::string &name, std::size_t samples, int channels,
+			const std::function<void()> &setup, const std::function<void()> &body, const std::function<void()> &teardown) {
+
+		bench_result r;
+		r.name = name;
+		r.samples = samples;
+		r.channels = channels;
+
+		for (int i = 0; i < warmups + reps; ++i) {
+			setup();
+			const timer_tick_t t0 = Timer::get();
+			body();
+			const timer_tick_t t1 = Timer::get();
+			teardown();
+
+			if (i >= warmups) {
+				r.ms.push_back(Timer::ticksToMicroSeconds(t1 - t0)/1000.0);
+			}
+		}
+
+		std::vector<double> sorted(r.ms);
+		std::sort(sorted.begin(), sorted.end());
+		printf("%-48s %9u samples, %d ch: p50 %9.3f ms  p90 %9.3f ms\n",
+			name.c_str(), (unsigned)samples, channels, percentile(sorted, 0.5), percentile(sorted, 0.9));
+
+		return r;
+	}
+
+	void nop() {}
+
+	bool writeJSON(const std::string &filename, const std::vector<bench_result> &results) {
+
+		FILE *fp = fopen(filename.c_str(), "w");
+		if (!fp) {
+			printf("bench: couldn't open %s for writing.\n", filename.c_str());
+			return false;
+		}
+
+		fprintf(fp, "{\"reps\":%d,\"warmup\":%d,\"benchmarks\":[\n", reps, warmups);
+
+		for (std::size_t i = 0; i < results.size(); ++i) {
+			const bench_result &r = results[i];
+			std::vector<double> sorted(r.ms);
+			std::sort(sorted.begin(), sorted.end());
+
+			double sum = 0;
+			for (std::size_t j = 0; j < sorted.size(); ++j) sum += sorted[j];
+
+			fprintf(fp, "%s{\"name\":\"%s\",\"samples\":%u,\"channels\":%d,"
+				"\"min_ms\":%.4f,\"mean_ms\":%.4f,\"p50_ms\":%.4f,\"p90_ms\":%.4f,\"p99_ms\":%.4f,\"max_ms\":%.4f}",
+				i ? ",\n" : "", r.name.c_str(), (unsigned)r.samples, r.channels,
+				sorted.front(), sum/sorted.size(), percentile(sorted, 0.5), percentile(sorted, 0.9),
+				percentile(sorted, 0.99), sorted.back());
+		}
+
+		fprintf(fp, "\n]}\n");
+		fclose(fp);
+
+		return true;
+	}
+
+}
+
+int main(int argc, char *argv[]) {
+
+	std::string output_filename("bench_results.json");
+	std::size_t query_samples = 100000000;
+
+	for (int i = 1; i < argc - 1; ++i) {
+		if (!strcmp(argv[i], "-r")) reps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-w")) warmups = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o")) output_filename = argv[++i];
+		else if (!strcmp(argv[i], "-q")) query_samples = (std::size_t)atof(argv[++i]);
+	}
+
+	if (reps < 1) reps = 1;
+
+	if (!Timer::init()) {
+		return 1;
+	}
+
+	// total sample counts (all channels); the largest one is right at
+	// readSampleData_int16's FILE_MAX cap
+	static const std::size_t sizes[] = { 1 << 16, 1 << 18, 1 << 20, (1 << 23) - 22 };
+	static const int channel_counts[] = { 1, 2 };
+
+	std::vector<bench_result> results;
+
+	// same setup as the document arena in waveplot.cpp; kept mapped over the whole run
+	Arena arena(16*1024*1024, true);
+
+	for (std::size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+		for (std::size_t c = 0; c < sizeof(channel_counts)/sizeof(channel_counts[0]); ++c) {
+
+			const std::size_t n = sizes[s];
+			const int ch = channel_counts[c];
+
+			char fnbuf[64];
+			sprintf(fnbuf, "bench_tmp_%u_%d.wav", (unsigned)n, ch);
+			const std::string filename(fnbuf);
+
+			if (!writeSyntheticWAV(filename, n, ch)) {
+				return 1;
+			}
+
+			std::ifstream input(filename.c_str(), std::ios::binary);
+			float *samples = NULL;
+			std::size_t num_samples = 0;
+
+			results.push_back(run("readSampleData_int16", n, ch,
+				nop,
+				[&]() { samples = readSampleData_int16(input, &num_samples, arena); },
+				[&]() { arena.reset(); samples = NULL; input.clear(); }));
+
+			short *native = NULL;
+			results.push_back(run("readSampleDataNative_int16", n, ch,
+				nop,
+				[&]() { native = readSampleDataNative_int16(input, &num_samples, arena); },
+				[&]() { arena.reset(); native = NULL; input.clear(); }));
+
+			if (ch == 2) {
+				// downMixStereoToMono works in place, so hand it a fresh copy every time
+				std::vector<float> stereo(n);
+				for (std::size_t i = 0; i < n; ++i) stereo[i] = float(i % 65536)/32768.0f - 1.0f;
+
+				float *in = NULL;
+				results.push_back(run("downMixStereoToMono", n, ch,
+					[&]() { in = arena.allocArray<float>(MEM_CONVERT, n); memcpy(in, &stereo[0], n*sizeof(float)); },
+					[&]() { downMixStereoToMono(in, n); },
+					[&]() { arena.reset(); in = NULL; }));
+			}
+			else {
+				// the bakes only ever see mono data
+				samples = readSampleData_int16(input, &num_samples, arena);
+				const Arena::marker staging = arena.mark();
+				const std::size_t bake_count = std::min(num_samples, (std::size_t)BUFSIZE_MAX);
+
+				vertex *vertices = NULL;
+				results.push_back(run("bakeWaveVertexBufferUsingLineIntersections", bake_count, 1,
+					nop,
+					[&]() { vertices = bakeWaveVertexBufferUsingLineIntersections(samples, bake_count, arena); },
+					[&]() { arena.rewind(staging); vertices = NULL; }));
+
+				triangle *triangles = NULL;
+				results.push_back(run("bakeWaveVertexArrayUsingLineIntersections", bake_count, 1,
+					nop,
+					[&]() { triangles = bakeWaveVertexArrayUsingLineIntersections(samples, bake_count, arena); },
+					[&]() { arena.rewind(staging); triangles = NULL; }));
+
+				arena.reset();
+
+				native = readSampleDataNative_int16(input, &num_samples, arena);
+				const Arena::marker native_staging = arena.mark();
+
+				lod_pyramid lod;
+				results.push_back(run("LOD::build", num_samples, 1,
+					nop,
+					[&]() { LOD::build(native, num_samples, arena, &lod); },
+					[&]() { arena.rewind(native_staging); }));
+
+				results.push_back(run("bakeWaveVertexBufferUsingLineIntersections_int16", bake_count, 1,
+					nop,
+					[&]() { vertices = bakeWaveVertexBufferUsingLineIntersections(native, bake_count, arena); },
+					[&]() { arena.rewind(native_staging); vertices = NULL; }));
+
+				// the spectrogram's columns at its default size, on one thread
+				const std::size_t fft_n = 1024, fft_hop = fft_n/4;
+				fft_plan plan;
+				FFT::plan(fft_n, &plan);
+				std::vector<float> frame(fft_n), power(fft_n/2 + 1), scratch(FFT::scratchSize(fft_n));
+
+				results.push_back(run("FFT::power 1024, hop 256", num_samples, 1,
+					nop,
+					[&]() {
+						for (std::size_t i = 0; i + fft_n <= num_samples; i += fft_hop) {
+							for (std::size_t k = 0; k < fft_n; ++k) frame[k] = native[i + k]*(1.0f/32768.0f);
+							FFT::power(plan, &frame[0], &power[0], &scratch[0]);
+						}
+					},
+					nop));
+
+				FFT::release(&plan);
+
+				arena.reset();
+			}
+
+			input.close();
+			remove(filename.c_str());
+		}
+	}
+
+	// always BUFSIZE_MAX entries, independent of the input
+	GLuint *indices = NULL;
+	results.push_back(run("generateIndexBufferWithSharedVertices", BUFSIZE_MAX, 1,
+		nop,
+		[&]() { indices = generateIndexBufferWithSharedVertices(); },
+		[&]() { MemStats::release(indices); indices = NULL; }));
+
+	// range queries over a long file: lengths spread evenly over the orders of magnitude
+	if (query_samples) {
+
+		const std::string filename("bench_tmp_query.wav");
+		if (!writeSyntheticWAV(filename, query_samples, 1)) {
+			return 1;
+		}
+
+		WavSource source;
+		if (!source.open(filename)) {
+			return 1;
+		}
+
+		Arena lod_arena;
+		lod_pyramid lod;
+		LOD::build(source.direct(), source.sampleCount(), lod_arena, &lod);
+
+		const std::size_t num_samples = source.sampleCount();
+		static const std::size_t queries = 100000;
+		std::vector<std::size_t> firsts(queries), lasts(queries);
+		unsigned int seed = 4321;
+		for (std::size_t q = 0; q < queries; ++q) {
+			seed = seed*1103515245 + 12345;
+			const double u = double((seed >> 8) & 0xFFFFFF)/0x1000000;
+			seed = seed*1103515245 + 12345;
+			const double v = double((seed >> 8) & 0xFFFFFF)/0x1000000;
+			const std::size_t length = std::min((std::size_t)pow((double)num_samples, v) + 1, num_samples);
+			firsts[q] = (std::size_t)(u*(num_samples - length));
+			lasts[q] = firsts[q] + length;	// never past the end, the app doesn't ask for that either
+		}
+
+		volatile float sink = 0.0f;	// keeps the queries from being optimized away
+		bench_result r = run("RangeStats::query x100000", query_samples, 1,
+			nop,
+			[&]() {
+				range_stats stats;
+				for (std::size_t q = 0; q < queries; ++q) {
+					RangeStats::query(source, lod, firsts[q], lasts[q], &stats);
+					sink = stats.rms;
+				}
+			},
+			nop);
+		results.push_back(r);
+
+		std::vector<double> sorted(r.ms);
+		std::sort(sorted.begin(), sorted.end());
+		printf("%-48s %9.2f M queries/s at p50\n", "RangeStats::query", queries/percentile(sorted, 0.5)/1000.0);
+
+		source.close();
+		remove(filename.c_str());
+	}
+
+	if (!writeJSON(output_filename, results)) {
+		return 1;
+	}
+	printf("bench: results written to %s\n", output_filename.c_str());
+
+	return 0;
+
+}
@@ -0,0 +1,77 @@
+#include "clip_index.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+	std::vector<clip_region> regions;
+	std::size_t clipped = 0;
+
+}
+
+void ClipIndex::build(const lod_pyramid &lod) {
+
+	clear();
+	if (!lod.level_count) return;
+
+	// the top bin says whether there's anything to look for
+	if (!lod.stats[lod.level_count - 1][0].clips) return;
+
+	const lod_stats *stats = lod.stats[0];
+	const std::size_t bins = lod.bin_count[0];
+
+	for (std::size_t b = 0; b < bins; ++b) {
+		if (!stats[b].clips) continue;
+
+		const std::size_t first = b*lod.bin_size;
+		const std::size_t last = (first + lod.bin_size < lod.num_samples) ? first + lod.bin_size : lod.num_samples;
+
+		if (!regions.empty() && regions.back().last == first) {
+			regions.back().last = last;
+			regions.back().clips += stats[b].clips;
+		}
+		else {
+			const clip_region r = { first, last, stats[b].clips };
+			regions.push_back(r);
+		}
+		clipped += stats[b].clips;
+	}
+
+}
+
+void ClipIndex::clear() {
+	regions.clear();
+	clipped = 0;
+}
+
+std::size_t ClipIndex::regionCount() {
+	return regions.size();
+}
+
+const clip_region &ClipIndex::region(std::size_t i) {
+	return regions[i];
+}
+
+std::size_t ClipIndex::clippedSamples() {
+	return clipped;
+}
+
+long long ClipIndex::next(double sample) {
+
+	if (regions.empty()) return -1;
+
+	const std::size_t i = std::partition_point(regions.begin(), regions.end(),
+		[sample](const clip_region &r) { return (double)r.first <= sample; }) - regions.begin();
+	return i < regions.size() ? (long long)i : 0;
+
+}
+
+void ClipIndex::find(double first, double last, std::size_t *begin, std::size_t *end) {
+
+	*begin = std::partition_point(regions.begin(), regions.end(),
+		[first](const clip_region &r) { return (double)r.last <= first; }) - regions.begin();
+	*end = std::partition_point(regions.begin() + *begin, regions.end(),
+		[last](const clip_region &r) { return (double)r.first < last; }) - regions.begin();
+
+}
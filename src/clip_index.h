@@ -0,0 +1,35 @@
+#ifndef CLIP_INDEX_H
+#define CLIP_INDEX_H
+
+#include <cstddef>
+
+#include "lod.h"
+
+// Where the file clips, from the LOD pyramid's per bin clip counts: runs of
+// level 0 bins with any sample at full scale make one region. Nothing is
+// read from the file, the counts came out of the load pass, so the index
+// costs a walk over the bins. Regions are in samples at bin granularity.
+
+struct clip_region {
+	std::size_t first, last;	// samples [first, last)
+	unsigned int clips;			// samples at full scale in it
+};
+
+namespace ClipIndex {
+
+	void build(const lod_pyramid &lod);
+	void clear();
+
+	std::size_t regionCount();
+	const clip_region &region(std::size_t i);
+	std::size_t clippedSamples();
+
+	// the first region starting after sample, wrapping around to the first one; -1 if there are none
+	long long next(double sample);
+
+	// the regions overlapping samples [first, last) are [*begin, *end)
+	void find(double first, double last, std::size_t *begin, std::size_t *end);
+
+};
+
+#endif
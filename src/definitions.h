@@ -23,7 +23,8 @@ static const std::size_t BUFSIZE_MAX = 128*65536;
 static const unsigned int WIN_W = 800; 
 static const unsigned int WIN_H = 600;
 
-static const unsigned int BUFSIZE = 10000;	
+static std::size_t BUFSIZE = 10000;	// refers to sample count, not actual buffer size
+static const std::size_t BUFSIZE_MAX = 128*65536;
 
 #endif
 
@@ -0,0 +1,132 @@
+#include "envelope.h"
+#include "bake.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+#include <cmath>
+
+namespace {
+
+	// the visible samples, when columns are narrower than a level 0 bin
+	short *staging = NULL;
+	std::size_t staging_size = 0;
+
+	const short *visibleSamples(void *user, std::size_t first, std::size_t count) {
+
+		const WavSource &source = *static_cast<const WavSource*>(user);
+		if (source.direct()) {
+			return source.direct() + first;
+		}
+
+		if (count > staging_size) {
+			MemStats::release(staging);
+			staging = MemStats::allocArray<short>(MEM_LOD, count);
+			staging_size = count;
+		}
+		source.read(first, count, staging);
+		return staging;
+
+	}
+
+	// [begin, end) of column c in units of `unit` samples, always at least one unit wide
+	inline void columnRange(double first_sample, double samples_per_column, std::size_t c, std::size_t unit,
+							std::size_t limit, std::size_t *begin, std::size_t *end) {
+
+		*begin = (std::size_t)floor((first_sample + c*samples_per_column)/unit);
+		*end = (std::size_t)ceil((first_sample + (c + 1)*samples_per_column)/unit);
+		if (*end > limit) *end = limit;
+		if (*begin >= *end) *begin = *end - 1;
+
+	}
+
+}
+
+void Envelope::reduce(const WavSource &source, const lod_pyramid &lod, double first_sample, double samples_per_column,
+					  std::size_t columns, short *mins, short *maxs) {
+
+	reduce(visibleSamples, const_cast<WavSource*>(&source), source.sampleCount(), lod, first_sample, samples_per_column,
+		   columns, mins, maxs);
+
+}
+
+void Envelope::reduce(envelope_samples read, void *user, std::size_t num_samples, const lod_pyramid &lod,
+					  double first_sample, double samples_per_column, std::size_t columns, short *mins, short *maxs) {
+
+	PROFILE_ZONE("envelope reduce");
+
+	if (!num_samples || !columns) return;
+
+	const int level = LOD::levelFor(lod, samples_per_column);
+
+	if (level >= 0) {
+
+		// bins on the column edges count for both columns, which only ever widens a span a little
+		const lod_bin *bins = lod.levels[level];
+		const std::size_t bin_size = lod.samplesPerBin(level);
+
+		for (std::size_t c = 0; c < columns; ++c) {
+			std::size_t b, end;
+			columnRange(first_sample, samples_per_column, c, bin_size, lod.bin_count[level], &b, &end);
+
+			short lo = bins[b].min, hi = bins[b].max;
+			for (++b; b < end; ++b) {
+				if (bins[b].min < lo) lo = bins[b].min;
+				if (bins[b].max > hi) hi = bins[b].max;
+			}
+			mins[c] = lo;
+			maxs[c] = hi;
+		}
+
+		return;
+	}
+
+	std::size_t first, last;
+	columnRange(first_sample, samples_per_column*columns, 0, 1, num_samples, &first, &last);
+	const short *samples = read(user, first, last - first);
+
+	for (std::size_t c = 0; c < columns; ++c) {
+		std::size_t i, end;
+		columnRange(first_sample, samples_per_column, c, 1, last, &i, &end);
+		if (i < first) i = first;
+
+		short lo = samples[i - first], hi = lo;
+		for (++i; i < end; ++i) {
+			const short s = samples[i - first];
+			if (s < lo) lo = s;
+			if (s > hi) hi = s;
+		}
+		mins[c] = lo;
+		maxs[c] = hi;
+	}
+
+}
+
+void Envelope::bake(const short *mins, const short *maxs, std::size_t columns, float x0, float column_width,
+					float scale, float min_height, vertex *out) {
+
+	for (std::size_t c = 0; c < columns; ++c) {
+
+		const float x = x0 + (c + 0.5f)*column_width;
+		float top = WIN_H - (scale*maxs[c] + half_WIN_H);
+		float bottom = WIN_H - (scale*mins[c] + half_WIN_H);
+
+		// flat stretches still get a line
+		if (bottom - top < min_height) {
+			const float mid = 0.5f*(top + bottom);
+			top = mid - 0.5f*min_height;
+			bottom = mid + 0.5f*min_height;
+		}
+
+		out[2*c] = vertex(x, top, 1.0, 0.0);
+		out[2*c + 1] = vertex(x, bottom, 1.0, 1.0);
+	}
+
+}
+
+void Envelope::releaseStaging() {
+
+	MemStats::release(staging);
+	staging = NULL;
+	staging_size = 0;
+
+}
@@ -0,0 +1,44 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <cstddef>
+
+#include "definitions.h"
+#include "lod.h"
+#include "wav_source.h"
+
+// The waveform as a filled min/max envelope, one vertical span per pixel
+// column, for when there are too many samples per pixel for the line mesh
+// (overdraw, and the miter joins falling apart). The visible range is
+// reduced to per-column min/max, from the LOD pyramid when a column spans
+// at least a level 0 bin, from the samples themselves below that, and the
+// spans are drawn as one triangle strip: the fill cost only depends on the
+// window width.
+
+// above this many samples per pixel drawWave switches to the envelope
+static const double ENVELOPE_MIN_SAMPLES_PER_PIXEL = 4.0;
+
+// where reduce() gets the samples below level 0 from: count of them from first, good until the next call
+typedef const short *(*envelope_samples)(void *user, std::size_t first, std::size_t count);
+
+namespace Envelope {
+
+	// min/max of every column over [first_sample + c*samples_per_column, first_sample + (c+1)*samples_per_column),
+	// in int16 units. columns must lie within the file.
+	void reduce(const WavSource &source, const lod_pyramid &lod, double first_sample, double samples_per_column,
+				std::size_t columns, short *mins, short *maxs);
+
+	// the same for a signal that isn't a file (the difference of two, align.h) but has a pyramid of its own
+	void reduce(envelope_samples samples, void *user, std::size_t num_samples, const lod_pyramid &lod,
+				double first_sample, double samples_per_column, std::size_t columns, short *mins, short *maxs);
+
+	// two vertices per column at x0 + (c + 0.5)*column_width, each span at least min_height tall.
+	// y follows the line mesh: y = WIN_H - (scale*s + half_WIN_H).
+	void bake(const short *mins, const short *maxs, std::size_t columns, float x0, float column_width,
+			  float scale, float min_height, vertex *out);
+
+	void releaseStaging();
+
+};
+
+#endif
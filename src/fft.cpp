@@ -0,0 +1,281 @@
+#include "fft.h"
+#include "mem_stats.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FFT_SSE2
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+
+	// the first two radix-2 passes in one: the twiddles there are only 1 and -i
+	void radix4(float *re, float *im, std::size_t m) {
+
+		std::size_t g = 0;
+
+#ifdef FFT_SSE2
+		// four groups at a time, transposed so each register holds the same element of every group
+		for (; g + 16 <= m; g += 16) {
+
+			__m128 r0 = _mm_loadu_ps(re + g), r1 = _mm_loadu_ps(re + g + 4), r2 = _mm_loadu_ps(re + g + 8), r3 = _mm_loadu_ps(re + g + 12);
+			__m128 i0 = _mm_loadu_ps(im + g), i1 = _mm_loadu_ps(im + g + 4), i2 = _mm_loadu_ps(im + g + 8), i3 = _mm_loadu_ps(im + g + 12);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+
+			const __m128 b0r = _mm_add_ps(r0, r1), b0i = _mm_add_ps(i0, i1);
+			const __m128 b1r = _mm_sub_ps(r0, r1), b1i = _mm_sub_ps(i0, i1);
+			const __m128 b2r = _mm_add_ps(r2, r3), b2i = _mm_add_ps(i2, i3);
+			const __m128 b3r = _mm_sub_ps(r2, r3), b3i = _mm_sub_ps(i2, i3);
+
+			r0 = _mm_add_ps(b0r, b2r); i0 = _mm_add_ps(b0i, b2i);
+			r2 = _mm_sub_ps(b0r, b2r); i2 = _mm_sub_ps(b0i, b2i);
+			r1 = _mm_add_ps(b1r, b3i); i1 = _mm_sub_ps(b1i, b3r);
+			r3 = _mm_sub_ps(b1r, b3i); i3 = _mm_add_ps(b1i, b3r);
+
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+			_mm_storeu_ps(re + g, r0); _mm_storeu_ps(re + g + 4, r1); _mm_storeu_ps(re + g + 8, r2); _mm_storeu_ps(re + g + 12, r3);
+			_mm_storeu_ps(im + g, i0); _mm_storeu_ps(im + g + 4, i1); _mm_storeu_ps(im + g + 8, i2); _mm_storeu_ps(im + g + 12, i3);
+		}
+#endif
+
+		for (; g < m; g += 4) {
+
+			const float b0r = re[g] + re[g+1], b0i = im[g] + im[g+1];
+			const float b1r = re[g] - re[g+1], b1i = im[g] - im[g+1];
+			const float b2r = re[g+2] + re[g+3], b2i = im[g+2] + im[g+3];
+			const float b3r = re[g+2] - re[g+3], b3i = im[g+2] - im[g+3];
+
+			re[g] = b0r + b2r;   im[g] = b0i + b2i;
+			re[g+2] = b0r - b2r; im[g+2] = b0i - b2i;
+			re[g+1] = b1r + b3i; im[g+1] = b1i - b3r;
+			re[g+3] = b1r - b3i; im[g+3] = b1i + b3r;
+		}
+
+	}
+
+	// butterflies h apart, h >= 4
+	void radix2(float *re, float *im, std::size_t m, std::size_t h, const float *wre, const float *wim) {
+
+		for (std::size_t s = 0; s < m; s += 2*h) {
+
+			float *ar = re + s, *ai = im + s, *br = re + s + h, *bi = im + s + h;
+
+#ifdef FFT_SSE2
+			for (std::size_t j = 0; j < h; j += 4) {
+				const __m128 wr = _mm_loadu_ps(wre + j), wi = _mm_loadu_ps(wim + j);
+				const __m128 xr = _mm_loadu_ps(br + j), xi = _mm_loadu_ps(bi + j);
+				const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+				const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+				const __m128 yr = _mm_loadu_ps(ar + j), yi = _mm_loadu_ps(ai + j);
+				_mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+				_mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+				_mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+				_mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+			}
+#else
+			for (std::size_t j = 0; j < h; ++j) {
+				const float tr = br[j]*wre[j] - bi[j]*wim[j];
+				const float ti = br[j]*wim[j] + bi[j]*wre[j];
+				const float yr = ar[j], yi = ai[j];
+				ar[j] = yr + tr; ai[j] = yi + ti;
+				br[j] = yr - tr; bi[j] = yi - ti;
+			}
+#endif
+		}
+
+	}
+
+}
+
+bool FFT::plan(std::size_t n, fft_plan *p) {
+
+	memset(p, 0, sizeof(*p));
+	if (n < FFT_MIN_SIZE || n > FFT_MAX_SIZE || (n & (n - 1))) return false;
+
+	const std::size_t m = n/2;
+	p->n = n;
+	p->window = MemStats::allocArray<float>(MEM_OTHER, n);
+	p->twiddle_re = MemStats::allocArray<float>(MEM_OTHER, m);
+	p->twiddle_im = MemStats::allocArray<float>(MEM_OTHER, m);
+	p->post_re = MemStats::allocArray<float>(MEM_OTHER, m);
+	p->post_im = MemStats::allocArray<float>(MEM_OTHER, m);
+	p->bitrev = MemStats::allocArray<unsigned int>(MEM_OTHER, m);
+
+	for (std::size_t i = 0; i < n; ++i) {
+		p->window[i] = (float)(0.5 - 0.5*cos(2*M_PI*i/n));
+	}
+
+	// the pass with butterflies h apart keeps its h twiddles at h - 4
+	for (std::size_t h = 4; h < m; h *= 2) {
+		for (std::size_t j = 0; j < h; ++j) {
+			p->twiddle_re[h - 4 + j] = (float)cos(M_PI*j/h);
+			p->twiddle_im[h - 4 + j] = (float)-sin(M_PI*j/h);
+		}
+	}
+
+	for (std::size_t k = 0; k < m; ++k) {
+		p->post_re[k] = (float)cos(2*M_PI*k/n);
+		p->post_im[k] = (float)-sin(2*M_PI*k/n);
+	}
+
+	int bits = 0;
+	while (((std::size_t)1 << bits) < m) ++bits;
+	for (std::size_t k = 0; k < m; ++k) {
+		unsigned int r = 0;
+		for (int b = 0; b < bits; ++b) {
+			if (k & ((std::size_t)1 << b)) r |= 1u << (bits - 1 - b);
+		}
+		p->bitrev[k] = r;
+	}
+
+	return true;
+
+}
+
+void FFT::release(fft_plan *p) {
+
+	MemStats::release(p->window);
+	MemStats::release(p->twiddle_re);
+	MemStats::release(p->twiddle_im);
+	MemStats::release(p->post_re);
+	MemStats::release(p->post_im);
+	MemStats::release(p->bitrev);
+	memset(p, 0, sizeof(*p));
+
+}
+
+std::size_t FFT::scratchSize(std::size_t n) {
+	return n;
+}
+
+void FFT::power(const fft_plan &p, const float *in, float *out, float *scratch) {
+
+	const std::size_t n = p.n, m = n/2;
+	float *re = scratch, *im = scratch + m;
+
+	// even samples real, odd ones imaginary, windowed and in bit reversed order
+	for (std::size_t k = 0; k < m; ++k) {
+		const unsigned int j = p.bitrev[k];
+		re[j] = in[2*k]*p.window[2*k];
+		im[j] = in[2*k+1]*p.window[2*k+1];
+	}
+
+	radix4(re, im, m);
+	for (std::size_t h = 4; h < m; h *= 2) {
+		radix2(re, im, m, h, p.twiddle_re + h - 4, p.twiddle_im + h - 4);
+	}
+
+	// a full scale sine through the Hann window peaks at n/4
+	const float scale = 16.0f/((float)n*n);
+
+	// bins 0 and n/2 are both in Z[0]
+	const float x0 = re[0] + im[0], xm = re[0] - im[0];
+	out[0] = x0*x0*scale;
+	out[m] = xm*xm*scale;
+
+	// X[k] = E + W^k * -i*O, with E and O the halves made of Z[k] and conj(Z[m-k])
+	std::size_t k = 1;
+
+#ifdef FFT_SSE2
+	const __m128 half = _mm_set1_ps(0.5f), s = _mm_set1_ps(scale);
+	for (; k + 4 <= m; k += 4) {
+		const __m128 zr = _mm_loadu_ps(re + k), zi = _mm_loadu_ps(im + k);
+		__m128 cr = _mm_loadu_ps(re + m - k - 3), ci = _mm_loadu_ps(im + m - k - 3);
+		cr = _mm_shuffle_ps(cr, cr, _MM_SHUFFLE(0, 1, 2, 3));
+		ci = _mm_shuffle_ps(ci, ci, _MM_SHUFFLE(0, 1, 2, 3));
+
+		const __m128 er = _mm_mul_ps(half, _mm_add_ps(zr, cr)), ei = _mm_mul_ps(half, _mm_sub_ps(zi, ci));
+		const __m128 orr = _mm_mul_ps(half, _mm_sub_ps(zr, cr)), oi = _mm_mul_ps(half, _mm_add_ps(zi, ci));
+		const __m128 pr = _mm_loadu_ps(p.post_re + k), pi = _mm_loadu_ps(p.post_im + k);
+
+		const __m128 xr = _mm_add_ps(er, _mm_add_ps(_mm_mul_ps(pr, oi), _mm_mul_ps(pi, orr)));
+		const __m128 xi = _mm_add_ps(ei, _mm_sub_ps(_mm_mul_ps(pi, oi), _mm_mul_ps(pr, orr)));
+		_mm_storeu_ps(out + k, _mm_mul_ps(s, _mm_add_ps(_mm_mul_ps(xr, xr), _mm_mul_ps(xi, xi))));
+	}
+#endif
+
+	for (; k < m; ++k) {
+		const float er = 0.5f*(re[k] + re[m-k]), ei = 0.5f*(im[k] - im[m-k]);
+		const float orr = 0.5f*(re[k] - re[m-k]), oi = 0.5f*(im[k] + im[m-k]);
+		const float xr = er + p.post_re[k]*oi + p.post_im[k]*orr;
+		const float xi = ei + p.post_im[k]*oi - p.post_re[k]*orr;
+		out[k] = (xr*xr + xi*xi)*scale;
+	}
+
+}
+
+void FFT::transform(const fft_plan &p, float *re, float *im) {
+
+	const std::size_t m = p.n/2;
+
+	// into bit reversed order, each pair swapped once
+	for (std::size_t k = 0; k < m; ++k) {
+		const std::size_t j = p.bitrev[k];
+		if (j <= k) continue;
+		const float r = re[k], i = im[k];
+		re[k] = re[j]; im[k] = im[j];
+		re[j] = r; im[j] = i;
+	}
+
+	radix4(re, im, m);
+	for (std::size_t h = 4; h < m; h *= 2) {
+		radix2(re, im, m, h, p.twiddle_re + h - 4, p.twiddle_im + h - 4);
+	}
+
+}
+
+void FFT::correlate(const fft_plan &p, float *re, float *im) {
+
+	const std::size_t m = p.n/2, half = m/2;
+
+	transform(p, re, im);
+
+	// with Z = X + iY, the cross spectrum X[k]*conj(Y[k]) is Im(Z[k]*Z[m-k])/2 + i(|Z[k]|^2 - |Z[m-k]|^2)/4,
+	// and k, m-k conjugates of each other. it goes back through the forward transform conjugated
+	// (the inverse of C is conj(DFT(conj(C)))/m, real here), so it's stored conjugated and scaled.
+	const float s = 1.0f/m;
+
+	// the two bins that are their own mirror images, X and Y real there
+	re[0] = re[0]*im[0]*s; im[0] = 0.0f;
+	re[half] = re[half]*im[half]*s; im[half] = 0.0f;
+
+	std::size_t k = 1;
+
+#ifdef FFT_SSE2
+	const __m128 sr = _mm_set1_ps(0.5f*s), si = _mm_set1_ps(0.25f*s);
+	for (; k + 4 <= half; k += 4) {
+		const __m128 zr = _mm_loadu_ps(re + k), zi = _mm_loadu_ps(im + k);
+		__m128 wr = _mm_loadu_ps(re + m - k - 3), wi = _mm_loadu_ps(im + m - k - 3);
+		wr = _mm_shuffle_ps(wr, wr, _MM_SHUFFLE(0, 1, 2, 3));
+		wi = _mm_shuffle_ps(wi, wi, _MM_SHUFFLE(0, 1, 2, 3));
+
+		const __m128 r = _mm_mul_ps(sr, _mm_add_ps(_mm_mul_ps(zr, wi), _mm_mul_ps(zi, wr)));
+		const __m128 i = _mm_mul_ps(si, _mm_sub_ps(_mm_add_ps(_mm_mul_ps(zr, zr), _mm_mul_ps(zi, zi)),
+												   _mm_add_ps(_mm_mul_ps(wr, wr), _mm_mul_ps(wi, wi))));
+
+		_mm_storeu_ps(re + k, r);
+		_mm_storeu_ps(im + k, _mm_sub_ps(_mm_setzero_ps(), i));
+		_mm_storeu_ps(re + m - k - 3, _mm_shuffle_ps(r, r, _MM_SHUFFLE(0, 1, 2, 3)));
+		_mm_storeu_ps(im + m - k - 3, _mm_shuffle_ps(i, i, _MM_SHUFFLE(0, 1, 2, 3)));
+	}
+#endif
+
+	for (; k < half; ++k) {
+		const float zr = re[k], zi = im[k], wr = re[m-k], wi = im[m-k];
+		const float r = 0.5f*s*(zr*wi + zi*wr);
+		const float i = 0.25f*s*(zr*zr + zi*zi - wr*wr - wi*wi);
+		re[k] = r; im[k] = -i;
+		re[m-k] = r; im[m-k] = i;
+	}
+
+	transform(p, re, im);
+
+}
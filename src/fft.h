@@ -0,0 +1,51 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <cstddef>
+
+// Power spectra of real, windowed frames, for power-of-two sizes. The n
+// real samples are packed into n/2 complex ones and go through a radix-4
+// pass and then radix-2 passes (SSE2, four butterflies at a time, split
+// real/imaginary arrays), and a last pass untangles the two halves into
+// the real spectrum. A plan is read-only once made, so any number of
+// threads can share one, each with scratch of its own.
+//
+// The same passes also do plain complex transforms of n/2 points, in place,
+// and circular cross-correlations of two real signals packed into one of
+// them (for lining up two files, see align.h); those are the big plans.
+
+static const std::size_t FFT_MIN_SIZE = 64;
+static const std::size_t FFT_MAX_SIZE = 1 << 21;
+
+struct fft_plan {
+	std::size_t n;
+	float *window;			// n, Hann
+	float *twiddle_re;		// the radix-2 passes, each one's twiddles back to back
+	float *twiddle_im;
+	float *post_re;			// n/2, for the untangling
+	float *post_im;
+	unsigned int *bitrev;	// n/2
+};
+
+namespace FFT {
+
+	bool plan(std::size_t n, fft_plan *p);
+	void release(fft_plan *p);
+
+	// floats of scratch power() needs
+	std::size_t scratchSize(std::size_t n);
+
+	// |X[k]|^2 of the windowed frame, k = 0..n/2 (n/2 + 1 values), scaled
+	// so a full scale sine peaks at about 1
+	void power(const fft_plan &p, const float *in, float *out, float *scratch);
+
+	// the DFT of the n/2 complex points in re/im, in place
+	void transform(const fft_plan &p, float *re, float *im);
+
+	// x in re and y in im (n/2 each, zero padded as needed) become
+	// re[t] = sum over i of x[i + t]*y[i], t taken mod n/2; im is left as scratch
+	void correlate(const fft_plan &p, float *re, float *im);
+
+};
+
+#endif
@@ -18,4 +18,15 @@
 
 #endif
 
+// the GL 3.3 attribute/shader drawing path. the plain linux (SDL) build
+// still targets the fixed-function intel i915 path, but the headless
+// EGL build has a full GL 3.3 context.
+#if defined(_WIN32) || defined(WAVEPLOT_HEADLESS)
+#define WAVEPLOT_GL33
+#endif
+
+#ifdef WAVEPLOT_GL_STATS
+#include "gl_stats.h"
+#endif
+
 #endif
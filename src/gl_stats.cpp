@@ -0,0 +1,349 @@
+// the proxies below need to reach the real entry points
+#define GL_STATS_IMPLEMENTATION
+
+#include "gl_includes.h"
+#include "gl_stats.h"
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+	gl_frame_stats current, last, total;
+	unsigned int frames = 0;
+
+	void accumulate(gl_frame_stats &dst, const gl_frame_stats &src) {
+		dst.draw_calls += src.draw_calls;
+		dst.state_changes += src.state_changes;
+		dst.program_binds += src.program_binds;
+		dst.get_error_calls += src.get_error_calls;
+		dst.bytes_uploaded += src.bytes_uploaded;
+	}
+
+#ifdef WAVEPLOT_GL_STATS
+
+	// a rough figure, good enough for the textures this program uploads
+	unsigned int bytesPerPixel(GLenum format) {
+		switch (format) {
+			case GL_RED: case GL_ALPHA: case GL_LUMINANCE: return 1;
+			case GL_RGB: case GL_BGR: return 3;
+			default: return 4;
+		}
+	}
+
+#endif
+
+}
+
+bool GLStats::enabled() {
+#ifdef WAVEPLOT_GL_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+void GLStats::endFrame() {
+
+	if (!enabled()) return;
+
+	last = current;
+	accumulate(total, current);
+	++frames;
+	memset(&current, 0, sizeof(current));
+
+	Profiler::counter("gl draw calls", last.draw_calls);
+	Profiler::counter("gl state changes", last.state_changes);
+	Profiler::counter("gl program binds", last.program_binds);
+	Profiler::counter("gl getError calls", last.get_error_calls);
+	Profiler::counter("gl bytes uploaded", (double)last.bytes_uploaded);
+
+}
+
+const gl_frame_stats &GLStats::lastFrame() {
+	return last;
+}
+
+const gl_frame_stats &GLStats::totals() {
+	return total;
+}
+
+unsigned int GLStats::frameCount() {
+	return frames;
+}
+
+void GLStats::printReport() {
+
+	if (!enabled()) return;
+
+	const double n = frames ? double(frames) : 1.0;
+	printf("GL stats over %u frames (per frame): %.1f draw calls, %.1f state changes, %.1f program binds, %.1f glGetError calls, %.1f KiB uploaded\n",
+		frames, total.draw_calls/n, total.state_changes/n, total.program_binds/n, total.get_error_calls/n, total.bytes_uploaded/n/1024.0);
+
+}
+
+#ifdef WAVEPLOT_GL_STATS
+
+// GL 1.1 entry points, redirected by macro on every platform
+
+void APIENTRY GLStats::DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices) {
+	++current.draw_calls;
+	glDrawElements(mode, count, type, indices);
+}
+
+void APIENTRY GLStats::DrawArrays(GLenum mode, GLint first, GLsizei count) {
+	++current.draw_calls;
+	glDrawArrays(mode, first, count);
+}
+
+GLenum APIENTRY GLStats::GetError() {
+	++current.get_error_calls;
+	return glGetError();
+}
+
+void APIENTRY GLStats::BindTexture(GLenum target, GLuint texture) {
+	++current.state_changes;
+	glBindTexture(target, texture);
+}
+
+void APIENTRY GLStats::PolygonMode(GLenum face, GLenum mode) {
+	++current.state_changes;
+	glPolygonMode(face, mode);
+}
+
+void APIENTRY GLStats::Enable(GLenum cap) {
+	++current.state_changes;
+	glEnable(cap);
+}
+
+void APIENTRY GLStats::Disable(GLenum cap) {
+	++current.state_changes;
+	glDisable(cap);
+}
+
+void APIENTRY GLStats::BlendFunc(GLenum sfactor, GLenum dfactor) {
+	++current.state_changes;
+	glBlendFunc(sfactor, dfactor);
+}
+
+void APIENTRY GLStats::TexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels) {
+	if (pixels) {
+		current.bytes_uploaded += (unsigned long long)width*height*bytesPerPixel(format);
+	}
+	glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+void APIENTRY GLStats::TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels) {
+	current.bytes_uploaded += (unsigned long long)width*height*bytesPerPixel(format);
+	glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+#ifdef _WIN32
+
+// extension entry points: the originals are kept and the table entries
+// pointed at these instead
+
+namespace {
+
+	PFNGLBINDBUFFERPROC real_glBindBuffer;
+	PFNGLBUFFERDATAPROC real_glBufferData;
+	PFNGLBUFFERSUBDATAPROC real_glBufferSubData;
+	PFNGLACTIVETEXTUREPROC real_glActiveTexture;
+	PFNGLBINDFRAMEBUFFERPROC real_glBindFramebuffer;
+	PFNGLUSEPROGRAMPROC real_glUseProgram;
+	PFNGLUNIFORM1IPROC real_glUniform1i;
+	PFNGLUNIFORM1FPROC real_glUniform1f;
+	PFNGLUNIFORM3FPROC real_glUniform3f;
+	PFNGLUNIFORM3FVPROC real_glUniform3fv;
+	PFNGLUNIFORM4FPROC real_glUniform4f;
+	PFNGLUNIFORMMATRIX4FVPROC real_glUniformMatrix4fv;
+	PFNGLVERTEXATTRIBPOINTERPROC real_glVertexAttribPointer;
+	PFNGLENABLEVERTEXATTRIBARRAYPROC real_glEnableVertexAttribArray;
+	PFNGLTEXBUFFERPROC real_glTexBuffer;
+
+	void APIENTRY proxy_glBindBuffer(GLenum target, GLuint buffer) {
+		++current.state_changes;
+		real_glBindBuffer(target, buffer);
+	}
+
+	void APIENTRY proxy_glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+		current.bytes_uploaded += size;
+		real_glBufferData(target, size, data, usage);
+	}
+
+	void APIENTRY proxy_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {
+		current.bytes_uploaded += size;
+		real_glBufferSubData(target, offset, size, data);
+	}
+
+	void APIENTRY proxy_glActiveTexture(GLenum texture) {
+		++current.state_changes;
+		real_glActiveTexture(texture);
+	}
+
+	void APIENTRY proxy_glBindFramebuffer(GLenum target, GLuint framebuffer) {
+		++current.state_changes;
+		real_glBindFramebuffer(target, framebuffer);
+	}
+
+	void APIENTRY proxy_glUseProgram(GLuint program) {
+		++current.program_binds;
+		real_glUseProgram(program);
+	}
+
+	void APIENTRY proxy_glUniform1i(GLint location, GLint v0) {
+		++current.state_changes;
+		real_glUniform1i(location, v0);
+	}
+
+	void APIENTRY proxy_glUniform1f(GLint location, GLfloat v0) {
+		++current.state_changes;
+		real_glUniform1f(location, v0);
+	}
+
+	void APIENTRY proxy_glUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+		++current.state_changes;
+		real_glUniform3f(location, v0, v1, v2);
+	}
+
+	void APIENTRY proxy_glUniform3fv(GLint location, GLsizei count, const GLfloat *value) {
+		++current.state_changes;
+		real_glUniform3fv(location, count, value);
+	}
+
+	void APIENTRY proxy_glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+		++current.state_changes;
+		real_glUniform4f(location, v0, v1, v2, v3);
+	}
+
+	void APIENTRY proxy_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+		++current.state_changes;
+		real_glUniformMatrix4fv(location, count, transpose, value);
+	}
+
+	void APIENTRY proxy_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer) {
+		++current.state_changes;
+		real_glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+	}
+
+	void APIENTRY proxy_glEnableVertexAttribArray(GLuint index) {
+		++current.state_changes;
+		real_glEnableVertexAttribArray(index);
+	}
+
+	void APIENTRY proxy_glTexBuffer(GLenum target, GLenum internalformat, GLuint buffer) {
+		++current.state_changes;
+		real_glTexBuffer(target, internalformat, buffer);
+	}
+
+}
+
+#define INSTALL_PROXY(fn) real_##fn = fn; fn = proxy_##fn
+
+void GLStats::installProxies() {
+
+	INSTALL_PROXY(glBindBuffer);
+	INSTALL_PROXY(glBufferData);
+	INSTALL_PROXY(glBufferSubData);
+	INSTALL_PROXY(glActiveTexture);
+	INSTALL_PROXY(glBindFramebuffer);
+	INSTALL_PROXY(glUseProgram);
+	INSTALL_PROXY(glUniform1i);
+	INSTALL_PROXY(glUniform1f);
+	INSTALL_PROXY(glUniform3f);
+	INSTALL_PROXY(glUniform3fv);
+	INSTALL_PROXY(glUniform4f);
+	INSTALL_PROXY(glUniformMatrix4fv);
+	INSTALL_PROXY(glVertexAttribPointer);
+	INSTALL_PROXY(glEnableVertexAttribArray);
+	INSTALL_PROXY(glTexBuffer);
+
+}
+
+#else
+
+void GLStats::installProxies() {}	// nothing to patch, see the macros in gl_stats.h
+
+void APIENTRY GLStats::BindBuffer(GLenum target, GLuint buffer) {
+	++current.state_changes;
+	glBindBuffer(target, buffer);
+}
+
+void APIENTRY GLStats::BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+	current.bytes_uploaded += size;
+	glBufferData(target, size, data, usage);
+}
+
+void APIENTRY GLStats::BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {
+	current.bytes_uploaded += size;
+	glBufferSubData(target, offset, size, data);
+}
+
+void APIENTRY GLStats::ActiveTexture(GLenum texture) {
+	++current.state_changes;
+	glActiveTexture(texture);
+}
+
+void APIENTRY GLStats::BindFramebuffer(GLenum target, GLuint framebuffer) {
+	++current.state_changes;
+	glBindFramebuffer(target, framebuffer);
+}
+
+void APIENTRY GLStats::UseProgram(GLuint program) {
+	++current.program_binds;
+	glUseProgram(program);
+}
+
+void APIENTRY GLStats::Uniform1i(GLint location, GLint v0) {
+	++current.state_changes;
+	glUniform1i(location, v0);
+}
+
+void APIENTRY GLStats::Uniform1f(GLint location, GLfloat v0) {
+	++current.state_changes;
+	glUniform1f(location, v0);
+}
+
+void APIENTRY GLStats::Uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+	++current.state_changes;
+	glUniform3f(location, v0, v1, v2);
+}
+
+void APIENTRY GLStats::Uniform3fv(GLint location, GLsizei count, const GLfloat *value) {
+	++current.state_changes;
+	glUniform3fv(location, count, value);
+}
+
+void APIENTRY GLStats::Uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+	++current.state_changes;
+	glUniform4f(location, v0, v1, v2, v3);
+}
+
+void APIENTRY GLStats::UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+	++current.state_changes;
+	glUniformMatrix4fv(location, count, transpose, value);
+}
+
+void APIENTRY GLStats::VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer) {
+	++current.state_changes;
+	glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void APIENTRY GLStats::EnableVertexAttribArray(GLuint index) {
+	++current.state_changes;
+	glEnableVertexAttribArray(index);
+}
+
+void APIENTRY GLStats::TexBuffer(GLenum target, GLenum internalformat, GLuint buffer) {
+	++current.state_changes;
+	glTexBuffer(target, internalformat, buffer);
+}
+
+#endif
+
+#else
+
+void GLStats::installProxies() {}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef GL_STATS_H
+#define GL_STATS_H
+
+// Per-frame GL call accounting, for an opt-in instrumented build
+// (-DWAVEPLOT_GL_STATS). On Windows the extension entry points filled in by
+// load_GL_extensions() are swapped for counting proxies; the GL 1.1 calls
+// (draws, glGetError, texture binds...) and, on linux, everything else are
+// redirected with macros at the bottom of this file. Without the define
+// all of this compiles to nothing and the counters stay at zero.
+
+struct gl_frame_stats {
+	unsigned int draw_calls;
+	unsigned int state_changes;		// buffer/texture/framebuffer binds, enables, attrib pointers, uniforms, glTexBuffer
+	unsigned int program_binds;
+	unsigned int get_error_calls;
+	unsigned long long bytes_uploaded;	// glBufferData, glBufferSubData, glTexImage2D, glTexSubImage2D
+};
+
+namespace GLStats {
+
+	bool enabled();
+
+	// swaps the glext_loader function pointers for the counting proxies.
+	// called by load_GL_extensions() in instrumented builds.
+	void installProxies();
+
+	// snapshots the current frame's counters, adds them to the trace and resets
+	void endFrame();
+
+	const gl_frame_stats &lastFrame();
+	const gl_frame_stats &totals();
+	unsigned int frameCount();
+
+	void printReport();
+
+};
+
+#ifdef WAVEPLOT_GL_STATS
+
+#include "gl_includes.h"
+
+namespace GLStats {
+	void APIENTRY DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices);
+	void APIENTRY DrawArrays(GLenum mode, GLint first, GLsizei count);
+	GLenum APIENTRY GetError();
+	void APIENTRY BindTexture(GLenum target, GLuint texture);
+	void APIENTRY PolygonMode(GLenum face, GLenum mode);
+	void APIENTRY Enable(GLenum cap);
+	void APIENTRY Disable(GLenum cap);
+	void APIENTRY BlendFunc(GLenum sfactor, GLenum dfactor);
+	void APIENTRY TexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels);
+	void APIENTRY TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels);
+
+#ifndef _WIN32
+	void APIENTRY BindBuffer(GLenum target, GLuint buffer);
+	void APIENTRY BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+	void APIENTRY BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+	void APIENTRY ActiveTexture(GLenum texture);
+	void APIENTRY BindFramebuffer(GLenum target, GLuint framebuffer);
+	void APIENTRY UseProgram(GLuint program);
+	void APIENTRY Uniform1i(GLint location, GLint v0);
+	void APIENTRY Uniform1f(GLint location, GLfloat v0);
+	void APIENTRY Uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+	void APIENTRY Uniform3fv(GLint location, GLsizei count, const GLfloat *value);
+	void APIENTRY Uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+	void APIENTRY UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+	void APIENTRY VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+	void APIENTRY EnableVertexAttribArray(GLuint index);
+	void APIENTRY TexBuffer(GLenum target, GLenum internalformat, GLuint buffer);
+#endif
+}
+
+#ifndef GL_STATS_IMPLEMENTATION
+
+#define glDrawElements GLStats::DrawElements
+#define glDrawArrays GLStats::DrawArrays
+#define glGetError GLStats::GetError
+#define glBindTexture GLStats::BindTexture
+#define glPolygonMode GLStats::PolygonMode
+#define glEnable GLStats::Enable
+#define glDisable GLStats::Disable
+#define glBlendFunc GLStats::BlendFunc
+#define glTexImage2D GLStats::TexImage2D
+#define glTexSubImage2D GLStats::TexSubImage2D
+
+#ifndef _WIN32
+// no loader table to patch here, the prototypes come straight from glext.h
+#define glBindBuffer GLStats::BindBuffer
+#define glBufferData GLStats::BufferData
+#define glBufferSubData GLStats::BufferSubData
+#define glActiveTexture GLStats::ActiveTexture
+#define glBindFramebuffer GLStats::BindFramebuffer
+#define glUseProgram GLStats::UseProgram
+#define glUniform1i GLStats::Uniform1i
+#define glUniform1f GLStats::Uniform1f
+#define glUniform3f GLStats::Uniform3f
+#define glUniform3fv GLStats::Uniform3fv
+#define glUniform4f GLStats::Uniform4f
+#define glUniformMatrix4fv GLStats::UniformMatrix4fv
+#define glVertexAttribPointer GLStats::VertexAttribPointer
+#define glEnableVertexAttribArray GLStats::EnableVertexAttribArray
+#define glTexBuffer GLStats::TexBuffer
+#endif
+
+#endif
+
+#endif
+
+#endif
@@ -4,6 +4,7 @@
 #include <cassert>
 
 #include "glext_loader.h"
+#include "gl_stats.h"
 
 PFNGLGETSHADERIVPROC glGetShaderiv;
 PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
@@ -28,13 +29,27 @@ PFNGLDRAWBUFFERSPROC glDrawBuffers;
 PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
 PFNGLFRAMEBUFFERTEXTUREPROC glFramebufferTexture;
 PFNGLGENFRAMEBUFFERSPROC glGenFramebuffers;
+PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers;
 PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
 PFNGLUNIFORMMATRIX4FVPROC glUniformMatrix4fv;
 PFNGLCHECKFRAMEBUFFERSTATUSPROC glCheckFramebufferStatus;
 PFNGLUSEPROGRAMPROC glUseProgram;
 PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
 PFNGLUNIFORM1IPROC glUniform1i;
+PFNGLUNIFORM1FPROC glUniform1f;
+PFNGLUNIFORM4FPROC glUniform4f;
+PFNGLUNIFORM3FPROC glUniform3f;
+PFNGLUNIFORM3FVPROC glUniform3fv;
 PFNGLGENERATEMIPMAPPROC glGenerateMipmap;
+PFNGLGENQUERIESPROC glGenQueries;
+PFNGLDELETEQUERIESPROC glDeleteQueries;
+PFNGLBEGINQUERYPROC glBeginQuery;
+PFNGLENDQUERYPROC glEndQuery;
+PFNGLGETQUERYOBJECTIVPROC glGetQueryObjectiv;
+PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v;
+PFNGLTEXBUFFERPROC glTexBuffer;
+PFNGLDRAWARRAYSINSTANCEDPROC glDrawArraysInstanced;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
 
 int load_GL_extensions() {
 
@@ -107,6 +122,9 @@ int load_GL_extensions() {
 	glGenFramebuffers = (PFNGLGENFRAMEBUFFERSPROC)wglGetProcAddress("glGenFramebuffers");
 	assert(glGenFramebuffers);
 
+	glDeleteFramebuffers = (PFNGLDELETEFRAMEBUFFERSPROC)wglGetProcAddress("glDeleteFramebuffers");
+	assert(glDeleteFramebuffers);
+
 	glGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)wglGetProcAddress("glGetUniformLocation");
 	assert(glGetUniformLocation);
 
@@ -125,8 +143,51 @@ int load_GL_extensions() {
 	glUniform1i = (PFNGLUNIFORM1IPROC)wglGetProcAddress("glUniform1i");
 	assert(glUniform1i);
 
+	glUniform1f = (PFNGLUNIFORM1FPROC)wglGetProcAddress("glUniform1f");
+	assert(glUniform1f);
+
+	glUniform4f = (PFNGLUNIFORM4FPROC)wglGetProcAddress("glUniform4f");
+	assert(glUniform4f);
+
+	glUniform3f = (PFNGLUNIFORM3FPROC)wglGetProcAddress("glUniform3f");
+	assert(glUniform3f);
+
+	glUniform3fv = (PFNGLUNIFORM3FVPROC)wglGetProcAddress("glUniform3fv");
+	assert(glUniform3fv);
+
 	glGenerateMipmap = (PFNGLGENERATEMIPMAPPROC)wglGetProcAddress("glGenerateMipmap");
 	assert(glGenerateMipmap);
 
+	glGenQueries = (PFNGLGENQUERIESPROC)wglGetProcAddress("glGenQueries");
+	assert(glGenQueries);
+
+	glDeleteQueries = (PFNGLDELETEQUERIESPROC)wglGetProcAddress("glDeleteQueries");
+	assert(glDeleteQueries);
+
+	glBeginQuery = (PFNGLBEGINQUERYPROC)wglGetProcAddress("glBeginQuery");
+	assert(glBeginQuery);
+
+	glEndQuery = (PFNGLENDQUERYPROC)wglGetProcAddress("glEndQuery");
+	assert(glEndQuery);
+
+	glGetQueryObjectiv = (PFNGLGETQUERYOBJECTIVPROC)wglGetProcAddress("glGetQueryObjectiv");
+	assert(glGetQueryObjectiv);
+
+	glGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)wglGetProcAddress("glGetQueryObjectui64v");
+	assert(glGetQueryObjectui64v);
+
+	glTexBuffer = (PFNGLTEXBUFFERPROC)wglGetProcAddress("glTexBuffer");
+	assert(glTexBuffer);
+
+	glDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC)wglGetProcAddress("glDrawArraysInstanced");
+	assert(glDrawArraysInstanced);
+
+	glDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)wglGetProcAddress("glDisableVertexAttribArray");
+	assert(glDisableVertexAttribArray);
+
+#ifdef WAVEPLOT_GL_STATS
+	GLStats::installProxies();
+#endif
+
 	return 1;
 }
\ No newline at end of file
@@ -13,6 +13,7 @@ typedef unsigned int GLhandleARB; // this is the #else bracnh of "#ifdef __APPLE
 #include <stddef.h>
 typedef ptrdiff_t GLsizeiptr;
 typedef ptrdiff_t GLintptr;
+typedef unsigned __int64 GLuint64;
 
 #define GL_ARRAY_BUFFER                   0x8892
 #define GL_ELEMENT_ARRAY_BUFFER           0x8893
@@ -20,6 +21,7 @@ typedef ptrdiff_t GLintptr;
 
 #define GL_STATIC_DRAW                    0x88E4
 #define GL_DYNAMIC_DRAW                   0x88E8
+#define GL_STREAM_DRAW                    0x88E0
 
 #define GL_TEXTURE0                       0x84C0
 #define GL_COLOR_ATTACHMENT0              0x8CE0
@@ -35,6 +37,19 @@ typedef ptrdiff_t GLintptr;
 #define GL_COMPILE_STATUS                 0x8B81
 #define GL_INFO_LOG_LENGTH                0x8B84
 
+#define GL_QUERY_RESULT                   0x8866
+#define GL_QUERY_RESULT_AVAILABLE         0x8867
+#define GL_TIME_ELAPSED                   0x88BF
+
+#define GL_TEXTURE_BUFFER                 0x8C2A
+#define GL_MAX_TEXTURE_BUFFER_SIZE        0x8C2B
+#define GL_R32F                           0x822E
+#define GL_R16I                           0x8233
+#define GL_RG                             0x8227
+#define GL_RG32F                          0x8230
+#define GL_RGBA16I                        0x8D88
+#define GL_R32I                           0x8235
+
 
 typedef void (APIENTRYP PFNGLGETSHADERIVPROC) (GLuint shader, GLenum pname, GLint *params);
 extern PFNGLGETSHADERIVPROC glGetShaderiv;
@@ -108,6 +123,9 @@ extern PFNGLFRAMEBUFFERTEXTUREPROC glFramebufferTexture;
 typedef void (APIENTRYP PFNGLGENFRAMEBUFFERSPROC) (GLsizei n, GLuint *framebuffers);
 extern PFNGLGENFRAMEBUFFERSPROC glGenFramebuffers;
 
+typedef void (APIENTRYP PFNGLDELETEFRAMEBUFFERSPROC) (GLsizei n, const GLuint *framebuffers);
+extern PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers;
+
 typedef GLint(APIENTRYP PFNGLGETUNIFORMLOCATIONPROC) (GLuint program, const GLchar *name);
 extern PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
 
@@ -126,7 +144,46 @@ extern PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
 typedef void (APIENTRYP PFNGLUNIFORM1IPROC) (GLint location, GLint v0);
 extern PFNGLUNIFORM1IPROC glUniform1i;
 
+typedef void (APIENTRYP PFNGLUNIFORM1FPROC) (GLint location, GLfloat v0);
+extern PFNGLUNIFORM1FPROC glUniform1f;
+
+typedef void (APIENTRYP PFNGLUNIFORM4FPROC) (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+extern PFNGLUNIFORM4FPROC glUniform4f;
+
+typedef void (APIENTRYP PFNGLUNIFORM3FPROC) (GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+extern PFNGLUNIFORM3FPROC glUniform3f;
+
+typedef void (APIENTRYP PFNGLUNIFORM3FVPROC) (GLint location, GLsizei count, const GLfloat *value);
+extern PFNGLUNIFORM3FVPROC glUniform3fv;
+
 typedef void (APIENTRYP PFNGLGENERATEMIPMAPPROC) (GLenum target);
 extern PFNGLGENERATEMIPMAPPROC glGenerateMipmap;
 
+typedef void (APIENTRYP PFNGLGENQUERIESPROC) (GLsizei n, GLuint *ids);
+extern PFNGLGENQUERIESPROC glGenQueries;
+
+typedef void (APIENTRYP PFNGLDELETEQUERIESPROC) (GLsizei n, const GLuint *ids);
+extern PFNGLDELETEQUERIESPROC glDeleteQueries;
+
+typedef void (APIENTRYP PFNGLBEGINQUERYPROC) (GLenum target, GLuint id);
+extern PFNGLBEGINQUERYPROC glBeginQuery;
+
+typedef void (APIENTRYP PFNGLENDQUERYPROC) (GLenum target);
+extern PFNGLENDQUERYPROC glEndQuery;
+
+typedef void (APIENTRYP PFNGLGETQUERYOBJECTIVPROC) (GLuint id, GLenum pname, GLint *params);
+extern PFNGLGETQUERYOBJECTIVPROC glGetQueryObjectiv;
+
+typedef void (APIENTRYP PFNGLGETQUERYOBJECTUI64VPROC) (GLuint id, GLenum pname, GLuint64 *params);
+extern PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v;
+
+typedef void (APIENTRYP PFNGLTEXBUFFERPROC) (GLenum target, GLenum internalformat, GLuint buffer);
+extern PFNGLTEXBUFFERPROC glTexBuffer;
+
+typedef void (APIENTRYP PFNGLDRAWARRAYSINSTANCEDPROC) (GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+extern PFNGLDRAWARRAYSINSTANCEDPROC glDrawArraysInstanced;
+
+typedef void (APIENTRYP PFNGLDISABLEVERTEXATTRIBARRAYPROC) (GLuint index);
+extern PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
+
 int load_GL_extensions();
\ No newline at end of file
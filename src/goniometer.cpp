@@ -0,0 +1,359 @@
+#include "goniometer.h"
+#include "definitions.h"
+#include "shader.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstdio>
+
+#if defined(_WIN32) || defined(__SSE2__)
+#include <emmintrin.h>
+#define GONIOMETER_SSE2
+#endif
+
+#define BUFFER_OFFSET(i) (reinterpret_cast<void*>(i))
+
+namespace {
+
+	struct pair_sums {
+		double ll, rr, lr;
+	};
+
+	const float exposure = 40.0f;	// on the square root of the energy, see the tone map shader
+
+	ShaderProgram *points_program = NULL, *tonemap_program = NULL;
+	GLuint accum_texture = 0, accum_FBOid = 0;
+	GLuint pairs_VBOid = 0;
+
+	std::size_t num_samples = 0;
+	std::size_t upload_step = 1;	// every upload_step-th pair went up
+	std::size_t uploaded = 0;
+
+	pair_sums *prefix = NULL;		// sums of the blocks before block i
+	std::size_t block_count = 0;
+	const WavSource *document = NULL;	// from setSource(), up it goes at the first draw()
+	const WavSource *source = NULL;		// the one that's up
+	short *staging = NULL;			// one block of pairs
+
+	double last_correlation = 0.0;
+
+	// L*L, R*R and L*R over count interleaved pairs
+	pair_sums pairSums(const short *p, std::size_t count) {
+
+		pair_sums s = { 0.0, 0.0, 0.0 };
+		std::size_t i = 0;
+
+#ifdef GONIOMETER_SSE2
+
+		// 4 pairs a cycle, widened to float: squares come out as LL RR LL RR,
+		// and against a copy with the pairs swapped, LR RL LR RL
+		__m128 sq = _mm_setzero_ps(), cross = _mm_setzero_ps();
+
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(p + 2*i));
+			const __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+			const __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+			const __m128 a_swapped = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+			const __m128 b_swapped = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1));
+			sq = _mm_add_ps(sq, _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)));
+			cross = _mm_add_ps(cross, _mm_add_ps(_mm_mul_ps(a, a_swapped), _mm_mul_ps(b, b_swapped)));
+		}
+
+		// a block's worth in float is plenty; the blocks add up in double
+		float q[4], c[4];
+		_mm_storeu_ps(q, sq);
+		_mm_storeu_ps(c, cross);
+		s.ll = (double)q[0] + q[2];
+		s.rr = (double)q[1] + q[3];
+		s.lr = 0.5*((double)c[0] + c[1] + c[2] + c[3]);
+
+#endif
+
+		for (; i < count; ++i) {
+			const double l = p[2*i], r = p[2*i+1];
+			s.ll += l*l;
+			s.rr += r*r;
+			s.lr += l*r;
+		}
+
+		return s;
+
+	}
+
+	// [first, last) within one block
+	pair_sums partialSums(std::size_t first, std::size_t last) {
+
+		pair_sums s = { 0.0, 0.0, 0.0 };
+		if (last <= first) return s;
+
+		const std::size_t n = source->readPairs(first, last - first, staging);
+		return pairSums(staging, n);
+
+	}
+
+#ifdef WAVEPLOT_GL33
+
+	GLuint quad = 0;
+	GLint intensity_loc, tonemap_texture_loc, exposure_loc;
+
+	// the pairs up and the correlation sums, for the file setSource() was given
+	void load() {
+
+		if (!document || !document->sampleCount()) return;
+
+		PROFILE_ZONE("goniometer upload");
+
+		source = document;
+		num_samples = source->sampleCount();
+		upload_step = (num_samples + GONIOMETER_MAX_PAIRS - 1)/GONIOMETER_MAX_PAIRS;
+		uploaded = (num_samples + upload_step - 1)/upload_step;
+
+		block_count = (num_samples + GONIOMETER_BLOCK - 1)/GONIOMETER_BLOCK;
+		prefix = MemStats::allocArray<pair_sums>(MEM_LOD, block_count + 1);
+		staging = MemStats::allocArray<short>(MEM_IO, 2*GONIOMETER_BLOCK);
+
+		glGenBuffers(1, &pairs_VBOid);
+		glBindBuffer(GL_ARRAY_BUFFER, pairs_VBOid);
+		glBufferData(GL_ARRAY_BUFFER, uploaded*2*sizeof(short), NULL, GL_STATIC_DRAW);
+		MemStats::trackBuffer(pairs_VBOid, MEM_IO, uploaded*2*sizeof(short));
+
+		// a block at a time: its sums, then up it goes (every upload_step-th pair of it, that is)
+		prefix[0].ll = prefix[0].rr = prefix[0].lr = 0.0;
+		std::size_t written = 0;
+
+		for (std::size_t b = 0; b < block_count; ++b) {
+
+			const std::size_t first = b*GONIOMETER_BLOCK;
+			const std::size_t n = source->readPairs(first, GONIOMETER_BLOCK, staging);
+
+			const pair_sums s = pairSums(staging, n);
+			prefix[b + 1].ll = prefix[b].ll + s.ll;
+			prefix[b + 1].rr = prefix[b].rr + s.rr;
+			prefix[b + 1].lr = prefix[b].lr + s.lr;
+
+			std::size_t kept = n;
+			if (upload_step > 1) {
+				kept = 0;
+				for (std::size_t i = (upload_step - first % upload_step) % upload_step; i < n; i += upload_step, ++kept) {
+					staging[2*kept] = staging[2*i];
+					staging[2*kept+1] = staging[2*i+1];
+				}
+			}
+			glBufferSubData(GL_ARRAY_BUFFER, written*2*sizeof(short), kept*2*sizeof(short), staging);
+			written += kept;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		printf("Goniometer: %u pairs up (every %u), correlation %+.3f overall.\n",
+			(unsigned)uploaded, (unsigned)upload_step, Goniometer::correlation(0, num_samples));
+
+	}
+
+	void drawQuad() {
+
+		glBindBuffer(GL_ARRAY_BUFFER, quad);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+	}
+
+#endif
+
+}
+
+bool Goniometer::init(GLuint quad_VBOid) {
+
+#ifdef WAVEPLOT_GL33
+
+	quad = quad_VBOid;
+
+	points_program = new ShaderProgram("shaders/goniometer_vertex.shader.win", "shaders/phosphor_fragment.shader.win", "");
+	tonemap_program = new ShaderProgram("shaders/quad_passthrough.shader.win", "shaders/goniometer_tonemap_fragment.shader.win", "");
+
+	if (!points_program->valid() || !tonemap_program->valid()) {
+		printf("Goniometer: couldn't build the shaders, the goniometer is unavailable.\n");
+		destroy();
+		return false;
+	}
+
+	intensity_loc = glGetUniformLocation(points_program->programHandle(), "intensity");
+	tonemap_texture_loc = glGetUniformLocation(tonemap_program->programHandle(), "texture_1");
+	exposure_loc = glGetUniformLocation(tonemap_program->programHandle(), "exposure");
+
+	glGenTextures(1, &accum_texture);
+	glBindTexture(GL_TEXTURE_2D, accum_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, GONIOMETER_SIZE, GONIOMETER_SIZE, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	MemStats::trackTexture(accum_texture, MEM_TEXTURES, GONIOMETER_SIZE*GONIOMETER_SIZE*sizeof(float));
+
+	glGenFramebuffers(1, &accum_FBOid);
+	glBindFramebuffer(GL_FRAMEBUFFER, accum_FBOid);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, accum_texture, 0);
+
+	GLenum m[1] = { GL_COLOR_ATTACHMENT0 };
+	glDrawBuffers(1, m);
+
+	const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (!complete) {
+		printf("Goniometer: R32F render target unsupported, the goniometer is unavailable.\n");
+		destroy();
+		return false;
+	}
+
+	return true;
+
+#else
+	return false;
+#endif
+
+}
+
+void Goniometer::destroy() {
+
+	setSource(NULL);
+
+	if (accum_FBOid) {
+		glDeleteFramebuffers(1, &accum_FBOid);
+		accum_FBOid = 0;
+	}
+	if (accum_texture) {
+		MemStats::untrackTexture(accum_texture);
+		glDeleteTextures(1, &accum_texture);
+		accum_texture = 0;
+	}
+
+	delete points_program;
+	delete tonemap_program;
+	points_program = tonemap_program = NULL;
+
+}
+
+void Goniometer::setSource(const WavSource *source_) {
+
+	unload();
+	document = source_;
+
+}
+
+void Goniometer::unload() {
+
+	if (pairs_VBOid) {
+		MemStats::untrackBuffer(pairs_VBOid);
+		glDeleteBuffers(1, &pairs_VBOid);
+		pairs_VBOid = 0;
+	}
+	MemStats::release(prefix);
+	MemStats::release(staging);
+	prefix = NULL;
+	staging = NULL;
+	source = NULL;
+	num_samples = uploaded = block_count = 0;
+	last_correlation = 0.0;
+
+}
+
+double Goniometer::correlation(std::size_t first, std::size_t last) {
+
+	if (!source) return 0.0;
+	if (last > num_samples) last = num_samples;
+	if (first >= last) return 0.0;
+
+	// whole blocks from the prefix sums, the ragged ends read and summed on the spot
+	const std::size_t b0 = (first + GONIOMETER_BLOCK - 1)/GONIOMETER_BLOCK, b1 = last/GONIOMETER_BLOCK;
+	pair_sums s;
+
+	if (b0 < b1) {
+		const pair_sums head = partialSums(first, b0*GONIOMETER_BLOCK), tail = partialSums(b1*GONIOMETER_BLOCK, last);
+		s.ll = prefix[b1].ll - prefix[b0].ll + head.ll + tail.ll;
+		s.rr = prefix[b1].rr - prefix[b0].rr + head.rr + tail.rr;
+		s.lr = prefix[b1].lr - prefix[b0].lr + head.lr + tail.lr;
+	}
+	else {
+		// less than two block boundaries apart, at most two blocks of reading
+		const std::size_t mid = b0*GONIOMETER_BLOCK < last ? b0*GONIOMETER_BLOCK : last;
+		const pair_sums a = partialSums(first, mid), b = partialSums(mid, last);
+		s.ll = a.ll + b.ll;
+		s.rr = a.rr + b.rr;
+		s.lr = a.lr + b.lr;
+	}
+
+	const double d = sqrt(s.ll*s.rr);
+	return d > 0.0 ? s.lr/d : 0.0;
+
+}
+
+double Goniometer::correlation() {
+	return last_correlation;
+}
+
+void Goniometer::draw(double first_sample, double last_sample, int x, int y, GLuint framebuffer) {
+
+#ifdef WAVEPLOT_GL33
+
+	if (!points_program) return;
+	if (!source) load();
+	if (!pairs_VBOid) return;
+
+	PROFILE_ZONE("goniometer");
+
+	const std::size_t first = first_sample > 0 ? (std::size_t)first_sample : 0;
+	const std::size_t last = last_sample < (double)num_samples ? (std::size_t)ceil(last_sample) : num_samples;
+
+	last_correlation = correlation(first, last);
+
+	// in uploaded pairs, then every step-th of those
+	const std::size_t a = first/upload_step;
+	const std::size_t b = (last + upload_step - 1)/upload_step < uploaded ? (last + upload_step - 1)/upload_step : uploaded;
+	const std::size_t count = b > a ? b - a : 0;
+	const std::size_t step = count > GONIOMETER_POINTS_PER_FRAME ? (count + GONIOMETER_POINTS_PER_FRAME - 1)/GONIOMETER_POINTS_PER_FRAME : 1;
+	const std::size_t points = (count + step - 1)/step;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, accum_FBOid);
+	glViewport(0, 0, GONIOMETER_SIZE, GONIOMETER_SIZE);
+	glClearColor(0.0, 0.0, 0.0, 0.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glClearColor(1.0, 1.0, 1.0, 1.0);
+
+	glEnable(GL_BLEND);
+
+	if (points) {
+
+		// the skipping is all in the stride; attribute 1 isn't there at all
+		glDisableVertexAttribArray(1);
+		glBindBuffer(GL_ARRAY_BUFFER, pairs_VBOid);
+		glVertexAttribPointer(0, 2, GL_SHORT, GL_TRUE, (GLsizei)(step*2*sizeof(short)), BUFFER_OFFSET(a*2*sizeof(short)));
+
+		glBlendFunc(GL_ONE, GL_ONE);
+		glUseProgram(points_program->programHandle());
+		// the same energy in total, however many points
+		glUniform1f(intensity_loc, 1.0f/points);
+		glDrawArrays(GL_POINTS, 0, (GLsizei)points);
+
+		glEnableVertexAttribArray(1);
+	}
+
+	// the panel
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(x, y, GONIOMETER_SIZE, GONIOMETER_SIZE);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glUseProgram(tonemap_program->programHandle());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, accum_texture);
+	glUniform1i(tonemap_texture_loc, 0);
+	glUniform1f(exposure_loc, exposure);
+	drawQuad();
+
+	glViewport(0, 0, WIN_W, WIN_H);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+
+#endif
+
+}
@@ -0,0 +1,52 @@
+#ifndef GONIOMETER_H
+#define GONIOMETER_H
+
+#include <cstddef>
+
+#include "gl_includes.h"
+#include "wav_source.h"
+
+// Stereo X/Y view: every left/right pair of the visible range as a point,
+// rotated 45 degrees so mono is the vertical line and out of phase the
+// horizontal one. While the panel is on, the file's pairs are up as they
+// are in a vertex buffer of int16 pairs; points are added into a small
+// float target and tone-mapped into a square panel. Past a few points per panel
+// pixel more of them don't change the picture, so beyond that every
+// step-th one is drawn (the attribute stride does the skipping), each
+// carrying step times the energy.
+//
+// The phase correlation of the same range comes from per-block sums of
+// L*L, R*R and L*R, made with SSE2 while the pairs are uploaded, plus the
+// partial blocks at both ends.
+//
+// GL 3.3 only.
+
+static const std::size_t GONIOMETER_SIZE = 256;				// pixels, the panel and its target
+static const std::size_t GONIOMETER_POINTS_PER_FRAME = 4*GONIOMETER_SIZE*GONIOMETER_SIZE;	// a few per pixel say it all
+static const std::size_t GONIOMETER_MAX_PAIRS = 1 << 24;	// uploaded; longer files are decimated on the way up
+static const std::size_t GONIOMETER_BLOCK = 4096;			// pairs per correlation block
+
+namespace Goniometer {
+
+	bool init(GLuint quad_VBOid);
+	void destroy();
+
+	// a new file, NULL drops it. Its pairs go up and the correlation sums are
+	// made at the first draw(), so a file opened with the panel off costs nothing.
+	void setSource(const WavSource *source);
+
+	// lets go of the pairs and the sums (the panel was switched off), draw() makes them again
+	void unload();
+
+	// the pairs [first_sample, last_sample), into a panel at window x, y (lower left corner, from the bottom)
+	void draw(double first_sample, double last_sample, int x, int y, GLuint framebuffer);
+
+	// of the range the last draw() covered, in [-1, 1]; 0 for silence
+	double correlation();
+
+	// of any range, straight from the sums; 0 until the first draw()
+	double correlation(std::size_t first, std::size_t last);
+
+};
+
+#endif
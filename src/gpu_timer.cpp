@@ -0,0 +1,98 @@
+#include "gpu_timer.h"
+#include "profiler.h"
+
+namespace {
+
+	GLuint queries[2][GPU_PASS_COUNT];
+	bool issued[2][GPU_PASS_COUNT];
+	double results_ms[GPU_PASS_COUNT];
+	unsigned int frame = 0;
+	bool initialized = false;
+
+	const char *pass_names[GPU_PASS_COUNT] = { "wave", "text", "resolve", "swap" };
+
+	// counter track names for the trace export
+	const char *counter_names[GPU_PASS_COUNT] = { "gpu drawWave ms", "gpu drawText ms", "gpu resolve ms", "gpu swap ms" };
+
+}
+
+bool GPUTimer::init() {
+
+	glGenQueries(2*GPU_PASS_COUNT, &queries[0][0]);
+
+	for (int i = 0; i < GPU_PASS_COUNT; ++i) {
+		issued[0][i] = issued[1][i] = false;
+		results_ms[i] = 0.0;
+	}
+
+	GLenum err = glGetError();
+	if (err != GL_NO_ERROR) {
+		printf("GPUTimer: timer queries unavailable (gl error %d), GPU pass timing disabled.\n", (int)err);
+		return false;
+	}
+
+	initialized = true;
+	return true;
+
+}
+
+void GPUTimer::destroy() {
+
+	if (!initialized) return;
+	glDeleteQueries(2*GPU_PASS_COUNT, &queries[0][0]);
+	initialized = false;
+
+}
+
+void GPUTimer::begin(int pass) {
+
+	if (!initialized) return;
+	glBeginQuery(GL_TIME_ELAPSED, queries[frame & 1][pass]);
+
+}
+
+void GPUTimer::end(int pass) {
+
+	if (!initialized) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	issued[frame & 1][pass] = true;
+
+}
+
+void GPUTimer::endFrame() {
+
+	if (!initialized) return;
+
+	++frame;
+
+	// the set we're about to record into was issued a frame ago;
+	// read back whatever has already landed.
+	const unsigned int set = frame & 1;
+
+	for (int i = 0; i < GPU_PASS_COUNT; ++i) {
+
+		if (!issued[set][i]) continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(queries[set][i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (available) {
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(queries[set][i], GL_QUERY_RESULT, &ns);
+			results_ms[i] = double(ns)/1000000.0;
+			Profiler::counter(counter_names[i], results_ms[i]);
+		}
+		// if it isn't ready, the old value is kept and the query gets reissued
+
+		issued[set][i] = false;
+	}
+
+}
+
+double GPUTimer::getMilliSeconds(int pass) {
+	return results_ms[pass];
+}
+
+const char *GPUTimer::passName(int pass) {
+	return pass_names[pass];
+}
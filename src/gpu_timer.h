@@ -0,0 +1,30 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "gl_includes.h"
+
+// GL_TIME_ELAPSED queries around each render pass. There are two sets of
+// query objects; frame N records into set N%2 while set (N+1)%2 (issued
+// the frame before) is read back, so fetching the results never stalls
+// the pipeline. The numbers shown are thus one frame behind.
+
+enum { GPU_PASS_WAVE, GPU_PASS_TEXT, GPU_PASS_RESOLVE, GPU_PASS_SWAP, GPU_PASS_COUNT };
+
+namespace GPUTimer {
+
+	bool init();
+	void destroy();
+
+	void begin(int pass);
+	void end(int pass);
+
+	// collects whatever results are ready and flips the query sets.
+	// call once per frame, after the swap.
+	void endFrame();
+
+	double getMilliSeconds(int pass);
+	const char *passName(int pass);
+
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "hash.h"
+
+#include <cstring>
+
+namespace {
+
+	static const hash64_t prime1 = 11400714785074694791ULL;
+	static const hash64_t prime2 = 14029467366897019727ULL;
+	static const hash64_t prime3 = 1609587929392839161ULL;
+	static const hash64_t prime4 = 9650029242287828579ULL;
+	static const hash64_t prime5 = 2870177450012600261ULL;
+
+	inline hash64_t rotl(hash64_t x, int r) {
+		return (x << r) | (x >> (64 - r));
+	}
+
+	// unaligned little endian reads; every platform we build for is little endian
+	inline hash64_t read64(const unsigned char *p) {
+		hash64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline hash64_t read32(const unsigned char *p) {
+		unsigned int v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline hash64_t round(hash64_t acc, hash64_t input) {
+		acc += input * prime2;
+		acc = rotl(acc, 31);
+		return acc * prime1;
+	}
+
+	inline hash64_t mergeRound(hash64_t acc, hash64_t val) {
+		acc ^= round(0, val);
+		return acc * prime1 + prime4;
+	}
+
+}
+
+hash64_t hash64(const void *data, std::size_t length, hash64_t seed) {
+
+	const unsigned char *p = static_cast<const unsigned char*>(data);
+	const unsigned char *end = p + length;
+	hash64_t h;
+
+	if (length >= 32) {
+		// four independent lanes, which is where the speed comes from
+		hash64_t v1 = seed + prime1 + prime2;
+		hash64_t v2 = seed + prime2;
+		hash64_t v3 = seed;
+		hash64_t v4 = seed - prime1;
+
+		const unsigned char *limit = end - 32;
+		do {
+			v1 = round(v1, read64(p)); p += 8;
+			v2 = round(v2, read64(p)); p += 8;
+			v3 = round(v3, read64(p)); p += 8;
+			v4 = round(v4, read64(p)); p += 8;
+		} while (p <= limit);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = mergeRound(h, v1);
+		h = mergeRound(h, v2);
+		h = mergeRound(h, v3);
+		h = mergeRound(h, v4);
+	}
+	else {
+		h = seed + prime5;
+	}
+
+	h += (hash64_t)length;
+
+	while (p + 8 <= end) {
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * prime1 + prime4;
+		p += 8;
+	}
+
+	if (p + 4 <= end) {
+		h ^= read32(p) * prime1;
+		h = rotl(h, 23) * prime2 + prime3;
+		p += 4;
+	}
+
+	while (p < end) {
+		h ^= (*p) * prime5;
+		h = rotl(h, 11) * prime1;
+		++p;
+	}
+
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	h *= prime3;
+	h ^= h >> 32;
+
+	return h;
+
+}
@@ -0,0 +1,14 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+
+// 64-bit non-cryptographic hash (the XXH64 algorithm), used to key the
+// on-disk LOD cache. Fast enough that hashing a few hundred KiB of a file
+// doesn't show up next to opening it.
+
+typedef unsigned long long hash64_t;
+
+hash64_t hash64(const void *data, std::size_t length, hash64_t seed = 0);
+
+#endif
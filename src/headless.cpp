@@ -0,0 +1,117 @@
+#include "headless.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdio>
+
+namespace {
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+	GLuint FBOid = 0, colorRBid = 0;
+
+	EGLDisplay openDisplay() {
+
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+		if (getPlatformDisplay) {
+			EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (d != EGL_NO_DISPLAY) return d;
+		}
+
+		printf("Headless: no surfaceless platform, trying the default EGL display.\n");
+		return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+}
+
+bool Headless::createContext(int width, int height) {
+
+	display = openDisplay();
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		printf("Headless: eglInitialize failed (0x%x).\n", eglGetError());
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		printf("Headless: desktop GL not available through EGL.\n");
+		return false;
+	}
+
+	static const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+
+	EGLConfig config = NULL;
+	EGLint num_configs = 0;
+	eglChooseConfig(display, config_attribs, &config, 1, &num_configs);
+
+	// the shaders are GLSL 330, and the drawing code still uses a few compatibility-only calls
+	static const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	context = eglCreateContext(display, num_configs ? config : (EGLConfig)0, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT) {
+		printf("Headless: eglCreateContext failed (0x%x).\n", eglGetError());
+		return false;
+	}
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		printf("Headless: eglMakeCurrent failed (0x%x), EGL_KHR_surfaceless_context missing?\n", eglGetError());
+		return false;
+	}
+
+	glGenRenderbuffers(1, &colorRBid);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRBid);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenFramebuffers(1, &FBOid);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBOid);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBid);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Headless: offscreen framebuffer incomplete.\n");
+		return false;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	printf("Headless: EGL %d.%d, %s\n", major, minor, renderer());
+
+	return true;
+
+}
+
+void Headless::destroyContext() {
+
+	if (FBOid) glDeleteFramebuffers(1, &FBOid);
+	if (colorRBid) glDeleteRenderbuffers(1, &colorRBid);
+	FBOid = colorRBid = 0;
+
+	if (display != EGL_NO_DISPLAY) {
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+		eglTerminate(display);
+	}
+	display = EGL_NO_DISPLAY;
+	context = EGL_NO_CONTEXT;
+
+}
+
+GLuint Headless::framebuffer() {
+	return FBOid;
+}
+
+const char *Headless::renderer() {
+	return (const char*)glGetString(GL_RENDERER);
+}
@@ -0,0 +1,23 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "gl_includes.h"
+
+// Windowless GL context for machines without a display (CI boxes running
+// mesa's llvmpipe). Uses EGL on the surfaceless platform, falling back to
+// the default EGL display with a pbuffer-less context. Since there's no
+// default framebuffer, an offscreen one of the same size stands in for it.
+
+namespace Headless {
+
+	bool createContext(int width, int height);
+	void destroyContext();
+
+	// bind this wherever the windowed build would bind framebuffer 0
+	GLuint framebuffer();
+
+	const char *renderer();
+
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "input_trace.h"
+#include "timer.h"
+
+#include <cstdio>
+
+#pragma warning(disable:4996)
+
+namespace {
+
+	static const char *trace_magic = "waveplot-input-trace";
+	static const int trace_version = 1;
+
+	FILE *record_fp = NULL;
+	timer_tick_t record_start = 0;
+
+	std::vector<input_event> events;
+	std::size_t replay_pos = 0;
+	bool replay_loaded = false;
+
+	std::vector<frame_timing> timings;
+
+}
+
+bool InputTrace::startRecording(const std::string &filename) {
+
+	record_fp = fopen(filename.c_str(), "w");
+	if (!record_fp) {
+		printf("InputTrace: couldn't open %s for writing.\n", filename.c_str());
+		return false;
+	}
+
+	fprintf(record_fp, "%s %d\n", trace_magic, trace_version);
+	record_start = Timer::get();
+
+	return true;
+
+}
+
+void InputTrace::record(int type, int x, int y) {
+
+	if (!record_fp) return;
+
+	const double t = Timer::ticksToMicroSeconds(Timer::get() - record_start)/1000000.0;
+	fprintf(record_fp, "%.6f %d %d %d\n", t, type, x, y);
+
+}
+
+void InputTrace::stopRecording() {
+
+	if (!record_fp) return;
+	fclose(record_fp);
+	record_fp = NULL;
+
+}
+
+bool InputTrace::recording() {
+	return record_fp != NULL;
+}
+
+bool InputTrace::load(const std::string &filename) {
+
+	FILE *fp = fopen(filename.c_str(), "r");
+	if (!fp) {
+		printf("InputTrace: couldn't open %s.\n", filename.c_str());
+		return false;
+	}
+
+	char magic[32];
+	int version = 0;
+	if (fscanf(fp, "%31s %d", magic, &version) != 2 || std::string(magic) != trace_magic || version != trace_version) {
+		printf("InputTrace: %s isn't a version %d input trace.\n", filename.c_str(), trace_version);
+		fclose(fp);
+		return false;
+	}
+
+	events.clear();
+	input_event e;
+	while (fscanf(fp, "%lf %d %d %d", &e.t, &e.type, &e.x, &e.y) == 4) {
+		events.push_back(e);
+	}
+	fclose(fp);
+
+	replay_pos = 0;
+	replay_loaded = true;
+
+	printf("InputTrace: loaded %u events (%.2f s) from %s.\n",
+		(unsigned)events.size(), events.empty() ? 0.0 : events.back().t, filename.c_str());
+
+	return true;
+
+}
+
+bool InputTrace::replaying() {
+	return replay_loaded;
+}
+
+bool InputTrace::next(double t, input_event *e) {
+
+	if (replay_pos >= events.size() || events[replay_pos].t > t) {
+		return false;
+	}
+	*e = events[replay_pos++];
+	return true;
+
+}
+
+bool InputTrace::finished() {
+	return replay_pos >= events.size();
+}
+
+void InputTrace::addFrameTiming(const frame_timing &f) {
+	timings.push_back(f);
+}
+
+bool InputTrace::writeFrameTimings(const std::string &filename) {
+
+	FILE *fp = fopen(filename.c_str(), "w");
+	if (!fp) {
+		printf("InputTrace: couldn't open %s for writing.\n", filename.c_str());
+		return false;
+	}
+
+	double cpu = 0, gpu = 0, wall = 0;
+
+	fprintf(fp, "{\"frames\":[\n");
+	for (std::size_t i = 0; i < timings.size(); ++i) {
+		const frame_timing &f = timings[i];
+		fprintf(fp, "%s{\"t\":%.4f,\"cpu_ms\":%.4f,\"gpu_ms\":%.4f,\"frame_ms\":%.4f}",
+			i ? ",\n" : "", f.t, f.cpu_ms, f.gpu_ms, f.frame_ms);
+		cpu += f.cpu_ms; gpu += f.gpu_ms; wall += f.frame_ms;
+	}
+	const double n = timings.empty() ? 1.0 : double(timings.size());
+	fprintf(fp, "\n],\"mean_cpu_ms\":%.4f,\"mean_gpu_ms\":%.4f,\"mean_frame_ms\":%.4f}\n", cpu/n, gpu/n, wall/n);
+	fclose(fp);
+
+	printf("InputTrace: %u frames, mean cpu %.3f ms, gpu %.3f ms, frame %.3f ms -> %s\n",
+		(unsigned)timings.size(), cpu/n, gpu/n, wall/n, filename.c_str());
+
+	return true;
+
+}
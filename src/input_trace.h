@@ -0,0 +1,48 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <string>
+#include <vector>
+
+// Recording and replay of the navigation input (mouse drags, wheel, toggle
+// keys), so two builds can be timed on exactly the same camera path.
+// Events are timestamped in seconds from the start of the recording; on
+// replay they're released by a virtual clock that advances a fixed amount
+// per frame, independent of how fast either build actually renders.
+
+enum { INPUT_BUTTON_DOWN, INPUT_BUTTON_UP, INPUT_MOUSE_MOVE, INPUT_WHEEL, INPUT_KEY };
+
+struct input_event {
+	double t;
+	int type;
+	int x, y;	// cursor position; for INPUT_WHEEL x is the delta, for INPUT_KEY the key code
+	input_event() {}
+	input_event(double t_, int type_, int x_, int y_) : t(t_), type(type_), x(x_), y(y_) {}
+};
+
+struct frame_timing {
+	double t;		// virtual clock
+	double cpu_ms;	// control() + draw() submission
+	double gpu_ms;	// sum of the GPU timers of draw()'s passes, not the swap
+	double frame_ms;	// wall time, including swap/finish
+};
+
+namespace InputTrace {
+
+	bool startRecording(const std::string &filename);
+	void record(int type, int x, int y);
+	void stopRecording();
+	bool recording();
+
+	bool load(const std::string &filename);
+	bool replaying();
+	// pops the next event due at virtual time t, false if there's none (yet)
+	bool next(double t, input_event *e);
+	bool finished();
+
+	void addFrameTiming(const frame_timing &f);
+	bool writeFrameTimings(const std::string &filename);
+
+};
+
+#endif
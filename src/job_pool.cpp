@@ -0,0 +1,129 @@
+#include "job_pool.h"
+#include "profiler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <cstdio>
+
+namespace {
+
+	struct job {
+		job_function f;
+		void *user;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<job> queue;
+	std::mutex lock;
+	std::condition_variable work_ready, job_done;
+	unsigned running = 0;
+	bool quitting = false;
+
+	void worker() {
+
+		std::unique_lock<std::mutex> l(lock);
+
+		for (;;) {
+			work_ready.wait(l, []() { return quitting || !queue.empty(); });
+			if (queue.empty()) return;	// only when quitting
+
+			const job j = queue.front();
+			queue.pop_front();
+			++running;
+
+			l.unlock();
+			{
+				PROFILE_ZONE("job");
+				j.f(j.user);
+			}
+			l.lock();
+
+			// whoever waits on a counter of their own checks it again
+			--running;
+			job_done.notify_all();
+		}
+
+	}
+
+}
+
+bool JobPool::init(unsigned threads) {
+
+	destroy();
+
+	if (!threads) {
+		const unsigned cores = std::thread::hardware_concurrency();
+		threads = cores > 1 ? cores - 1 : 1;
+	}
+
+	quitting = false;
+	for (unsigned i = 0; i < threads; ++i) {
+		workers.push_back(std::thread(worker));
+	}
+
+	printf("JobPool: %u worker thread(s).\n", threads);
+	return true;
+
+}
+
+void JobPool::destroy() {
+
+	{
+		std::lock_guard<std::mutex> l(lock);
+		quitting = true;
+	}
+	work_ready.notify_all();
+
+	// the queue is finished first, see worker()
+	for (std::size_t i = 0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+	workers.clear();
+
+}
+
+void JobPool::submit(job_function f, void *user) {
+
+	// without workers it's done right here
+	if (workers.empty()) {
+		f(user);
+		return;
+	}
+
+	job j = { f, user };
+	{
+		std::lock_guard<std::mutex> l(lock);
+		queue.push_back(j);
+	}
+	work_ready.notify_one();
+
+}
+
+void JobPool::wait() {
+
+	std::unique_lock<std::mutex> l(lock);
+	job_done.wait(l, []() { return queue.empty() && !running; });
+
+}
+
+void JobPool::wait(const std::atomic<int> &outstanding) {
+
+	// the job's decrement comes before the lock its worker takes to notify, so it can't be missed
+	std::unique_lock<std::mutex> l(lock);
+	job_done.wait(l, [&outstanding]() { return outstanding.load(std::memory_order_acquire) <= 0; });
+
+}
+
+unsigned JobPool::threadCount() {
+	return (unsigned)workers.size();
+}
+
+std::size_t JobPool::queued() {
+
+	std::lock_guard<std::mutex> l(lock);
+	return queue.size();
+
+}
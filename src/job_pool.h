@@ -0,0 +1,45 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <cstddef>
+#include <atomic>
+
+// A few worker threads eating jobs off one queue, first in first out.
+// Jobs are plain function + pointer pairs and mustn't touch GL; whatever
+// they make is handed back to the main thread through the user data (and
+// an atomic flag or two in there). Nothing is ever cancelled: owners of
+// data a job may still be reading wait for their jobs before letting go of
+// it. They count them in an atomic of their own, up before submit() and
+// down as the very last thing the job does, so one owner waiting doesn't
+// hold up the main thread for everyone else's work.
+
+typedef void (*job_function)(void *user);
+
+namespace JobPool {
+
+	// 0 threads picks one less than the cores, at least one
+	bool init(unsigned threads = 0);
+	void destroy();
+
+	void submit(job_function f, void *user);
+
+	// until the queue is empty and no job is running
+	void wait();
+
+	// until outstanding is down to 0, however busy the pool is with other jobs
+	void wait(const std::atomic<int> &outstanding);
+
+	unsigned threadCount();
+	std::size_t queued();
+
+	// for main(): the pool runs for as long as this is in scope, so no way
+	// out of it leaves the workers waiting on a condition variable that's
+	// about to be destroyed (destroy() again after an explicit one is fine)
+	struct Scope {
+		Scope() { init(); }
+		~Scope() { destroy(); }
+	};
+
+};
+
+#endif
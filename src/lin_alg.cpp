@@ -0,0 +1,102 @@
+#include "lin_alg.h"
+
+#include <cstdio>
+#include <cstring>
+
+vec4::vec4() {
+	data[0] = data[1] = data[2] = data[3] = 0.0f;
+}
+
+vec4::vec4(float x, float y, float z, float w) {
+	data[0] = x; data[1] = y; data[2] = z; data[3] = w;
+}
+
+vec4 &vec4::operator+=(const vec4 &b) {
+	for (int i = 0; i < 4; ++i) data[i] += b.data[i];
+	return *this;
+}
+
+vec4 &vec4::operator*=(float s) {
+	for (int i = 0; i < 4; ++i) data[i] *= s;
+	return *this;
+}
+
+vec4 vec4::operator+(const vec4 &b) const {
+	vec4 r(*this);
+	r += b;
+	return r;
+}
+
+vec4 vec4::operator*(float s) const {
+	vec4 r(*this);
+	r *= s;
+	return r;
+}
+
+void vec4::print() const {
+	printf("(%.4f, %.4f, %.4f, %.4f)\n", data[0], data[1], data[2], data[3]);
+}
+
+vec4 operator*(float s, const vec4 &v) {
+	return v*s;
+}
+
+mat4::mat4(int type) {
+	memset(data, 0, sizeof(data));
+	if (type == MAT_IDENTITY) {
+		data[0] = data[5] = data[10] = data[15] = 1.0f;
+	}
+}
+
+mat4::mat4(const float *column_major) {
+	memcpy(data, column_major, sizeof(data));
+}
+
+mat4 mat4::identity() {
+	return mat4(MAT_IDENTITY);
+}
+
+// same as glOrtho
+mat4 mat4::proj_ortho(float left, float right, float bottom, float top, float near_plane, float far_plane) {
+
+	mat4 m;
+	m.assign(0, 0, 2.0f/(right - left));
+	m.assign(1, 1, 2.0f/(top - bottom));
+	m.assign(2, 2, -2.0f/(far_plane - near_plane));
+	m.assign(3, 0, -(right + left)/(right - left));
+	m.assign(3, 1, -(top + bottom)/(top - bottom));
+	m.assign(3, 2, -(far_plane + near_plane)/(far_plane - near_plane));
+	m.assign(3, 3, 1.0f);
+	return m;
+
+}
+
+mat4 mat4::operator*(const mat4 &b) const {
+
+	mat4 r;
+	for (int c = 0; c < 4; ++c) {
+		for (int i = 0; i < 4; ++i) {
+			float sum = 0.0f;
+			for (int k = 0; k < 4; ++k) sum += (*this)(k, i)*b(c, k);
+			r.assign(c, i, sum);
+		}
+	}
+	return r;
+
+}
+
+vec4 mat4::operator*(const vec4 &v) const {
+
+	vec4 r;
+	for (int i = 0; i < 4; ++i) {
+		r.assign(i, (*this)(0, i)*v(0) + (*this)(1, i)*v(1) + (*this)(2, i)*v(2) + (*this)(3, i)*v(3));
+	}
+	return r;
+
+}
+
+void mat4::print() const {
+	for (int i = 0; i < 4; ++i) {
+		printf("%10.4f %10.4f %10.4f %10.4f\n", (*this)(0, i), (*this)(1, i), (*this)(2, i), (*this)(3, i));
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef LIN_ALG_H
+#define LIN_ALG_H
+
+// The little bit of vector and matrix math the renderer needs. Matrices are
+// column major, like GL wants them with transpose = GL_FALSE, so
+// assign(column, row, value) and rawData() go straight to glUniformMatrix4fv.
+
+enum { MAT_ZERO = 0, MAT_IDENTITY = 1 };
+
+class vec4 {
+
+	float data[4];
+
+public:
+
+	vec4();
+	vec4(float x, float y, float z, float w);
+
+	float operator()(int i) const { return data[i]; }
+	void assign(int i, float value) { data[i] = value; }
+
+	vec4 &operator+=(const vec4 &b);
+	vec4 &operator*=(float s);
+	vec4 operator+(const vec4 &b) const;
+	vec4 operator*(float s) const;
+
+	void print() const;
+
+};
+
+vec4 operator*(float s, const vec4 &v);
+
+class mat4 {
+
+	float data[16];
+
+public:
+
+	explicit mat4(int type = MAT_ZERO);
+	explicit mat4(const float *column_major);
+
+	static mat4 identity();
+	static mat4 proj_ortho(float left, float right, float bottom, float top, float near_plane, float far_plane);
+
+	float operator()(int column, int row) const { return data[column*4 + row]; }
+	void assign(int column, int row, float value) { data[column*4 + row] = value; }
+	const float *rawData() const { return data; }
+
+	mat4 operator*(const mat4 &b) const;
+	vec4 operator*(const vec4 &v) const;
+
+	void print() const;
+
+};
+
+// only here for the camera's rotation, which nothing turns yet
+struct Quaternion {
+	float x, y, z, w;
+	Quaternion() : x(0.0f), y(0.0f), z(0.0f), w(1.0f) {}
+};
+
+#endif
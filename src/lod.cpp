@@ -0,0 +1,485 @@
+#include "lod.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LOD_SSE2
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+
+	inline float toInt16Scale(short s) { return s; }
+	inline float toInt16Scale(float s) { return s*32768.0f; }
+
+	inline short clampInt16(float v) {
+		return (short)(v > 32767.0f ? 32767 : (v < -32768.0f ? -32768 : v));
+	}
+
+	template <typename S>
+	void buildBase(const S *samples, std::size_t count, std::size_t bin_size, lod_bin *bins, lod_stats *stats) {
+
+		for (std::size_t b = 0, i = 0; i < count; ++b) {
+			const std::size_t end = (i + bin_size < count) ? i + bin_size : count;
+			const std::size_t n = end - i;
+
+			float lo = toInt16Scale(samples[i]), hi = lo;
+			double sum = 0.0, sum_sq = 0.0;
+			unsigned int clips = 0;
+			for (; i < end; ++i) {
+				const float v = toInt16Scale(samples[i]);
+				if (v < lo) lo = v;
+				if (v > hi) hi = v;
+				sum += v;
+				sum_sq += (double)v*v;
+				clips += (v >= 32767.0f || v <= -32768.0f);
+			}
+
+			bins[b].min = clampInt16(lo);
+			bins[b].max = clampInt16(hi);
+			bins[b].rms = (float)sqrt(sum_sq/n);
+			stats[b].mean = (float)(sum/n);
+			stats[b].clips = clips;
+		}
+
+	}
+
+#ifdef LOD_SSE2
+	// the same for int16, eight samples at a time; the short last bin goes to the one above
+	void buildBase(const short *samples, std::size_t count, std::size_t bin_size, lod_bin *bins, lod_stats *stats) {
+
+		const std::size_t full = count/bin_size;
+		const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+		const __m128i top = _mm_set1_epi16(32767), bottom = _mm_set1_epi16(-32768);
+
+		for (std::size_t b = 0; b < full; ++b) {
+
+			const short *s = samples + b*bin_size;
+			__m128i lo = top, hi = bottom;
+			__m128i sum = zero, sum_sq = zero, clips = zero;
+
+			// bin_size is a multiple of 8, and small enough for the 32-bit sums and 16-bit counts
+			for (std::size_t i = 0; i < bin_size; i += 8) {
+				const __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+				lo = _mm_min_epi16(lo, v);
+				hi = _mm_max_epi16(hi, v);
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(v, ones));
+				// pairs of squares go up to 2^31, fine as unsigned, widened to 64 bits
+				const __m128i sq = _mm_madd_epi16(v, v);
+				sum_sq = _mm_add_epi64(sum_sq, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero), _mm_unpackhi_epi32(sq, zero)));
+				// a match is -1
+				clips = _mm_sub_epi16(clips, _mm_or_si128(_mm_cmpeq_epi16(v, top), _mm_cmpeq_epi16(v, bottom)));
+			}
+
+			short l[8], h[8], c[8];
+			int s32[4];
+			unsigned long long q[2];
+			_mm_storeu_si128((__m128i*)l, lo);
+			_mm_storeu_si128((__m128i*)h, hi);
+			_mm_storeu_si128((__m128i*)c, clips);
+			_mm_storeu_si128((__m128i*)s32, sum);
+			_mm_storeu_si128((__m128i*)q, sum_sq);
+
+			short mn = l[0], mx = h[0];
+			unsigned int clip_count = 0;
+			for (int k = 0; k < 8; ++k) {
+				if (l[k] < mn) mn = l[k];
+				if (h[k] > mx) mx = h[k];
+				clip_count += (unsigned short)c[k];
+			}
+
+			bins[b].min = mn;
+			bins[b].max = mx;
+			bins[b].rms = (float)sqrt((double)(q[0] + q[1])/bin_size);
+			stats[b].mean = (float)((double)(s32[0] + s32[1] + s32[2] + s32[3])/bin_size);
+			stats[b].clips = clip_count;
+		}
+
+		if (full*bin_size < count) {
+			buildBase<short>(samples + full*bin_size, count - full*bin_size, bin_size, bins + full, stats + full);
+		}
+
+	}
+#endif
+
+	enum { BAND_LOW, BAND_MID, BAND_HIGH, BAND_COUNT };
+
+	// the state variable filter in its trapezoidal form (Simper's): one
+	// biquad's worth of state with low, band and high pass outputs that add
+	// up to the input. With its two poles real and at LOD_LOW_HZ and
+	// LOD_HIGH_HZ those are the three bands. The coefficients and the
+	// history live in the caller's lod_build_state.
+	//
+	// from 44.1 kHz up the filter only sees every other sample. What folds
+	// over from above the new Nyquist lands above LOD_HIGH_HZ unless it's
+	// ultrasonic, and folding keeps its energy, so the bands hardly change
+	// for half the work.
+	const std::size_t WARMUP = LOD_BAND_WARMUP;
+
+	const std::size_t BAND_PIECE = 1 << 18;	// samples, a multiple of LOD_BASE_BIN
+
+	struct band_state {
+		float ic1, ic2;
+	};
+
+	void makeBandFilter(double low_hz, double high_hz, double rate, lod_build_state &f) {
+
+		if (high_hz > 0.45*rate) high_hz = 0.45*rate;
+		if (low_hz > 0.5*high_hz) low_hz = 0.5*high_hz;
+
+		// (s + low)(s + high) = s^2 + (w0/Q)s + w0^2
+		const double f0 = sqrt(low_hz*high_hz), k = (low_hz + high_hz)/f0;
+		const double g = tan(M_PI*f0/rate);
+		const double a1 = 1/(1 + g*(g + k));
+
+		f.a1 = (float)a1;
+		f.a2 = (float)(g*a1);
+		f.a3 = (float)(g*g*a1);
+		f.k = (float)k;
+
+	}
+
+	inline void stepBands(const lod_build_state &c, float x, band_state &st, float *sq) {
+		const float v3 = x - st.ic2;
+		const float v1 = c.a1*st.ic1 + c.a2*v3;
+		const float v2 = st.ic2 + c.a2*st.ic1 + c.a3*v3;
+		st.ic1 = 2*v1 - st.ic1;
+		st.ic2 = 2*v2 - st.ic2;
+		const float band = c.k*v1, high = x - band - v2;
+		sq[BAND_LOW] += v2*v2;
+		sq[BAND_MID] += band*band;
+		sq[BAND_HIGH] += high*high;
+	}
+
+	inline unsigned short toBandRms(double sum_sq, double n) {
+		const double rms = sqrt(sum_sq/n);
+		return (unsigned short)(rms > 65535.0 ? 65535.0 : rms + 0.5);
+	}
+
+	inline void storeBands(lod_bands &b, const float *sq, std::size_t n) {
+		b.low = toBandRms(sq[BAND_LOW], (double)n);
+		b.mid = toBandRms(sq[BAND_MID], (double)n);
+		b.high = toBandRms(sq[BAND_HIGH], (double)n);
+		b.pad = 0;
+	}
+
+	inline unsigned short mergeBandRms(unsigned short l, unsigned short r, double nl, double nr) {
+		return toBandRms(l*(double)l*nl + r*(double)r*nr, nl + nr);
+	}
+
+#ifdef LOD_SSE2
+	struct band_coefs {
+		__m128 a1, a2, a3, k;
+	};
+
+	// four stretches one step on, adding the squares to acc (if any)
+	inline void stepBandLanes(const band_coefs &c, __m128 x, __m128 &ic1, __m128 &ic2, __m128 *acc) {
+		const __m128 v3 = _mm_sub_ps(x, ic2);
+		const __m128 v1 = _mm_add_ps(_mm_mul_ps(c.a1, ic1), _mm_mul_ps(c.a2, v3));
+		const __m128 v2 = _mm_add_ps(_mm_add_ps(ic2, _mm_mul_ps(c.a2, ic1)), _mm_mul_ps(c.a3, v3));
+		ic1 = _mm_sub_ps(_mm_add_ps(v1, v1), ic1);
+		ic2 = _mm_sub_ps(_mm_add_ps(v2, v2), ic2);
+		if (!acc) return;
+		const __m128 band = _mm_mul_ps(c.k, v1), high = _mm_sub_ps(_mm_sub_ps(x, band), v2);
+		acc[BAND_LOW] = _mm_add_ps(acc[BAND_LOW], _mm_mul_ps(v2, v2));
+		acc[BAND_MID] = _mm_add_ps(acc[BAND_MID], _mm_mul_ps(band, band));
+		acc[BAND_HIGH] = _mm_add_ps(acc[BAND_HIGH], _mm_mul_ps(high, high));
+	}
+
+	inline __m128 laneSamples(const short *p, std::size_t stride, std::ptrdiff_t i) {
+		return _mm_setr_ps(p[i], p[stride + i], p[2*stride + i], p[3*stride + i]);
+	}
+
+	inline __m128 laneSamples(const float *p, std::size_t stride, std::ptrdiff_t i) {
+		return _mm_mul_ps(_mm_setr_ps(p[i], p[stride + i], p[2*stride + i], p[3*stride + i]), _mm_set1_ps(32768.0f));
+	}
+
+	// samples i, i + STEP, ... (four of them) of four stretches, stride apart, as
+	// x[t] = the stretches at i + t*STEP. gathering lane by lane every step costs
+	// more than the filter.
+	template <int STEP> __m128 fourSamples(const short *p);
+	template <int STEP> __m128 fourSamples(const float *p);
+
+	template <> inline __m128 fourSamples<1>(const short *p) {
+		const __m128i v = _mm_loadl_epi64((const __m128i*)p);
+		return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+	}
+
+	template <> inline __m128 fourSamples<2>(const short *p) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)p);
+		return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+	}
+
+	template <> inline __m128 fourSamples<1>(const float *p) {
+		return _mm_mul_ps(_mm_loadu_ps(p), _mm_set1_ps(32768.0f));
+	}
+
+	template <> inline __m128 fourSamples<2>(const float *p) {
+		const __m128 v = _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _MM_SHUFFLE(2, 0, 2, 0));
+		return _mm_mul_ps(v, _mm_set1_ps(32768.0f));
+	}
+
+	template <int STEP, typename S>
+	inline void laneSamples4(const S *p, std::size_t stride, std::ptrdiff_t i, __m128 *x) {
+		x[0] = fourSamples<STEP>(p + i);
+		x[1] = fourSamples<STEP>(p + stride + i);
+		x[2] = fourSamples<STEP>(p + 2*stride + i);
+		x[3] = fourSamples<STEP>(p + 3*stride + i);
+		_MM_TRANSPOSE4_PS(x[0], x[1], x[2], x[3]);
+	}
+
+	// the bins of eight equal stretches of lane samples each, side by side, two
+	// sets of SSE lanes so one set's multiplies fill the other's latency. st
+	// is left where the last stretch ends.
+	template <int STEP, typename S>
+	void addBandLanes(const lod_build_state &f, const S *samples, std::size_t lane, std::size_t bin_size, lod_bands *bands, band_state &st) {
+
+		const std::size_t lane_bins = lane/bin_size;
+
+		band_coefs c;
+		c.a1 = _mm_set1_ps(f.a1);
+		c.a2 = _mm_set1_ps(f.a2);
+		c.a3 = _mm_set1_ps(f.a3);
+		c.k = _mm_set1_ps(f.k);
+		__m128 ic1[2] = { _mm_setzero_ps(), _mm_setzero_ps() }, ic2[2] = { _mm_setzero_ps(), _mm_setzero_ps() };
+
+		// the first stretch runs in on the history, the others on the end of the stretch before
+		for (std::ptrdiff_t i = -(std::ptrdiff_t)WARMUP; i < 0; i += STEP) {
+			const __m128 x0 = _mm_setr_ps(f.history[WARMUP + i], toInt16Scale(samples[lane + i]),
+										  toInt16Scale(samples[2*lane + i]), toInt16Scale(samples[3*lane + i]));
+			stepBandLanes(c, x0, ic1[0], ic2[0], NULL);
+			stepBandLanes(c, laneSamples(samples + 4*lane, lane, i), ic1[1], ic2[1], NULL);
+		}
+
+		for (std::size_t b = 0; b < lane_bins; ++b) {
+
+			__m128 acc[2][BAND_COUNT];
+			for (int f = 0; f < BAND_COUNT; ++f) acc[0][f] = acc[1][f] = _mm_setzero_ps();
+
+			// bin_size is a multiple of 4*STEP
+			const std::ptrdiff_t end = (b + 1)*bin_size;
+			for (std::ptrdiff_t i = b*bin_size; i < end; i += 4*STEP) {
+				__m128 x0[4], x1[4];
+				laneSamples4<STEP>(samples, lane, i, x0);
+				laneSamples4<STEP>(samples + 4*lane, lane, i, x1);
+				for (int t = 0; t < 4; ++t) {
+					stepBandLanes(c, x0[t], ic1[0], ic2[0], acc[0]);
+					stepBandLanes(c, x1[t], ic1[1], ic2[1], acc[1]);
+				}
+			}
+
+			for (int v = 0; v < 2; ++v) {
+				float lanes[BAND_COUNT][4];
+				for (int f = 0; f < BAND_COUNT; ++f) _mm_storeu_ps(lanes[f], acc[v][f]);
+				for (int l = 0; l < 4; ++l) {
+					const float lane_sq[BAND_COUNT] = { lanes[BAND_LOW][l], lanes[BAND_MID][l], lanes[BAND_HIGH][l] };
+					storeBands(bands[(4*v + l)*lane_bins + b], lane_sq, bin_size/STEP);
+				}
+			}
+		}
+
+		float v[4];
+		_mm_storeu_ps(v, ic1[1]);
+		st.ic1 = v[3];
+		_mm_storeu_ps(v, ic2[1]);
+		st.ic2 = v[3];
+
+	}
+#endif
+
+	// the band energies of n samples' bins: eight stretches at once if
+	// they're long enough, and whatever is left over (fewer than eight bins,
+	// and a short last one) carrying on from the last stretch.
+	template <typename S>
+	void addBands(lod_build_state &f, const S *samples, std::size_t n, std::size_t bin_size, lod_bands *bands) {
+
+		band_state st = { 0.0f, 0.0f };
+		float sq[BAND_COUNT] = { 0.0f, 0.0f, 0.0f };
+		std::size_t done = 0;
+
+		const std::size_t lane = n/bin_size/8*bin_size;
+
+#ifdef LOD_SSE2
+		if (lane >= WARMUP) {
+			if (f.band_step == 2) addBandLanes<2>(f, samples, lane, bin_size, bands, st);
+			else addBandLanes<1>(f, samples, lane, bin_size, bands, st);
+			done = 8*lane;
+		}
+#endif
+
+		if (!done) {
+			for (std::size_t i = 0; i < WARMUP; i += f.band_step) stepBands(f, f.history[i], st, sq);
+		}
+
+		for (std::size_t first = done; first < n; first += bin_size) {
+			const std::size_t end = (first + bin_size < n) ? first + bin_size : n;
+			sq[BAND_LOW] = sq[BAND_MID] = sq[BAND_HIGH] = 0.0f;
+			for (std::size_t i = first; i < end; i += f.band_step) stepBands(f, toInt16Scale(samples[i]), st, sq);
+			storeBands(bands[first/bin_size], sq, (end - first + f.band_step - 1)/f.band_step);
+		}
+
+		// the next add() runs in on the end of this one
+		if (n >= WARMUP) {
+			for (std::size_t k = 0; k < WARMUP; ++k) f.history[k] = toInt16Scale(samples[n - WARMUP + k]);
+		}
+		else {
+			memmove(f.history, f.history + n, (WARMUP - n)*sizeof(float));
+			for (std::size_t k = 0; k < n; ++k) f.history[WARMUP - n + k] = toInt16Scale(samples[k]);
+		}
+
+	}
+
+	template <typename S>
+	void addSamples(lod_pyramid *p, lod_build_state &f, std::size_t first, const S *samples, std::size_t n) {
+		// level 0 is always ours (arena), only a loaded pyramid points into a mapping
+		lod_bin *bins = const_cast<lod_bin*>(p->levels[0]);
+		lod_bands *bands = const_cast<lod_bands*>(p->bands[0]);
+		lod_stats *stats = const_cast<lod_stats*>(p->stats[0]);
+
+		// a piece at a time, so the band pass finds the samples still in cache
+		for (std::size_t i = 0; i < n; i += BAND_PIECE) {
+			const std::size_t m = (i + BAND_PIECE < n) ? BAND_PIECE : n - i;
+			const std::size_t b = (first + i)/p->bin_size;
+			buildBase(samples + i, m, p->bin_size, bins + b, stats + b);
+			addBands(f, samples + i, m, p->bin_size, bands + b);
+		}
+	}
+
+}
+
+void LOD::begin(std::size_t count, Arena &arena, lod_pyramid *p, lod_build_state *state, unsigned int sample_rate) {
+
+	p->num_samples = count;
+	p->bin_size = LOD_BASE_BIN;
+	p->level_count = 0;
+	if (count == 0) return;
+
+	p->bin_count[0] = (count + LOD_BASE_BIN - 1) / LOD_BASE_BIN;
+	p->levels[0] = arena.allocArray<lod_bin>(MEM_LOD, p->bin_count[0]);
+	p->bands[0] = arena.allocArray<lod_bands>(MEM_LOD, p->bin_count[0]);
+	p->stats[0] = arena.allocArray<lod_stats>(MEM_LOD, p->bin_count[0]);
+	p->level_count = 1;
+
+	const double rate = sample_rate ? sample_rate : 44100;
+	state->band_step = rate >= 44100 ? 2 : 1;
+	makeBandFilter(LOD_LOW_HZ, LOD_HIGH_HZ, rate/state->band_step, *state);
+	memset(state->history, 0, sizeof(state->history));
+
+}
+
+void LOD::add(lod_pyramid *p, lod_build_state *state, std::size_t first, const short *samples, std::size_t n) {
+	addSamples(p, *state, first, samples, n);
+}
+
+void LOD::add(lod_pyramid *p, lod_build_state *state, std::size_t first, const float *samples, std::size_t n) {
+	addSamples(p, *state, first, samples, n);
+}
+
+void LOD::finish(Arena &arena, lod_pyramid *p) {
+
+	PROFILE_ZONE("lod levels");
+
+	if (p->level_count == 0) return;
+
+	const std::size_t count = p->num_samples;
+	const lod_bin *level = p->levels[0];
+	const lod_bands *level_bands = p->bands[0];
+	const lod_stats *level_stats = p->stats[0];
+	std::size_t bins = p->bin_count[0];
+
+	while (bins > 1 && p->level_count < LOD_MAX_LEVELS) {
+
+		const lod_bin *below = level;
+		const lod_bands *below_bands = level_bands;
+		const lod_stats *below_stats = level_stats;
+		const std::size_t below_bins = bins;
+		const std::size_t below_width = p->samplesPerBin(p->level_count - 1);
+
+		bins = (below_bins + 1) / 2;
+		lod_bin *merged = arena.allocArray<lod_bin>(MEM_LOD, bins);
+		lod_bands *merged_bands = arena.allocArray<lod_bands>(MEM_LOD, bins);
+		lod_stats *merged_stats = arena.allocArray<lod_stats>(MEM_LOD, bins);
+
+		for (std::size_t b = 0; b < bins; ++b) {
+			const lod_bin &l = below[2*b];
+			if (2*b + 1 == below_bins) {
+				merged[b] = l;
+				merged_bands[b] = below_bands[2*b];
+				merged_stats[b] = below_stats[2*b];
+				continue;
+			}
+			const lod_bin &r = below[2*b + 1];
+
+			// only the last bin of a level can be short, weigh the rms by sample count
+			const std::size_t r_begin = (2*b + 1)*below_width;
+			const double nl = (double)below_width;
+			const double nr = (double)((r_begin + below_width < count) ? below_width : count - r_begin);
+
+			merged[b].min = l.min < r.min ? l.min : r.min;
+			merged[b].max = l.max > r.max ? l.max : r.max;
+			merged[b].rms = (float)sqrt((l.rms*(double)l.rms*nl + r.rms*(double)r.rms*nr)/(nl + nr));
+
+			const lod_bands &lb = below_bands[2*b], &rb = below_bands[2*b + 1];
+			merged_bands[b].low = mergeBandRms(lb.low, rb.low, nl, nr);
+			merged_bands[b].mid = mergeBandRms(lb.mid, rb.mid, nl, nr);
+			merged_bands[b].high = mergeBandRms(lb.high, rb.high, nl, nr);
+			merged_bands[b].pad = 0;
+
+			const lod_stats &ls = below_stats[2*b], &rs = below_stats[2*b + 1];
+			merged_stats[b].mean = (float)((ls.mean*nl + rs.mean*nr)/(nl + nr));
+			merged_stats[b].clips = ls.clips + rs.clips;
+		}
+
+		level = merged;
+		level_bands = merged_bands;
+		level_stats = merged_stats;
+		p->levels[p->level_count] = level;
+		p->bands[p->level_count] = level_bands;
+		p->stats[p->level_count] = level_stats;
+		p->bin_count[p->level_count] = bins;
+		++p->level_count;
+	}
+
+}
+
+void LOD::build(const short *samples, std::size_t count, Arena &arena, lod_pyramid *p, unsigned int sample_rate) {
+	PROFILE_ZONE("lod");
+	lod_build_state state;
+	begin(count, arena, p, &state, sample_rate);
+	if (count) add(p, &state, 0, samples, count);
+	finish(arena, p);
+}
+
+void LOD::build(const float *samples, std::size_t count, Arena &arena, lod_pyramid *p, unsigned int sample_rate) {
+	PROFILE_ZONE("lod");
+	lod_build_state state;
+	begin(count, arena, p, &state, sample_rate);
+	if (count) add(p, &state, 0, samples, count);
+	finish(arena, p);
+}
+
+int LOD::levelFor(const lod_pyramid &p, double samples_per_pixel) {
+
+	int level = -1;
+	while (level + 1 < p.level_count && (double)p.samplesPerBin(level + 1) <= samples_per_pixel) {
+		++level;
+	}
+	return level;
+
+}
+
+std::size_t LOD::bytes(const lod_pyramid &p) {
+
+	std::size_t n = 0;
+	for (int l = 0; l < p.level_count; ++l) {
+		n += p.bin_count[l]*(sizeof(lod_bin) + sizeof(lod_bands) + sizeof(lod_stats));
+	}
+	return n;
+
+}
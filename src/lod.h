@@ -0,0 +1,90 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <cstddef>
+
+#include "arena.h"
+
+// Min/max/RMS pyramid over the resident samples, for drawing the waveform
+// when there are many samples per pixel. Level 0 has one bin per
+// LOD_BASE_BIN samples, every level above merges pairs of bins of the one
+// below, up to a single bin for the whole file. Values are in int16 units
+// whatever the resident sample format is.
+//
+// Next to every bin there's its energy in three bands, for tinting the
+// waveform: the samples go through a state variable filter (a biquad with
+// low, band and high pass outputs) as level 0 is made, SSE2 with eight
+// stretches of the range side by side, each run in on the samples before
+// it. The rms of each output is kept the same way as the bin's own.
+//
+// For checking a take, every bin also keeps its mean (the DC offset) and
+// how many of its samples sit at full scale, made in the same scan as
+// min/max/rms (SSE2 for int16). Upper levels average the means and add
+// the counts, so the top bin has them for the whole file.
+
+struct lod_bin {
+	short min, max;
+	float rms;
+};
+
+struct lod_bands {
+	unsigned short low, mid, high, pad;
+};
+
+struct lod_stats {
+	float mean;
+	unsigned int clips;		// samples at 32767 or -32768
+};
+
+static const std::size_t LOD_BASE_BIN = 256;
+static const int LOD_MAX_LEVELS = 40;
+static const float LOD_LOW_HZ = 200.0f;		// the crossovers: low below, mid between, high above LOD_HIGH_HZ
+static const float LOD_HIGH_HZ = 2000.0f;
+
+static const std::size_t LOD_BAND_WARMUP = 1024;	// samples every stretch is run in on, 200 Hz is well settled by then
+
+// what begin() and add() carry from one piece to the next: the band
+// filter and the end of the last piece. One per pyramid being built, so
+// two can be built at once (the difference of a comparison on a worker
+// while a file is opened on the main thread).
+struct lod_build_state {
+	float a1, a2, a3, k;				// the band filter, see lod.cpp
+	std::size_t band_step;				// 2 if the filter only sees every other sample
+	float history[LOD_BAND_WARMUP];		// the end of the previous add(), silence before the file
+};
+
+struct lod_pyramid {
+	std::size_t num_samples;
+	std::size_t bin_size;			// samples per bin on level 0
+	int level_count;
+	std::size_t bin_count[LOD_MAX_LEVELS];
+	const lod_bin *levels[LOD_MAX_LEVELS];	// arena or a mapped cache file
+	const lod_bands *bands[LOD_MAX_LEVELS];	// the same
+	const lod_stats *stats[LOD_MAX_LEVELS];
+
+	lod_pyramid() : num_samples(0), bin_size(0), level_count(0) {}
+	std::size_t samplesPerBin(int level) const { return bin_size << level; }
+};
+
+namespace LOD {
+
+	// sample_rate places the band filters
+	void build(const short *samples, std::size_t count, Arena &arena, lod_pyramid *p, unsigned int sample_rate = 44100);
+	void build(const float *samples, std::size_t count, Arena &arena, lod_pyramid *p, unsigned int sample_rate = 44100);
+
+	// the same in pieces, for samples that aren't all in memory at once:
+	// begin(), add() every range in order (first a multiple of LOD_BASE_BIN), finish()
+	void begin(std::size_t count, Arena &arena, lod_pyramid *p, lod_build_state *state, unsigned int sample_rate = 44100);
+	void add(lod_pyramid *p, lod_build_state *state, std::size_t first, const short *samples, std::size_t n);
+	void add(lod_pyramid *p, lod_build_state *state, std::size_t first, const float *samples, std::size_t n);
+	void finish(Arena &arena, lod_pyramid *p);
+
+	// the coarsest level whose bins are no wider than samples_per_pixel, -1
+	// if even level 0 is too coarse (draw the samples themselves)
+	int levelFor(const lod_pyramid &p, double samples_per_pixel);
+
+	std::size_t bytes(const lod_pyramid &p);
+
+};
+
+#endif
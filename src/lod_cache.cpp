@@ -0,0 +1,202 @@
+#include "lod_cache.h"
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(dir, mode) _mkdir(dir)
+#define fseek64 _fseeki64
+#define stat64 _stat64		// plain stat's st_size is 32 bits there, and fails past 2 GiB
+#elif __linux__
+#define fseek64 fseeko
+#define stat64 stat
+#endif
+
+#pragma warning(disable:4996)
+
+namespace {
+
+	static const char cache_magic[8] = { 'W', 'P', 'L', 'O', 'D', 0, 0, 0 };
+	static const unsigned int cache_version = 3;	// 2: band energies after the bins, 3: dc/clip stats after those
+
+	static const std::size_t key_blocks = 64;
+	static const std::size_t key_block_size = 4096;
+
+	std::string directory("lod_cache");
+
+	struct cache_header {
+		char magic[8];
+		unsigned int version;
+		unsigned int level_count;
+		hash64_t key;
+		unsigned long long num_samples;
+		unsigned int bin_size;
+		unsigned int sample_rate;
+		unsigned short channels;
+		unsigned short bit_depth;
+		unsigned int bin_struct_size;	// catches a changed lod_bin layout
+		unsigned int bands_struct_size;	// and lod_bands
+		unsigned int stats_struct_size;	// and lod_stats
+		unsigned long long bin_count[LOD_MAX_LEVELS];
+	};
+
+	std::string cachePath(hash64_t key) {
+		char name[32];
+		sprintf(name, "%016llx.lod", key);
+		return directory + "/" + name;
+	}
+
+}
+
+void LODCache::setDirectory(const std::string &dir) {
+	directory = dir;
+}
+
+bool LODCache::fileKey(const std::string &filename, hash64_t *key) {
+
+	PROFILE_ZONE("lod cache key");
+
+	struct stat64 st;
+	if (stat64(filename.c_str(), &st) != 0) {
+		return false;
+	}
+
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (!fp) {
+		return false;
+	}
+
+	const unsigned long long size = (unsigned long long)st.st_size;
+	const unsigned long long mtime = (unsigned long long)st.st_mtime;
+
+	hash64_t h = hash64(&size, sizeof(size));
+	h = hash64(&mtime, sizeof(mtime), h);
+
+	// the header is always in block 0
+	std::vector<unsigned char> block(key_block_size);
+	for (std::size_t b = 0; b < key_blocks; ++b) {
+		const unsigned long long offset = size > key_block_size ? (size - key_block_size)*b/(key_blocks - 1) : 0;
+		fseek64(fp, offset, SEEK_SET);
+		const std::size_t n = fread(&block[0], 1, key_block_size, fp);
+		h = hash64(&block[0], n, h);
+		if (size <= key_block_size) break;
+	}
+
+	fclose(fp);
+
+	*key = h;
+	return true;
+
+}
+
+bool LODCache::load(hash64_t key, MappedFile &mapping, lod_pyramid *p) {
+
+	PROFILE_ZONE("lod cache load");
+
+	if (!mapping.open(cachePath(key))) {
+		return false;
+	}
+
+	const cache_header *h = (const cache_header*)mapping.data();
+
+	bool ok = mapping.size() >= sizeof(cache_header)
+		&& !memcmp(h->magic, cache_magic, sizeof(cache_magic))
+		&& h->version == cache_version
+		&& h->key == key
+		&& h->bin_struct_size == sizeof(lod_bin)
+		&& h->bands_struct_size == sizeof(lod_bands)
+		&& h->stats_struct_size == sizeof(lod_stats)
+		&& h->level_count <= (unsigned)LOD_MAX_LEVELS;
+
+	std::size_t offset = sizeof(cache_header);
+	for (unsigned int l = 0; ok && l < h->level_count; ++l) {
+		p->levels[l] = (const lod_bin*)(mapping.data() + offset);
+		p->bin_count[l] = (std::size_t)h->bin_count[l];
+		offset += p->bin_count[l]*sizeof(lod_bin);
+		ok = offset <= mapping.size();
+	}
+	for (unsigned int l = 0; ok && l < h->level_count; ++l) {
+		p->bands[l] = (const lod_bands*)(mapping.data() + offset);
+		offset += p->bin_count[l]*sizeof(lod_bands);
+		ok = offset <= mapping.size();
+	}
+	for (unsigned int l = 0; ok && l < h->level_count; ++l) {
+		p->stats[l] = (const lod_stats*)(mapping.data() + offset);
+		offset += p->bin_count[l]*sizeof(lod_stats);
+		ok = offset <= mapping.size();
+	}
+
+	if (!ok) {
+		printf("LODCache: ignoring stale or damaged %s.\n", cachePath(key).c_str());
+		mapping.close();
+		return false;
+	}
+
+	p->num_samples = (std::size_t)h->num_samples;
+	p->bin_size = h->bin_size;
+	p->level_count = h->level_count;
+
+	return true;
+
+}
+
+bool LODCache::store(hash64_t key, const lod_pyramid &p, const WAVHEADERINFO &info) {
+
+	PROFILE_ZONE("lod cache store");
+
+	mkdir(directory.c_str(), 0755);	// fine if it's there already
+
+	// written under a temporary name and renamed, so a crash never leaves a half file behind
+	const std::string path = cachePath(key);
+	const std::string tmp_path = path + ".tmp";
+
+	FILE *fp = fopen(tmp_path.c_str(), "wb");
+	if (!fp) {
+		printf("LODCache: couldn't open %s for writing.\n", tmp_path.c_str());
+		return false;
+	}
+
+	cache_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, cache_magic, sizeof(cache_magic));
+	h.version = cache_version;
+	h.level_count = p.level_count;
+	h.key = key;
+	h.num_samples = p.num_samples;
+	h.bin_size = (unsigned int)p.bin_size;
+	h.sample_rate = info.sampleRate;
+	h.channels = info.numChannels;
+	h.bit_depth = info.bitDepth;
+	h.bin_struct_size = sizeof(lod_bin);
+	h.bands_struct_size = sizeof(lod_bands);
+	h.stats_struct_size = sizeof(lod_stats);
+	for (int l = 0; l < p.level_count; ++l) {
+		h.bin_count[l] = p.bin_count[l];
+	}
+
+	bool ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+	for (int l = 0; ok && l < p.level_count; ++l) {
+		ok = fwrite(p.levels[l], sizeof(lod_bin), p.bin_count[l], fp) == p.bin_count[l];
+	}
+	for (int l = 0; ok && l < p.level_count; ++l) {
+		ok = fwrite(p.bands[l], sizeof(lod_bands), p.bin_count[l], fp) == p.bin_count[l];
+	}
+	for (int l = 0; ok && l < p.level_count; ++l) {
+		ok = fwrite(p.stats[l], sizeof(lod_stats), p.bin_count[l], fp) == p.bin_count[l];
+	}
+	ok = (fclose(fp) == 0) && ok;
+
+	remove(path.c_str());	// rename doesn't overwrite on windows
+	if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+		printf("LODCache: couldn't write %s.\n", path.c_str());
+		remove(tmp_path.c_str());
+		return false;
+	}
+
+	return true;
+
+}
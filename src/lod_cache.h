@@ -0,0 +1,28 @@
+#ifndef LOD_CACHE_H
+#define LOD_CACHE_H
+
+#include <string>
+
+#include "definitions.h"
+#include "hash.h"
+#include "lod.h"
+#include "mapped_file.h"
+
+// On-disk cache of LOD pyramids, one file per source in lod_cache/, named
+// after a key hashed from the WAV header, 64 blocks spread over the file,
+// its size and its mtime (so no full read is needed to look a file up).
+// A hit maps the cache file and points the pyramid straight into it.
+
+namespace LODCache {
+
+	bool fileKey(const std::string &filename, hash64_t *key);
+
+	// the mapping has to stay open for as long as the pyramid is in use
+	bool load(hash64_t key, MappedFile &mapping, lod_pyramid *p);
+	bool store(hash64_t key, const lod_pyramid &p, const WAVHEADERINFO &info);
+
+	void setDirectory(const std::string &dir);
+
+};
+
+#endif
@@ -0,0 +1,511 @@
+#include "loudness.h"
+#include "job_pool.h"
+#include "profiler.h"
+#include "timer.h"
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LOUDNESS_SSE2
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+
+	const int TAPS = 12;			// per phase of the true peak interpolator, 48 in all
+	const int HISTORY = TAPS - 1;	// frames kept in front of every chunk for it
+	const int LANES = 4;
+	const std::size_t READ_FRAMES = 4096;
+	const std::size_t PEAK_PIECE = 256;
+
+	struct biquad {
+		double b0, b1, b2, a1, a2;
+	};
+
+	struct segment {
+		std::size_t first_block, block_count;
+		float true_peak;
+		timer_tick_t done;
+	};
+
+	const WavSource *source = NULL;
+	bool stereo = false;
+	std::size_t block_frames = 4410;
+	biquad shelf, highpass;
+	float interpolator[4][TAPS];	// [phase][tap], the newest frame first
+	float interpolator_gain;		// the largest sum of a phase's |taps|, what a full scale frame can grow to
+#ifdef LOUDNESS_SSE2
+	__m128 interpolator_sse[4][TAPS];	// the same, each tap in all four lanes
+#endif
+
+	std::vector<double> energy;		// mean square of every 100 ms block
+	std::vector<double> prefix;		// sums of energy, for the windows
+	std::vector<segment> segments;
+	std::atomic<int> remaining(0);
+	timer_tick_t started = 0;
+
+	bool measured = false;
+	loudness_result last;
+
+	// the two stages of BS.1770's K-weighting, worked out for the rate (rather than the 48 kHz table)
+	void makeKWeighting(double rate) {
+
+		// the head shelf
+		double f0 = 1681.974450955533, q = 0.7071752369554196;
+		double k = tan(M_PI*f0/rate);
+		const double vh = pow(10.0, 3.999843853973347/20.0), vb = pow(vh, 0.4996667741545416);
+		double a0 = 1.0 + k/q + k*k;
+		shelf.b0 = (vh + vb*k/q + k*k)/a0;
+		shelf.b1 = 2.0*(k*k - vh)/a0;
+		shelf.b2 = (vh - vb*k/q + k*k)/a0;
+		shelf.a1 = 2.0*(k*k - 1.0)/a0;
+		shelf.a2 = (1.0 - k/q + k*k)/a0;
+
+		// the RLB high pass
+		f0 = 38.13547087602444;
+		q = 0.5003270373238773;
+		k = tan(M_PI*f0/rate);
+		a0 = 1.0 + k/q + k*k;
+		highpass.b0 = 1.0;
+		highpass.b1 = -2.0;
+		highpass.b2 = 1.0;
+		highpass.a1 = 2.0*(k*k - 1.0)/a0;
+		highpass.a2 = (1.0 - k/q + k*k)/a0;
+
+	}
+
+	// a Blackman windowed sinc centered on tap 24, so phase 0 is the frames themselves
+	void makeInterpolator() {
+
+		for (int p = 0; p < 4; ++p) {
+			double sum = 0.0;
+			for (int t = 0; t < TAPS; ++t) {
+				const int n = p + 4*t;
+				const double x = (n - 24)/4.0;
+				const double sinc = x == 0.0 ? 1.0 : sin(M_PI*x)/(M_PI*x);
+				const double w = 0.42 - 0.5*cos(2.0*M_PI*n/48.0) + 0.08*cos(4.0*M_PI*n/48.0);
+				interpolator[p][t] = (float)(sinc*w);
+				sum += sinc*w;
+			}
+			// every phase passes DC at 1
+			for (int t = 0; t < TAPS; ++t) interpolator[p][t] = (float)(interpolator[p][t]/sum);
+		}
+
+		interpolator_gain = 0.0f;
+		for (int p = 0; p < 4; ++p) {
+			float g = 0.0f;
+			for (int t = 0; t < TAPS; ++t) g += fabsf(interpolator[p][t]);
+			interpolator_gain = std::max(interpolator_gain, g*1.0001f);	// and a bit for the float sums
+		}
+
+#ifdef LOUDNESS_SSE2
+		for (int p = 0; p < 4; ++p) {
+			for (int t = 0; t < TAPS; ++t) interpolator_sse[p][t] = _mm_set1_ps(interpolator[p][t]);
+		}
+#endif
+
+	}
+
+	float toLUFS(double mean_square) {
+		const double l = -0.691 + 10.0*log10(mean_square + 1e-30);
+		return l > LOUDNESS_FLOOR ? (float)l : LOUDNESS_FLOOR;
+	}
+
+	// one frame of every lane
+	typedef float lane_buffer[LANES][HISTORY + READ_FRAMES];
+
+	// direct form II transposed, lanes 0-1 and 2-3 in a register each
+	struct filter_state {
+#ifdef LOUDNESS_SSE2
+		__m128d s1[2], s2[2], t1[2], t2[2];		// the shelf's and the high pass's
+#else
+		double s1[LANES], s2[LANES], t1[LANES], t2[LANES];
+#endif
+	};
+
+#ifdef LOUDNESS_SSE2
+	struct k_coefficients {
+		__m128d sb0, sb1, sb2, sa1, sa2, ha1, ha2, two;
+	};
+
+	inline __m128d kStep(const k_coefficients &k, __m128d &s1, __m128d &s2, __m128d &t1, __m128d &t2, __m128d x) {
+
+		const __m128d y = _mm_add_pd(_mm_mul_pd(k.sb0, x), s1);
+		s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(k.sb1, x), _mm_mul_pd(k.sa1, y)), s2);
+		s2 = _mm_sub_pd(_mm_mul_pd(k.sb2, x), _mm_mul_pd(k.sa2, y));
+
+		// b = 1, -2, 1
+		const __m128d z = _mm_add_pd(y, t1);
+		t1 = _mm_sub_pd(_mm_sub_pd(t2, _mm_mul_pd(k.two, y)), _mm_mul_pd(k.ha1, z));
+		t2 = _mm_sub_pd(y, _mm_mul_pd(k.ha2, z));
+		return z;
+
+	}
+
+	// both halves of a frame, the squares of the output added to acc
+	inline void kFrame(const k_coefficients &k, filter_state &st, __m128 v, __m128d *acc) {
+		const __m128d z0 = kStep(k, st.s1[0], st.s2[0], st.t1[0], st.t2[0], _mm_cvtps_pd(v));
+		const __m128d z1 = kStep(k, st.s1[1], st.s2[1], st.t1[1], st.t2[1], _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+		acc[0] = _mm_add_pd(acc[0], _mm_mul_pd(z0, z0));
+		acc[1] = _mm_add_pd(acc[1], _mm_mul_pd(z1, z1));
+	}
+#endif
+
+	// frames [i, i + n) of every lane through the K-weighting, the squares of the output added to sum[LANES].
+	// the two halves' chains are independent, so one's multiplies fill the other's latency.
+	void kWeight(filter_state &st, const lane_buffer &x, std::size_t i, std::size_t n, double *sum) {
+
+		const std::size_t end = i + n;
+
+#ifdef LOUDNESS_SSE2
+		k_coefficients k;
+		k.sb0 = _mm_set1_pd(shelf.b0);
+		k.sb1 = _mm_set1_pd(shelf.b1);
+		k.sb2 = _mm_set1_pd(shelf.b2);
+		k.sa1 = _mm_set1_pd(shelf.a1);
+		k.sa2 = _mm_set1_pd(shelf.a2);
+		k.ha1 = _mm_set1_pd(highpass.a1);
+		k.ha2 = _mm_set1_pd(highpass.a2);
+		k.two = _mm_set1_pd(2.0);
+		__m128d acc[2] = { _mm_setzero_pd(), _mm_setzero_pd() };
+
+		// four frames of the four lanes, turned into four frames of lanes
+		for (; i + 4 <= end; i += 4) {
+			__m128 f0 = _mm_loadu_ps(&x[0][HISTORY + i]), f1 = _mm_loadu_ps(&x[1][HISTORY + i]);
+			__m128 f2 = _mm_loadu_ps(&x[2][HISTORY + i]), f3 = _mm_loadu_ps(&x[3][HISTORY + i]);
+			_MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+			kFrame(k, st, f0, acc);
+			kFrame(k, st, f1, acc);
+			kFrame(k, st, f2, acc);
+			kFrame(k, st, f3, acc);
+		}
+		for (; i < end; ++i) {
+			kFrame(k, st, _mm_setr_ps(x[0][HISTORY + i], x[1][HISTORY + i], x[2][HISTORY + i], x[3][HISTORY + i]), acc);
+		}
+
+		double a[LANES];
+		_mm_storeu_pd(a, acc[0]);
+		_mm_storeu_pd(a + 2, acc[1]);
+		for (int l = 0; l < LANES; ++l) sum[l] += a[l];
+#else
+		for (int l = 0; l < LANES; ++l) {
+			double s1 = st.s1[l], s2 = st.s2[l], t1 = st.t1[l], t2 = st.t2[l], acc = 0.0;
+			for (std::size_t j = i; j < end; ++j) {
+				const double v = x[l][HISTORY + j];
+				const double y = shelf.b0*v + s1;
+				s1 = shelf.b1*v - shelf.a1*y + s2;
+				s2 = shelf.b2*v - shelf.a2*y;
+				const double z = y + t1;
+				t1 = -2.0*y - highpass.a1*z + t2;
+				t2 = y - highpass.a2*z;
+				acc += z*z;
+			}
+			st.s1[l] = s1; st.s2[l] = s2; st.t1[l] = t1; st.t2[l] = t2;
+			sum[l] += acc;
+		}
+#endif
+
+	}
+
+	float loudest(const float *x, std::size_t n) {
+
+		std::size_t i = 0;
+		float top = 0.0f;
+
+#ifdef LOUDNESS_SSE2
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		__m128 v = _mm_setzero_ps();
+		for (; i + 4 <= n; i += 4) v = _mm_max_ps(v, _mm_andnot_ps(sign, _mm_loadu_ps(x + i)));
+		float t[4];
+		_mm_storeu_ps(t, v);
+		top = std::max(std::max(t[0], t[1]), std::max(t[2], t[3]));
+#endif
+
+		for (; i < n; ++i) top = std::max(top, fabsf(x[i]));
+		return top;
+
+	}
+
+	// the largest magnitude of the 4x oversampled frames [0, n) of x, x[-HISTORY, 0) being the ones before.
+	// phase 0 is the frames themselves, so only phases 1-3 are worked out, and not even those for a
+	// piece whose frames are all under peak/interpolator_gain. (the frames before a piece are file
+	// frames or zeros too, so they count for phase 0 as well.)
+	float truePeak(const float *x, std::size_t n, float peak) {
+
+		for (std::size_t piece = 0; piece < n; piece += PEAK_PIECE) {
+
+			const std::size_t end = std::min(n, piece + PEAK_PIECE);
+			std::size_t i = piece;
+
+			const float frames = loudest(x + i - HISTORY, end - i + HISTORY);
+			peak = std::max(peak, frames);
+			if (frames*interpolator_gain <= peak) continue;
+
+#ifdef LOUDNESS_SSE2
+			// four frames at a time, each phase a dot product of unaligned loads
+			const __m128 sign = _mm_set1_ps(-0.0f);
+			__m128 top = _mm_set1_ps(peak);
+
+			for (; i + 4 <= end; i += 4) {
+				__m128 v[TAPS];
+				for (int t = 0; t < TAPS; ++t) v[t] = _mm_loadu_ps(x + i - t);
+
+				for (int p = 1; p < 4; ++p) {
+					__m128 acc = _mm_mul_ps(interpolator_sse[p][0], v[0]);
+					for (int t = 1; t < TAPS; ++t) {
+						acc = _mm_add_ps(acc, _mm_mul_ps(interpolator_sse[p][t], v[t]));
+					}
+					top = _mm_max_ps(top, _mm_andnot_ps(sign, acc));
+				}
+			}
+
+			float t[4];
+			_mm_storeu_ps(t, top);
+			peak = std::max(std::max(t[0], t[1]), std::max(t[2], t[3]));
+#endif
+
+			for (; i < end; ++i) {
+				for (int p = 1; p < 4; ++p) {
+					float acc = 0.0f;
+					for (int t = 0; t < TAPS; ++t) acc += interpolator[p][t]*x[i - t];
+					peak = std::max(peak, fabsf(acc));
+				}
+			}
+		}
+
+		return peak;
+
+	}
+
+	// on a worker: one segment, cut into stretches that go through the filters side by side
+	// (two stereo ones, a lane per channel, or four mono ones), each from LOUDNESS_WARMUP
+	// frames before it. the frames before the file or past a stretch's last block are zeros.
+	void measureSegment(void *user) {
+
+		PROFILE_ZONE("loudness");
+
+		segment &s = *static_cast<segment*>(user);
+		const std::size_t stretches = stereo ? LANES/2 : LANES;
+		const std::size_t per = (s.block_count + stretches - 1)/stretches;	// blocks
+		const std::size_t length = LOUDNESS_WARMUP + per*block_frames;
+
+		std::size_t first_block[LANES], blocks[LANES];
+		for (std::size_t k = 0; k < stretches; ++k) {
+			first_block[k] = s.first_block + k*per;
+			blocks[k] = s.block_count > k*per ? std::min(per, s.block_count - k*per) : 0;
+		}
+
+		short pairs[2*READ_FRAMES];
+		static thread_local lane_buffer x;
+		for (int l = 0; l < LANES; ++l) std::fill(x[l], x[l] + HISTORY, 0.0f);
+
+		filter_state st;
+		memset(&st, 0, sizeof(st));
+		double sum[LANES] = { 0.0 }, discard[LANES] = { 0.0 };
+		std::size_t block = 0, in_block = 0;
+		float peak = 0.0f;
+
+		for (std::size_t j = 0; j < length; ) {
+
+			const std::size_t n = std::min(READ_FRAMES, length - j);
+
+			for (std::size_t k = 0; k < stretches; ++k) {
+				float *l = x[stereo ? 2*k : k] + HISTORY, *r = x[stereo ? 2*k + 1 : k] + HISTORY;
+				std::fill(l, l + n, 0.0f);
+				if (stereo) std::fill(r, r + n, 0.0f);
+
+				// frames [at, at + n) of the file, those of them in [0, stretch_end) are read
+				const long long at = (long long)(first_block[k]*block_frames) - (long long)LOUDNESS_WARMUP + (long long)j;
+				const long long stretch_end = (long long)((first_block[k] + blocks[k])*block_frames);
+				const long long a = std::max(at, 0LL), b = std::min(at + (long long)n, stretch_end);
+				if (a >= b) continue;
+
+				const std::size_t got = source->readPairs((std::size_t)a, (std::size_t)(b - a), pairs);
+				for (std::size_t i = 0; i < got; ++i) {
+					l[a - at + i] = pairs[2*i]*(1.0f/32768.0f);
+					if (stereo) r[a - at + i] = pairs[2*i + 1]*(1.0f/32768.0f);
+				}
+			}
+
+			// the warm-up only sets up the filter state
+			std::size_t i = 0;
+			if (j < LOUDNESS_WARMUP) {
+				i = std::min(n, LOUDNESS_WARMUP - j);
+				kWeight(st, x, 0, i, discard);
+			}
+
+			for (int l = 0; l < LANES; ++l) {
+				peak = truePeak(x[l] + HISTORY + i, n - i, peak);
+			}
+
+			while (i < n) {
+				const std::size_t m = std::min(n - i, block_frames - in_block);
+				kWeight(st, x, i, m, sum);
+				i += m;
+				in_block += m;
+				if (in_block < block_frames) continue;
+
+				for (std::size_t k = 0; k < stretches; ++k) {
+					if (block < blocks[k]) {
+						energy[first_block[k] + block] = (stereo ? sum[2*k] + sum[2*k + 1] : sum[k])/block_frames;
+					}
+				}
+				std::fill(sum, sum + LANES, 0.0);
+				in_block = 0;
+				++block;
+			}
+
+			for (int l = 0; l < LANES; ++l) {
+				std::copy(x[l] + n, x[l] + n + HISTORY, x[l]);
+			}
+			j += n;
+		}
+
+		s.true_peak = peak;
+		s.done = Timer::get();
+		remaining.fetch_sub(1, std::memory_order_release);
+
+	}
+
+	// mean square of blocks [a, b)
+	double windowEnergy(std::size_t a, std::size_t b) {
+		return (prefix[b] - prefix[a])/(b - a);
+	}
+
+	// BS.1770-4: 400 ms blocks every 100 ms, gated at -70 LUFS and then 10 LU under the mean of what's left
+	void gate() {
+
+		const std::size_t n = energy.size();
+
+		prefix.assign(n + 1, 0.0);
+		for (std::size_t b = 0; b < n; ++b) prefix[b + 1] = prefix[b] + energy[b];
+
+		last.integrated = last.max_momentary = last.max_short_term = LOUDNESS_FLOOR;
+		last.blocks = n;
+
+		double gated = 0.0;
+		std::size_t count = 0;
+		for (std::size_t b = 4; b <= n; ++b) {
+			const double z = windowEnergy(b - 4, b);
+			last.max_momentary = std::max(last.max_momentary, toLUFS(z));
+			if (toLUFS(z) > LOUDNESS_FLOOR) {
+				gated += z;
+				++count;
+			}
+		}
+		for (std::size_t b = 30; b <= n; ++b) {
+			last.max_short_term = std::max(last.max_short_term, toLUFS(windowEnergy(b - 30, b)));
+		}
+
+		if (count) {
+			const double relative = -0.691 + 10.0*log10(gated/count) - 10.0;
+			double sum = 0.0;
+			count = 0;
+			for (std::size_t b = 4; b <= n; ++b) {
+				const double z = windowEnergy(b - 4, b);
+				const float lufs = toLUFS(z);
+				if (lufs > LOUDNESS_FLOOR && lufs > relative) {
+					sum += z;
+					++count;
+				}
+			}
+			if (count) last.integrated = toLUFS(sum/count);
+		}
+
+		float peak = 0.0f;
+		timer_tick_t done = started;
+		for (std::size_t i = 0; i < segments.size(); ++i) {
+			peak = std::max(peak, segments[i].true_peak);
+			done = std::max(done, segments[i].done);
+		}
+		last.true_peak = peak > 0.0f ? 20.0f*log10f(peak) : -96.0f;
+		last.milliseconds = Timer::ticksToMicroSeconds(done - started)/1000.0;
+
+	}
+
+	float window(double sample, std::size_t blocks) {
+
+		if (!measured || sample < 0) return LOUDNESS_FLOOR;
+		const std::size_t b = std::min((std::size_t)(sample/block_frames), energy.size());
+		return b >= blocks ? toLUFS(windowEnergy(b - blocks, b)) : LOUDNESS_FLOOR;
+
+	}
+
+}
+
+void Loudness::setSource(const WavSource *source_) {
+
+	// nothing of the old file may still be in the works; the other owners' jobs can carry on
+	JobPool::wait(remaining);
+
+	source = NULL;
+	measured = false;
+	energy.clear();
+	prefix.clear();
+	segments.clear();
+	remaining = 0;
+
+	if (!source_ || !source_->sampleCount()) return;
+
+	source = source_;
+	stereo = source->header().numChannels > 1;
+	const double rate = source->header().sampleRate > 0 ? source->header().sampleRate : 44100;
+	block_frames = (std::size_t)(rate/10.0 + 0.5);
+	makeKWeighting(rate);
+	makeInterpolator();
+
+	// the frames after the last whole block aren't measured
+	energy.assign(source->sampleCount()/block_frames, 0.0);
+	for (std::size_t b = 0; b < energy.size(); b += LOUDNESS_SEGMENT_BLOCKS) {
+		const segment s = { b, std::min(LOUDNESS_SEGMENT_BLOCKS, energy.size() - b), 0.0f, 0 };
+		segments.push_back(s);
+	}
+
+	// all of them before the first submit, the vector doesn't move after that
+	started = Timer::get();
+	remaining = (int)segments.size();
+	for (std::size_t i = 0; i < segments.size(); ++i) {
+		JobPool::submit(measureSegment, &segments[i]);
+	}
+
+}
+
+bool Loudness::ready() {
+
+	if (measured) return true;
+	if (!source || remaining.load(std::memory_order_acquire) > 0) return false;
+
+	gate();
+	measured = true;
+	return true;
+
+}
+
+void Loudness::wait() {
+
+	if (!source) return;
+	JobPool::wait(remaining);
+	ready();
+
+}
+
+const loudness_result &Loudness::result() {
+	return last;
+}
+
+float Loudness::momentary(double sample) {
+	return window(sample, 4);
+}
+
+float Loudness::shortTerm(double sample) {
+	return window(sample, 30);
+}
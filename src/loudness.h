@@ -0,0 +1,56 @@
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <cstddef>
+
+#include "wav_source.h"
+
+// EBU R128 / ITU-R BS.1770 loudness of the whole file, measured on the
+// job pool as soon as it's opened. The file is cut into segments of
+// LOUDNESS_SEGMENT_BLOCKS 100 ms blocks, one job each. A job runs the
+// K-weighting on four lanes of SSE2 doubles at once (two stretches of its
+// segment for stereo, four for mono, each run in from LOUDNESS_WARMUP
+// frames before it), writes the mean square of every block into its own
+// part of one array, and takes the true peak (4x oversampled, a 48 tap
+// windowed sinc, four frames at a time) on the way. The gating and the
+// momentary (400 ms) and short-term (3 s) windows are then worked out from
+// that array in order on the main thread, so the numbers don't depend on
+// the thread count or which job finished first.
+//
+// The pairs are read through the WavSource like everything else; mono is
+// counted as one channel.
+
+static const std::size_t LOUDNESS_SEGMENT_BLOCKS = 256;		// 25.6 s a job
+static const std::size_t LOUDNESS_WARMUP = 8192;			// frames; the 38 Hz high pass has died down by then
+static const float LOUDNESS_FLOOR = -70.0f;					// LUFS, the absolute gate; anything quieter reads as this
+
+struct loudness_result {
+	float integrated;		// LUFS
+	float max_momentary;
+	float max_short_term;
+	float true_peak;		// dBTP
+	std::size_t blocks;		// 100 ms blocks measured
+	double milliseconds;	// from setSource() to the last job done
+};
+
+namespace Loudness {
+
+	// waits for the jobs still reading the old one, then queues the new one's. NULL drops it.
+	void setSource(const WavSource *source);
+
+	// true once all of the jobs are done; the first call that sees it does the gating
+	bool ready();
+
+	// until ready(), for the headless run
+	void wait();
+
+	// of the last ready() file
+	const loudness_result &result();
+
+	// of the window ending at sample, LOUDNESS_FLOOR until ready() or before the first whole window
+	float momentary(double sample);
+	float shortTerm(double sample);
+
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : data_(NULL), size_(0) {
+#ifdef _WIN32
+	file = mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const std::string &filename) {
+
+	close();
+
+#ifdef _WIN32
+
+	HANDLE f = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(f, &length) || length.QuadPart == 0) {
+		CloseHandle(f);
+		return false;
+	}
+
+	HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m) {
+		CloseHandle(f);
+		return false;
+	}
+
+	data_ = (const unsigned char*)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if (!data_) {
+		CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+
+	file = f;
+	mapping = m;
+	size_ = (std::size_t)length.QuadPart;
+
+#elif __linux__
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);	// the mapping keeps its own reference
+	if (p == MAP_FAILED) return false;
+
+	data_ = (const unsigned char*)p;
+	size_ = (std::size_t)st.st_size;
+
+#endif
+
+	return true;
+
+}
+
+void MappedFile::close() {
+
+	if (!data_) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data_);
+	CloseHandle(mapping);
+	CloseHandle(file);
+	file = mapping = NULL;
+#elif __linux__
+	munmap((void*)data_, size_);
+#endif
+
+	data_ = NULL;
+	size_ = 0;
+
+}
@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages come in from disk as
+// they're first touched, so mapping a big file costs next to nothing
+// until it's actually read.
+
+class MappedFile {
+
+public:
+
+	MappedFile();
+	~MappedFile();
+
+	bool open(const std::string &filename);
+	void close();
+
+	bool valid() const { return data_ != NULL; }
+	const unsigned char *data() const { return data_; }
+	std::size_t size() const { return size_; }
+
+private:
+
+	MappedFile(const MappedFile&);
+	MappedFile &operator=(const MappedFile&);
+
+	const unsigned char *data_;
+	std::size_t size_;
+
+#ifdef _WIN32
+	void *file, *mapping;
+#endif
+
+};
+
+#endif
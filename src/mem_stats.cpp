@@ -0,0 +1,154 @@
+#include "mem_stats.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+namespace {
+
+	// keeps the returned block at malloc's 16-byte alignment
+	struct block_header {
+		std::size_t bytes;
+		int subsystem;
+		int pad;
+	};
+	static const std::size_t header_size = 16;
+
+	struct counter {
+		std::atomic<long long> current;
+		std::atomic<long long> peak;
+	};
+
+	// the index bake runs on its own thread on windows, hence the atomics.
+	// the last row is the total over all subsystems, which has its own peak.
+	counter counters[MEM_SUBSYSTEM_COUNT + 1][MEM_KIND_COUNT];
+
+	const char *subsystem_names[MEM_SUBSYSTEM_COUNT] = { "io", "convert", "bake", "index", "text", "textures", "lod", "tiles", "other" };
+	const char *kind_names[MEM_KIND_COUNT] = { "host", "gl buffers", "gl textures" };
+
+	struct gl_allocation {
+		int subsystem;
+		std::size_t bytes;
+	};
+
+	// GL objects are only ever created on the GL thread
+	std::map<GLuint, gl_allocation> buffers, textures;
+
+	void add(counter &c, long long delta) {
+		const long long now = c.current.fetch_add(delta) + delta;
+		long long p = c.peak.load();
+		while (now > p && !c.peak.compare_exchange_weak(p, now)) {}
+	}
+
+	void change(int subsystem, int kind, long long delta) {
+		add(counters[subsystem][kind], delta);
+		add(counters[MEM_SUBSYSTEM_COUNT][kind], delta);
+	}
+
+	void track(std::map<GLuint, gl_allocation> &objects, int kind, GLuint id, int subsystem, std::size_t bytes) {
+		std::map<GLuint, gl_allocation>::iterator it = objects.find(id);
+		if (it != objects.end()) {
+			change(it->second.subsystem, kind, -(long long)it->second.bytes);
+		}
+		gl_allocation a = { subsystem, bytes };
+		objects[id] = a;
+		change(subsystem, kind, (long long)bytes);
+	}
+
+	void untrack(std::map<GLuint, gl_allocation> &objects, int kind, GLuint id) {
+		std::map<GLuint, gl_allocation>::iterator it = objects.find(id);
+		if (it == objects.end()) return;
+		change(it->second.subsystem, kind, -(long long)it->second.bytes);
+		objects.erase(it);
+	}
+
+	double MiB(long long bytes) {
+		return bytes/(1024.0*1024.0);
+	}
+
+}
+
+void *MemStats::allocate(int subsystem, std::size_t bytes) {
+
+	char *raw = static_cast<char*>(malloc(header_size + bytes));
+	if (!raw) {
+		throw std::bad_alloc();
+	}
+
+	block_header *h = reinterpret_cast<block_header*>(raw);
+	h->bytes = bytes;
+	h->subsystem = subsystem;
+
+	change(subsystem, MEM_HOST, (long long)bytes);
+
+	return raw + header_size;
+
+}
+
+void MemStats::release(void *p) {
+
+	if (!p) return;
+
+	char *raw = static_cast<char*>(p) - header_size;
+	const block_header *h = reinterpret_cast<const block_header*>(raw);
+	change(h->subsystem, MEM_HOST, -(long long)h->bytes);
+
+	free(raw);
+
+}
+
+void MemStats::hostAllocated(int subsystem, std::size_t bytes) {
+	change(subsystem, MEM_HOST, (long long)bytes);
+}
+
+void MemStats::hostReleased(int subsystem, std::size_t bytes) {
+	change(subsystem, MEM_HOST, -(long long)bytes);
+}
+
+void MemStats::trackBuffer(GLuint id, int subsystem, std::size_t bytes) {
+	track(buffers, MEM_GL_BUFFER, id, subsystem, bytes);
+}
+
+void MemStats::untrackBuffer(GLuint id) {
+	untrack(buffers, MEM_GL_BUFFER, id);
+}
+
+void MemStats::trackTexture(GLuint id, int subsystem, std::size_t bytes) {
+	track(textures, MEM_GL_TEXTURE, id, subsystem, bytes);
+}
+
+void MemStats::untrackTexture(GLuint id) {
+	untrack(textures, MEM_GL_TEXTURE, id);
+}
+
+std::size_t MemStats::current(int subsystem, int kind) {
+	return (std::size_t)counters[subsystem][kind].current.load();
+}
+
+std::size_t MemStats::peak(int subsystem, int kind) {
+	return (std::size_t)counters[subsystem][kind].peak.load();
+}
+
+const char *MemStats::subsystemName(int subsystem) {
+	return subsystem < MEM_SUBSYSTEM_COUNT ? subsystem_names[subsystem] : "total";
+}
+
+void MemStats::printReport() {
+
+	printf("Memory (MiB, current / peak):\n");
+	printf("  %-10s", "");
+	for (int k = 0; k < MEM_KIND_COUNT; ++k) {
+		printf("  %21s", kind_names[k]);
+	}
+	printf("\n");
+
+	for (int s = 0; s <= MEM_SUBSYSTEM_COUNT; ++s) {
+		printf("  %-10s", subsystemName(s));
+		for (int k = 0; k < MEM_KIND_COUNT; ++k) {
+			printf("  %10.2f / %8.2f", MiB(counters[s][k].current.load()), MiB(counters[s][k].peak.load()));
+		}
+		printf("\n");
+	}
+
+}
@@ -0,0 +1,54 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <cstddef>
+#include <new>
+
+#include "gl_includes.h"
+
+// Memory accounting by subsystem. Host arrays are allocated through
+// MemStats::allocArray / released with MemStats::release (the size and tag
+// live in a small header in front of the block); GL buffer and texture
+// storage is registered by id right after glBufferData / glTexImage2D.
+// Current and peak bytes are kept per subsystem and per kind, and
+// printReport() dumps the lot (at exit, and on 'm' in the windowed build).
+
+enum { MEM_IO, MEM_CONVERT, MEM_BAKE, MEM_INDEX, MEM_TEXT, MEM_TEXTURES, MEM_LOD, MEM_TILES, MEM_OTHER, MEM_SUBSYSTEM_COUNT };
+enum { MEM_HOST, MEM_GL_BUFFER, MEM_GL_TEXTURE, MEM_KIND_COUNT };
+
+namespace MemStats {
+
+	void *allocate(int subsystem, std::size_t bytes);
+	void release(void *p);
+
+	// only meant for the plain vertex/sample structs: constructors run, destructors don't
+	template <typename T>
+	T *allocArray(int subsystem, std::size_t count) {
+		T *p = static_cast<T*>(allocate(subsystem, count*sizeof(T)));
+		for (std::size_t i = 0; i < count; ++i) {
+			new (p + i) T;
+		}
+		return p;
+	}
+
+	// for allocators that manage their own memory (see arena.h)
+	void hostAllocated(int subsystem, std::size_t bytes);
+	void hostReleased(int subsystem, std::size_t bytes);
+
+	// (re)registers the storage of a buffer object, replacing any earlier size for the same id
+	void trackBuffer(GLuint id, int subsystem, std::size_t bytes);
+	void untrackBuffer(GLuint id);
+
+	void trackTexture(GLuint id, int subsystem, std::size_t bytes);
+	void untrackTexture(GLuint id);
+
+	std::size_t current(int subsystem, int kind);
+	std::size_t peak(int subsystem, int kind);
+
+	const char *subsystemName(int subsystem);
+
+	void printReport();
+
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "onsets.h"
+#include "fft.h"
+#include "job_pool.h"
+#include "profiler.h"
+#include "timer.h"
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+	const float BAND_GAIN = 1e4f;			// log(1 + BAND_GAIN*power): a full scale sine ~9, -80 dB ~0
+	const double MIN_HZ = 30.0;
+	const std::size_t PEAK_HOPS = 3;		// an onset is the largest flux this many hops either side
+	const std::size_t MEAN_HOPS = 16;		// and over ONSET_RATIO times the mean of this many either side
+	const std::size_t MIN_GAP_HOPS = 4;		// ~46 ms
+	const float ONSET_RATIO = 1.5f;
+	const float QUIET = 0.5f;				// times the file's mean flux, under which nothing counts
+
+	struct segment {
+		std::size_t first_hop, hop_count;
+		timer_tick_t done;
+	};
+
+	const WavSource *source = NULL;
+	fft_plan plan;
+	bool planned = false;
+	unsigned int band_bins[ONSET_BANDS + 1];	// the first bin of every band, and one past the last
+
+	std::vector<float> flux;	// a value per hop, hop h being the frame centered on sample h*ONSET_HOP
+	std::vector<segment> segments;
+	std::atomic<int> remaining(0);
+	timer_tick_t started = 0;
+
+	bool picked = false;
+	std::vector<onset> events;
+	double milliseconds = 0.0;
+
+	// the same log spacing as the spectrogram's rows, every band at least a bin wide
+	void makeBandBins(double rate) {
+
+		const double lo = MIN_HZ, hi = 0.5*rate;
+		for (std::size_t b = 0; b < ONSET_BANDS; ++b) {
+			const double f = lo*pow(hi/lo, (double)b/ONSET_BANDS);
+			band_bins[b] = (unsigned int)(f*ONSET_FFT/rate);
+		}
+		band_bins[ONSET_BANDS] = (unsigned int)(ONSET_FFT/2 + 1);
+		for (std::size_t b = 1; b <= ONSET_BANDS; ++b) {
+			band_bins[b] = std::max(band_bins[b], band_bins[b - 1] + 1);
+		}
+
+	}
+
+	// samples [first, first + n) into out, zeros where that's outside the file
+	void readSamples(long long first, std::size_t n, float *out) {
+
+		std::fill(out, out + n, 0.0f);
+		const std::size_t skip = first < 0 ? (std::size_t)std::min((long long)n, -first) : 0;
+		if (skip < n) source->read((std::size_t)(first + (long long)skip), n - skip, out + skip);
+
+	}
+
+	void bandLevels(const float *power, float *bands) {
+
+		for (std::size_t b = 0; b < ONSET_BANDS; ++b) {
+			float sum = 0.0f;
+			for (unsigned int k = band_bins[b]; k < band_bins[b + 1]; ++k) sum += power[k];
+			bands[b] = logf(1.0f + BAND_GAIN*sum);
+		}
+
+	}
+
+	// on a worker: the flux of a segment's hops, from a frame that slides along the file a hop at a time
+	void detectSegment(void *user) {
+
+		PROFILE_ZONE("onsets");
+
+		segment &s = *static_cast<segment*>(user);
+
+		thread_local std::vector<float> frame, power, scratch;
+		frame.resize(ONSET_FFT);
+		power.resize(ONSET_FFT/2 + 1);
+		scratch.resize(FFT::scratchSize(ONSET_FFT));
+
+		float bands[2][ONSET_BANDS];
+		int current = 0;
+
+		// the hop before the segment's first, for the first difference
+		long long start = ((long long)s.first_hop - 1)*(long long)ONSET_HOP - (long long)(ONSET_FFT/2);
+		readSamples(start, ONSET_FFT, &frame[0]);
+		FFT::power(plan, &frame[0], &power[0], &scratch[0]);
+		bandLevels(&power[0], bands[current]);
+
+		for (std::size_t h = s.first_hop; h < s.first_hop + s.hop_count; ++h) {
+
+			std::copy(frame.begin() + ONSET_HOP, frame.end(), frame.begin());
+			start += ONSET_HOP;
+			readSamples(start + (long long)(ONSET_FFT - ONSET_HOP), ONSET_HOP, &frame[ONSET_FFT - ONSET_HOP]);
+
+			FFT::power(plan, &frame[0], &power[0], &scratch[0]);
+			current ^= 1;
+			bandLevels(&power[0], bands[current]);
+
+			float rise = 0.0f;
+			for (std::size_t b = 0; b < ONSET_BANDS; ++b) {
+				rise += std::max(0.0f, bands[current][b] - bands[current ^ 1][b]);
+			}
+			flux[h] = rise;
+		}
+
+		s.done = Timer::get();
+		remaining.fetch_sub(1, std::memory_order_release);
+
+	}
+
+	// peaks of the flux that stand out from their surroundings, in order, at least MIN_GAP_HOPS apart
+	void pick() {
+
+		const std::size_t n = flux.size();
+		events.clear();
+
+		std::vector<double> prefix(n + 1, 0.0);
+		for (std::size_t h = 0; h < n; ++h) prefix[h + 1] = prefix[h] + flux[h];
+		const float quiet = n ? QUIET*(float)(prefix[n]/n) : 0.0f;
+
+		float strongest = 0.0f;
+		for (std::size_t h = 0; h < n; ++h) {
+
+			const float f = flux[h];
+			if (f <= quiet) continue;
+
+			const std::size_t a = h > PEAK_HOPS ? h - PEAK_HOPS : 0, b = std::min(n, h + PEAK_HOPS + 1);
+			if (*std::max_element(flux.begin() + a, flux.begin() + b) > f) continue;
+
+			const std::size_t ma = h > MEAN_HOPS ? h - MEAN_HOPS : 0, mb = std::min(n, h + MEAN_HOPS + 1);
+			const float mean = (float)((prefix[mb] - prefix[ma])/(mb - ma));
+			if (f < ONSET_RATIO*mean) continue;
+
+			if (!events.empty() && h*ONSET_HOP < events.back().sample + MIN_GAP_HOPS*ONSET_HOP) continue;
+
+			const onset o = { h*ONSET_HOP, f - mean };
+			events.push_back(o);
+			strongest = std::max(strongest, o.strength);
+		}
+
+		for (std::size_t i = 0; i < events.size(); ++i) events[i].strength /= strongest;
+
+		timer_tick_t done = started;
+		for (std::size_t i = 0; i < segments.size(); ++i) done = std::max(done, segments[i].done);
+		milliseconds = Timer::ticksToMicroSeconds(done - started)/1000.0;
+
+	}
+
+}
+
+void Onsets::setSource(const WavSource *source_) {
+
+	// nothing of the old file may still be in the works; the other owners' jobs can carry on
+	JobPool::wait(remaining);
+
+	source = NULL;
+	picked = false;
+	events.clear();
+	flux.clear();
+	segments.clear();
+	remaining = 0;
+
+	if (planned) {
+		FFT::release(&plan);
+		planned = false;
+	}
+
+	if (!source_ || !source_->sampleCount()) return;
+
+	source = source_;
+	planned = FFT::plan(ONSET_FFT, &plan);
+	if (!planned) {
+		source = NULL;
+		return;
+	}
+	makeBandBins(source->header().sampleRate > 0 ? source->header().sampleRate : 44100);
+
+	flux.assign((source->sampleCount() + ONSET_HOP - 1)/ONSET_HOP, 0.0f);
+	for (std::size_t h = 0; h < flux.size(); h += ONSET_SEGMENT_HOPS) {
+		const segment s = { h, std::min(ONSET_SEGMENT_HOPS, flux.size() - h), 0 };
+		segments.push_back(s);
+	}
+
+	// all of them before the first submit, the vector doesn't move after that
+	started = Timer::get();
+	remaining = (int)segments.size();
+	for (std::size_t i = 0; i < segments.size(); ++i) {
+		JobPool::submit(detectSegment, &segments[i]);
+	}
+
+}
+
+bool Onsets::ready() {
+
+	if (picked) return true;
+	if (!source || remaining.load(std::memory_order_acquire) > 0) return false;
+
+	pick();
+	picked = true;
+	return true;
+
+}
+
+void Onsets::wait() {
+
+	if (!source) return;
+	JobPool::wait(remaining);
+	ready();
+
+}
+
+std::size_t Onsets::count() {
+	return picked ? events.size() : 0;
+}
+
+const onset &Onsets::event(std::size_t i) {
+	return events[i];
+}
+
+double Onsets::milliSeconds() {
+	return milliseconds;
+}
+
+long long Onsets::next(double sample) {
+
+	if (!picked) return -1;
+	const std::size_t i = std::partition_point(events.begin(), events.end(),
+		[sample](const onset &o) { return (double)o.sample <= sample; }) - events.begin();
+	return i < events.size() ? (long long)i : -1;
+
+}
+
+long long Onsets::previous(double sample) {
+
+	if (!picked) return -1;
+	const std::size_t i = std::partition_point(events.begin(), events.end(),
+		[sample](const onset &o) { return (double)o.sample < sample; }) - events.begin();
+	return (long long)i - 1;
+
+}
+
+void Onsets::find(double first, double last, std::size_t *begin, std::size_t *end) {
+
+	if (!picked) {
+		*begin = *end = 0;
+		return;
+	}
+	*begin = std::partition_point(events.begin(), events.end(),
+		[first](const onset &o) { return (double)o.sample < first; }) - events.begin();
+	*end = std::partition_point(events.begin() + *begin, events.end(),
+		[last](const onset &o) { return (double)o.sample < last; }) - events.begin();
+
+}
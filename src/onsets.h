@@ -0,0 +1,52 @@
+#ifndef ONSETS_H
+#define ONSETS_H
+
+#include <cstddef>
+
+#include "wav_source.h"
+
+// Where things start in the file: spectral flux onsets, found on the job
+// pool after it's opened. Jobs take ONSET_SEGMENT_HOPS hops each, stream
+// the (mono) samples through a frame that slides by ONSET_HOP, and sum the
+// power spectrum into ONSET_BANDS log spaced bands; the flux of a hop is
+// how much the log compressed bands rose since the one before. Only the
+// flux is kept, a float per hop. Once all of it is in, the peaks of the
+// flux over a moving average are picked in order on the main thread, into
+// a sorted index the view can jump along with a binary search.
+
+static const std::size_t ONSET_FFT = 1024;
+static const std::size_t ONSET_HOP = 512;
+static const std::size_t ONSET_BANDS = 32;
+static const std::size_t ONSET_SEGMENT_HOPS = 4096;		// about 47 s a job at 44.1 kHz
+
+struct onset {
+	std::size_t sample;
+	float strength;		// 0..1, the strongest in the file being 1
+};
+
+namespace Onsets {
+
+	// waits for the jobs still reading the old one, then queues the new one's. NULL drops it.
+	void setSource(const WavSource *source);
+
+	// true once all of the jobs are done; the first call that sees it picks the onsets
+	bool ready();
+
+	// until ready(), for the headless run
+	void wait();
+
+	// of the last ready() file
+	std::size_t count();
+	const onset &event(std::size_t i);
+	double milliSeconds();
+
+	// the first onset after sample and the last one before it; -1 if there's none
+	long long next(double sample);
+	long long previous(double sample);
+
+	// the onsets in samples [first, last) are [*begin, *end)
+	void find(double first, double last, std::size_t *begin, std::size_t *end);
+
+};
+
+#endif
@@ -0,0 +1,394 @@
+#include "phosphor.h"
+#include "definitions.h"
+#include "shader.h"
+#include "timeline.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#define BUFFER_OFFSET(i) (reinterpret_cast<void*>(i))
+
+namespace {
+
+	// a trigger needs the signal below -hysteresis first, then fires at the next sample >= 0
+	const short hysteresis = 512;
+	const std::size_t scan_block = 1 << 16;
+
+	const float decay = 0.85f;		// per frame
+	const float exposure = 3.0f;
+
+	ShaderProgram *sweep_program = NULL, *decay_program = NULL, *tonemap_program = NULL;
+	GLuint accum_texture = 0, accum_FBOid = 0;
+	GLuint triggers_TBOid = 0, triggers_texture = 0;
+
+	const WavSource *source = NULL;
+	bool scanned = false;			// the triggers of source are found the first time they're wanted
+	std::size_t *triggers = NULL;	// sample indices, ascending
+	std::size_t trigger_count = 0;
+	std::size_t sweep_length = 0;
+	std::size_t num_samples = 0;
+
+	std::size_t last_sweeps = 0;
+
+	// counts the triggers, and writes them too with out != NULL
+	std::size_t scan(const WavSource &source, std::size_t *out) {
+
+		short *block = MemStats::allocArray<short>(MEM_LOD, scan_block);
+		std::size_t count = 0;
+		bool armed = false;
+
+		for (std::size_t first = 0; first < source.sampleCount(); first += scan_block) {
+			const std::size_t n = source.read(first, scan_block, block);
+			for (std::size_t i = 0; i < n; ++i) {
+				if (block[i] < -hysteresis) {
+					armed = true;
+				}
+				else if (armed && block[i] >= 0) {
+					if (out) out[count] = first + i;
+					++count;
+					armed = false;
+				}
+			}
+		}
+
+		MemStats::release(block);
+		return count;
+
+	}
+
+	// two passes over the whole file, so only once the phosphor is actually drawn
+	void findTriggers() {
+
+		if (scanned || !source) return;
+		scanned = true;
+
+		PROFILE_ZONE("phosphor triggers");
+
+		trigger_count = scan(*source, NULL);
+		if (trigger_count < 2) {
+			printf("Phosphor: no periodic signal to trigger on.\n");
+			trigger_count = 0;
+			return;
+		}
+
+		triggers = MemStats::allocArray<std::size_t>(MEM_LOD, trigger_count);
+		scan(*source, triggers);
+
+		// two periods across the window, going by the median trigger spacing
+		std::size_t *spacing = MemStats::allocArray<std::size_t>(MEM_LOD, trigger_count - 1);
+		for (std::size_t i = 0; i + 1 < trigger_count; ++i) {
+			spacing[i] = triggers[i + 1] - triggers[i];
+		}
+		std::size_t *median = spacing + (trigger_count - 1)/2;
+		std::nth_element(spacing, median, spacing + trigger_count - 1);
+		sweep_length = 2*(*median);
+		MemStats::release(spacing);
+
+		if (sweep_length < 16) sweep_length = 16;
+		if (sweep_length > PHOSPHOR_MAX_SWEEP) sweep_length = PHOSPHOR_MAX_SWEEP;
+
+		printf("Phosphor: %u triggers, sweeps of %u samples.\n", (unsigned)trigger_count, (unsigned)sweep_length);
+
+	}
+
+#ifdef WAVEPLOT_GL33
+
+	GLuint quad = 0;
+	unsigned int frame = 0;
+
+	// texture units of the sweep pass
+	enum { UNIT_SAMPLES_0 = 1, UNIT_SAMPLES_1, UNIT_TRIGGERS };
+
+	struct {
+		GLint samples_0, samples_1, triggers, trigger_base, count_0, count_1, sweep_length, y_offset, y_scale, intensity;
+	} sweep_loc;
+
+	GLint decay_loc, tonemap_texture_loc, exposure_loc;
+
+	// the sweeps' trigger offsets, relative to their own chunk, and which chunk that is
+	GLint offsets[PHOSPHOR_SWEEPS_PER_FRAME];
+	std::size_t chunk_of[PHOSPHOR_SWEEPS_PER_FRAME];
+
+	void bindSamples(GLenum unit, GLuint texture) {
+
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+
+	}
+
+	void drawQuad() {
+
+		glBindBuffer(GL_ARRAY_BUFFER, quad);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+	}
+
+#endif
+
+}
+
+bool Phosphor::init(GLuint quad_VBOid, bool int16_samples) {
+
+#ifdef WAVEPLOT_GL33
+
+	quad = quad_VBOid;
+
+	sweep_program = new ShaderProgram("shaders/phosphor_vertex.shader.win", "shaders/phosphor_fragment.shader.win", "",
+									  int16_samples ? "#define SAMPLES_INT16\n" : "");
+	decay_program = new ShaderProgram("shaders/quad_passthrough.shader.win", "shaders/phosphor_decay_fragment.shader.win", "");
+	tonemap_program = new ShaderProgram("shaders/quad_passthrough.shader.win", "shaders/phosphor_tonemap_fragment.shader.win", "");
+
+	if (!sweep_program->valid() || !decay_program->valid() || !tonemap_program->valid()) {
+		printf("Phosphor: couldn't build the shaders, the phosphor renderer is unavailable.\n");
+		destroy();
+		return false;
+	}
+
+	const GLuint sp = sweep_program->programHandle();
+	sweep_loc.samples_0 = glGetUniformLocation(sp, "samples_0");
+	sweep_loc.samples_1 = glGetUniformLocation(sp, "samples_1");
+	sweep_loc.triggers = glGetUniformLocation(sp, "triggers");
+	sweep_loc.trigger_base = glGetUniformLocation(sp, "trigger_base");
+	sweep_loc.count_0 = glGetUniformLocation(sp, "count_0");
+	sweep_loc.count_1 = glGetUniformLocation(sp, "count_1");
+	sweep_loc.sweep_length = glGetUniformLocation(sp, "sweep_length");
+	sweep_loc.y_offset = glGetUniformLocation(sp, "y_offset");
+	sweep_loc.y_scale = glGetUniformLocation(sp, "y_scale");
+	sweep_loc.intensity = glGetUniformLocation(sp, "intensity");
+
+	decay_loc = glGetUniformLocation(decay_program->programHandle(), "decay");
+	tonemap_texture_loc = glGetUniformLocation(tonemap_program->programHandle(), "texture_1");
+	exposure_loc = glGetUniformLocation(tonemap_program->programHandle(), "exposure");
+
+	// one float channel; half floats run out of precision long before thousands of faint sweeps add up
+	glGenTextures(1, &accum_texture);
+	glBindTexture(GL_TEXTURE_2D, accum_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, WIN_W, WIN_H, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	MemStats::trackTexture(accum_texture, MEM_TEXTURES, WIN_W*WIN_H*sizeof(float));
+
+	glGenFramebuffers(1, &accum_FBOid);
+	glBindFramebuffer(GL_FRAMEBUFFER, accum_FBOid);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, accum_texture, 0);
+
+	GLenum m[1] = { GL_COLOR_ATTACHMENT0 };
+	glDrawBuffers(1, m);
+
+	const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (!complete) {
+		printf("Phosphor: R32F render target unsupported, the phosphor renderer is unavailable.\n");
+		destroy();
+		return false;
+	}
+
+	glGenBuffers(1, &triggers_TBOid);
+	glBindBuffer(GL_TEXTURE_BUFFER, triggers_TBOid);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(offsets), NULL, GL_STREAM_DRAW);
+	MemStats::trackBuffer(triggers_TBOid, MEM_OTHER, sizeof(offsets));
+
+	glGenTextures(1, &triggers_texture);
+	glBindTexture(GL_TEXTURE_BUFFER, triggers_texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, triggers_TBOid);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	clear();
+
+	return true;
+
+#else
+	return false;
+#endif
+
+}
+
+void Phosphor::destroy() {
+
+	setSource(NULL);
+
+	if (accum_FBOid) {
+		glDeleteFramebuffers(1, &accum_FBOid);
+		accum_FBOid = 0;
+	}
+	if (accum_texture) {
+		MemStats::untrackTexture(accum_texture);
+		glDeleteTextures(1, &accum_texture);
+		accum_texture = 0;
+	}
+	if (triggers_TBOid) {
+		MemStats::untrackBuffer(triggers_TBOid);
+		glDeleteTextures(1, &triggers_texture);
+		glDeleteBuffers(1, &triggers_TBOid);
+		triggers_TBOid = triggers_texture = 0;
+	}
+
+	delete sweep_program;
+	delete decay_program;
+	delete tonemap_program;
+	sweep_program = decay_program = tonemap_program = NULL;
+
+}
+
+void Phosphor::setSource(const WavSource *source_) {
+
+	MemStats::release(triggers);
+	triggers = NULL;
+	trigger_count = sweep_length = 0;
+	scanned = false;
+
+	source = source_;
+	num_samples = source ? source->sampleCount() : 0;
+
+}
+
+std::size_t Phosphor::sweepLength() {
+	findTriggers();
+	return sweep_length;
+}
+
+void Phosphor::clear() {
+
+	if (!accum_FBOid) return;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, accum_FBOid);
+	glClearColor(0.0, 0.0, 0.0, 0.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glClearColor(1.0, 1.0, 1.0, 1.0);
+
+}
+
+void Phosphor::draw(const phosphor_view &v, GLuint framebuffer) {
+
+#ifdef WAVEPLOT_GL33
+
+	if (!sweep_program) return;
+
+	findTriggers();
+
+	PROFILE_ZONE("phosphor");
+
+	++frame;
+	last_sweeps = 0;
+
+	// the fade
+	glBindFramebuffer(GL_FRAMEBUFFER, accum_FBOid);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+	glUseProgram(decay_program->programHandle());
+	glUniform1f(decay_loc, decay);
+	drawQuad();
+
+	// the triggers whose sweeps start in view and end before the end of the file
+	const double first = v.first_sample < 0 ? 0 : v.first_sample;
+	const double last = v.last_sample < (double)num_samples ? v.last_sample : (double)num_samples;
+	const std::size_t *lo = std::lower_bound(triggers, triggers + trigger_count, (std::size_t)ceil(first));
+	const std::size_t *hi = triggers + trigger_count;
+	if (last > first && last - first > sweep_length) {
+		hi = std::lower_bound(lo, hi, (std::size_t)(last - sweep_length));
+	}
+	else {
+		hi = lo;
+	}
+
+	const std::size_t total = hi - lo;
+	std::size_t max_sweeps = PHOSPHOR_VERTICES_PER_FRAME/(sweep_length ? sweep_length : 1);
+	if (max_sweeps > PHOSPHOR_SWEEPS_PER_FRAME) max_sweeps = PHOSPHOR_SWEEPS_PER_FRAME;
+
+	// every stride-th trigger, starting a little further along each frame
+	const std::size_t stride = (total + max_sweeps - 1)/max_sweeps;
+
+	if (total) {
+
+		const std::size_t phase = frame % stride;
+
+		// they're ascending, so each chunk's sweeps are one run
+		std::size_t n = 0;
+		for (const std::size_t *t = lo + phase; t < hi && n < max_sweeps; t += stride, ++n) {
+			chunk_of[n] = Timeline::chunkFor(*t);
+			offsets[n] = (GLint)(*t - chunk_of[n]*TIMELINE_CHUNK_SAMPLES);
+		}
+
+		glBindBuffer(GL_TEXTURE_BUFFER, triggers_TBOid);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(offsets), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, n*sizeof(GLint), offsets);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		// no attributes, the sweep vertices are all gl_VertexID and gl_InstanceID
+		glDisableVertexAttribArray(0);
+		glDisableVertexAttribArray(1);
+
+		glBlendFunc(GL_ONE, GL_ONE);
+		glUseProgram(sweep_program->programHandle());
+		glUniform1i(sweep_loc.samples_0, UNIT_SAMPLES_0);
+		glUniform1i(sweep_loc.samples_1, UNIT_SAMPLES_1);
+		glUniform1i(sweep_loc.triggers, UNIT_TRIGGERS);
+		glUniform1i(sweep_loc.sweep_length, (GLint)sweep_length);
+		glUniform1f(sweep_loc.y_offset, 2*v.y_offset/WIN_H - 1);
+		glUniform1f(sweep_loc.y_scale, 2*v.y_scale/WIN_H);
+		// the same energy per frame however many sweeps there are
+		glUniform1f(sweep_loc.intensity, 1.0f/n);
+
+		bindSamples(UNIT_TRIGGERS, triggers_texture);
+
+		for (std::size_t a = 0; a < n;) {
+
+			std::size_t b = a + 1;
+			while (b < n && chunk_of[b] == chunk_of[a]) ++b;
+
+			const std::size_t i = chunk_of[a];
+			const timeline_chunk &c = Timeline::chunk(i);
+			if (c.resident) {
+
+				const bool next = i + 1 < Timeline::chunkCount() && Timeline::chunk(i + 1).resident;
+
+				bindSamples(UNIT_SAMPLES_0, c.textureid);
+				bindSamples(UNIT_SAMPLES_1, next ? Timeline::chunk(i + 1).textureid : c.textureid);
+				glUniform1i(sweep_loc.trigger_base, (GLint)a);
+				glUniform1i(sweep_loc.count_0, (GLint)c.count);
+				glUniform1i(sweep_loc.count_1, next ? (GLint)Timeline::chunk(i + 1).count : 0);
+				glDrawArraysInstanced(GL_LINE_STRIP, 0, (GLsizei)sweep_length, (GLsizei)(b - a));
+
+				last_sweeps += b - a;
+			}
+
+			a = b;
+		}
+
+		bindSamples(UNIT_SAMPLES_0, 0);
+		bindSamples(UNIT_SAMPLES_1, 0);
+		bindSamples(UNIT_TRIGGERS, 0);
+
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+	}
+
+	// the tone map, over whatever's in framebuffer already
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glUseProgram(tonemap_program->programHandle());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, accum_texture);
+	glUniform1i(tonemap_texture_loc, 0);
+	glUniform1f(exposure_loc, exposure);
+	drawQuad();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+
+#endif
+
+}
+
+std::size_t Phosphor::lastSweeps() {
+	return last_sweeps;
+}
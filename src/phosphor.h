@@ -0,0 +1,54 @@
+#ifndef PHOSPHOR_H
+#define PHOSPHOR_H
+
+#include <cstddef>
+
+#include "gl_includes.h"
+#include "wav_source.h"
+
+// Oscilloscope-style persistence. The visible stretch of the file is cut
+// at its trigger points (rising zero crossings, found once per file) and
+// the sweeps are stacked on top of each other across the window, each one
+// adding a little energy into a float accumulation buffer. Every frame the
+// buffer is first faded by a constant factor, then tone-mapped over the
+// background. Sweeps are drawn instanced, one line strip per chunk, with
+// the samples straight from the timeline's buffer textures. A frame draws
+// at most a few thousand of them; with more in view a different stride
+// phase goes in every frame, and the persistence fills in the rest.
+//
+// GL 3.3 only, like WaveShader (the timeline has to be opened without
+// meshes).
+
+static const std::size_t PHOSPHOR_SWEEPS_PER_FRAME = 4096;
+static const std::size_t PHOSPHOR_VERTICES_PER_FRAME = 1 << 18;
+static const std::size_t PHOSPHOR_MAX_SWEEP = 8192;	// samples; well within a timeline chunk
+
+struct phosphor_view {
+	double first_sample, last_sample;	// the range the sweeps come from, the timeline has its chunks in
+	float y_offset, y_scale;			// window y (from the bottom) = y_offset + y_scale*sample, sample in [-1, 1]
+};
+
+namespace Phosphor {
+
+	// quad_VBOid holds the fullscreen quad, two triangles in NDC
+	bool init(GLuint quad_VBOid, bool int16_samples);
+	void destroy();
+
+	// a new file, NULL drops it. Its triggers and the sweep length (two median
+	// periods) are found when either is first wanted, so the scan is only paid
+	// for in phosphor mode.
+	void setSource(const WavSource *source);
+	std::size_t sweepLength();
+
+	// wipes the persistence
+	void clear();
+
+	// into framebuffer, which is given back bound
+	void draw(const phosphor_view &v, GLuint framebuffer);
+
+	// sweeps drawn by the last draw()
+	std::size_t lastSweeps();
+
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "post_chain.h"
+#include "definitions.h"
+#include "shader.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+#include <vector>
+#include <cstdio>
+
+#define BUFFER_OFFSET(i) (reinterpret_cast<void*>(i))
+
+namespace {
+
+	struct entry {
+		post_pass pass;
+		bool enabled;
+		GLint texture_loc, scene_loc;
+	};
+
+	struct target {
+		GLuint FBOid, textureid;
+	};
+
+	// 0 holds the scene; 1 and 2 only come into play with two or more passes
+	const int MAX_TARGETS = 3;
+
+	std::vector<entry> passes;
+	std::vector<int> plan;	// this frame's passes, in order
+	target targets[MAX_TARGETS];
+	GLuint quad = 0;
+	bool elide = true;
+	bool keep_scene = false;	// a pass after the first reads the scene, so target 0 is off limits
+	bool target_failed = false;
+
+	bool ensureTarget(int i) {
+
+		target &t = targets[i];
+		if (t.FBOid) return true;
+
+		glGenTextures(1, &t.textureid);
+		glBindTexture(GL_TEXTURE_2D, t.textureid);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, WIN_W, WIN_H, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		MemStats::trackTexture(t.textureid, MEM_TEXTURES, WIN_W*WIN_H*4);	// RGB8 gets padded to 4 bytes pretty much everywhere
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &t.FBOid);
+		glBindFramebuffer(GL_FRAMEBUFFER, t.FBOid);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, t.textureid, 0);
+		GLenum m[1] = { GL_COLOR_ATTACHMENT0 };
+		glDrawBuffers(1, m);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("PostChain: render target %d incomplete, post-processing is off.\n", i);
+			target_failed = true;
+			return false;
+		}
+		return true;
+
+	}
+
+	void releaseTarget(int i) {
+
+		target &t = targets[i];
+		if (t.FBOid) glDeleteFramebuffers(1, &t.FBOid);
+		if (t.textureid) {
+			MemStats::untrackTexture(t.textureid);
+			glDeleteTextures(1, &t.textureid);
+		}
+		t.FBOid = t.textureid = 0;
+
+	}
+
+	// a target other than the current one, and not the scene if something still needs it
+	int nextTarget(int current) {
+
+		for (int i = 0; i < MAX_TARGETS; ++i) {
+			if (i == current || (keep_scene && i == 0)) continue;
+			return i;
+		}
+		return -1;
+
+	}
+
+}
+
+void PostChain::init(GLuint quad_VBOid) {
+
+	quad = quad_VBOid;
+
+}
+
+void PostChain::destroy() {
+
+	for (int i = 0; i < MAX_TARGETS; ++i) {
+		releaseTarget(i);
+	}
+	passes.clear();
+	plan.clear();
+	target_failed = false;
+
+}
+
+int PostChain::add(const post_pass &pass, bool enabled) {
+
+	entry e;
+	e.pass = pass;
+	e.enabled = enabled;
+	e.texture_loc = glGetUniformLocation(pass.program->programHandle(), "texture_1");
+	e.scene_loc = glGetUniformLocation(pass.program->programHandle(), "scene");
+	passes.push_back(e);
+
+	return (int)passes.size() - 1;
+
+}
+
+void PostChain::setEnabled(int pass, bool enabled) {
+	passes[pass].enabled = enabled;
+}
+
+bool PostChain::enabled(int pass) {
+	return passes[pass].enabled;
+}
+
+void PostChain::setElision(bool e) {
+	elide = e;
+}
+
+GLuint PostChain::begin(GLuint output) {
+
+	plan.clear();
+	keep_scene = false;
+	if (target_failed) return output;
+
+	for (std::size_t i = 0; i < passes.size(); ++i) {
+		const entry &e = passes[i];
+		if (!e.enabled || (elide && e.pass.identity)) continue;
+		if (!plan.empty() && (e.pass.inputs & POST_INPUT_SCENE)) keep_scene = true;
+		plan.push_back((int)i);
+	}
+
+	if (plan.empty()) return output;
+
+	// the scene, plus one to ping-pong into from the second pass on, plus one more to spare the scene
+	const int needed = plan.size() == 1 ? 1 : (keep_scene ? 3 : 2);
+	for (int i = 0; i < needed; ++i) {
+		if (!ensureTarget(i)) {
+			plan.clear();
+			return output;
+		}
+	}
+
+	return targets[0].FBOid;
+
+}
+
+void PostChain::end(GLuint output) {
+
+	PROFILE_ZONE("PostChain::end");
+
+	if (plan.empty()) return;
+
+	glDisable(GL_BLEND);
+
+	glBindBuffer(GL_ARRAY_BUFFER, quad);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, targets[0].textureid);
+
+	int current = 0;
+	for (std::size_t k = 0; k < plan.size(); ++k) {
+
+		const entry &e = passes[plan[k]];
+		const bool last = k + 1 == plan.size();
+		const int next = last ? -1 : nextTarget(current);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, last ? output : targets[next].FBOid);
+
+		glUseProgram(e.pass.program->programHandle());
+		glUniform1i(e.texture_loc, 0);
+		glUniform1i(e.scene_loc, 1);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, targets[current].textureid);
+
+		if (e.pass.setup) e.pass.setup(e.pass.user);
+
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+		current = next;
+	}
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	glEnable(GL_BLEND);
+	glUseProgram(0);
+
+}
+
+int PostChain::activePasses() {
+	return (int)plan.size();
+}
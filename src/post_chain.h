@@ -0,0 +1,53 @@
+#ifndef POST_CHAIN_H
+#define POST_CHAIN_H
+
+#include "gl_includes.h"
+
+class ShaderProgram;
+
+// Post-processing as an ordered list of fullscreen-quad passes. The scene
+// is drawn into whatever begin() hands out; end() then runs the enabled
+// passes, ping-ponging between offscreen targets, with the last one
+// writing straight into the output. A pass that doesn't change anything
+// (declared identity) is skipped, and if that leaves no passes at all the
+// scene goes into the output directly, no offscreen target involved.
+// Targets are only created once some pass actually needs them.
+
+// what a pass reads. the previous pass's result (the scene for the first
+// one) is bound to texture unit 0 as "texture_1", the untouched scene to
+// unit 1 as "scene".
+enum { POST_INPUT_PREVIOUS = 1, POST_INPUT_SCENE = 2 };
+
+struct post_pass {
+	const char *name;
+	ShaderProgram *program;
+	int inputs;			// POST_INPUT_*
+	bool identity;		// copies its input as is; only ever run with elision off
+	void (*setup)(void *user);	// with the program bound, for its uniforms; may be NULL
+	void *user;
+};
+
+namespace PostChain {
+
+	void init(GLuint quad_VBOid);
+	void destroy();
+
+	// returns the pass's index, for setEnabled. passes run in the order they're added.
+	int add(const post_pass &pass, bool enabled = true);
+	void setEnabled(int pass, bool enabled);
+	bool enabled(int pass);
+
+	// off: identity passes run like any other (the old always-resolve path, for comparison)
+	void setElision(bool elide);
+
+	// the framebuffer to draw the scene into this frame; output itself when the chain is a no-op
+	GLuint begin(GLuint output);
+	// runs the passes, ending up in output
+	void end(GLuint output);
+
+	// passes that ran in the last end()
+	int activePasses();
+
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "profiler.h"
+
+#include <atomic>
+#include <cstdio>
+
+#pragma warning(disable:4996)
+
+namespace {
+
+	struct event_block {
+		static const std::size_t capacity = 4096;
+		Profiler::event events[capacity];
+		std::atomic<std::size_t> count;		// published with release, read with acquire by the exporter
+		std::atomic<event_block*> next;
+		event_block() : count(0), next(NULL) {}
+	};
+
+	struct thread_buffer {
+		unsigned int tid;
+		event_block *head;	// read by the exporter
+		event_block *tail;	// only touched by the owning thread
+		thread_buffer *next;
+	};
+
+	std::atomic<thread_buffer*> registry(NULL);
+	std::atomic<unsigned int> next_tid(0);
+	timer_tick_t session_start = 0;
+
+	thread_local thread_buffer *local_buffer = NULL;
+
+	thread_buffer *registerThread() {
+
+		thread_buffer *b = new thread_buffer;
+		b->tid = next_tid++;
+		b->head = b->tail = new event_block;
+
+		// lock-free push to the front of the registry
+		thread_buffer *old_head = registry.load(std::memory_order_relaxed);
+		do {
+			b->next = old_head;
+		} while (!registry.compare_exchange_weak(old_head, b, std::memory_order_release, std::memory_order_relaxed));
+
+		return b;
+	}
+
+	void writeEscaped(FILE *fp, const char *s) {
+		for (; *s; ++s) {
+			if (*s == '"' || *s == '\\') fputc('\\', fp);
+			fputc(*s, fp);
+		}
+	}
+
+	Profiler::event &appendEvent() {
+
+		if (!local_buffer) {
+			local_buffer = registerThread();
+		}
+
+		event_block *block = local_buffer->tail;
+		const std::size_t n = block->count.load(std::memory_order_relaxed);
+
+		if (n == event_block::capacity) {
+			event_block *fresh = new event_block;
+			block->next.store(fresh, std::memory_order_release);
+			local_buffer->tail = fresh;
+			return fresh->events[0];
+		}
+
+		return block->events[n];
+	}
+
+	// makes the event returned by appendEvent() visible to the exporter
+	void publishEvent() {
+		event_block *block = local_buffer->tail;
+		block->count.store(block->count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+}
+
+bool Profiler::init() {
+
+	if (!Timer::init()) {
+		return false;
+	}
+	session_start = Timer::get();
+	return true;
+
+}
+
+void Profiler::record(const char *name, timer_tick_t begin, timer_tick_t end) {
+
+	event &e = appendEvent();
+	e.name = name;
+	e.begin = begin;
+	e.end = end;
+	e.kind = EVENT_ZONE;
+	publishEvent();
+
+}
+
+void Profiler::counter(const char *name, double value) {
+
+	event &e = appendEvent();
+	e.name = name;
+	e.begin = e.end = Timer::get();
+	e.value = value;
+	e.kind = EVENT_COUNTER;
+	publishEvent();
+
+}
+
+bool Profiler::writeChromeTrace(const std::string &filename) {
+
+	FILE *fp = fopen(filename.c_str(), "w");
+	if (!fp) {
+		printf("Profiler: couldn't open %s for writing.\n", filename.c_str());
+		return false;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool first = true;
+	std::size_t total = 0;
+
+	for (thread_buffer *b = registry.load(std::memory_order_acquire); b; b = b->next) {
+		for (event_block *block = b->head; block; block = block->next.load(std::memory_order_acquire)) {
+
+			const std::size_t n = block->count.load(std::memory_order_acquire);
+
+			for (std::size_t i = 0; i < n; ++i) {
+				const event &e = block->events[i];
+				fprintf(fp, "%s{\"name\":\"", first ? "" : ",\n");
+				writeEscaped(fp, e.name);
+				if (e.kind == EVENT_COUNTER) {
+					fprintf(fp, "\",\"ph\":\"C\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%f}}",
+						b->tid,
+						Timer::ticksToMicroSeconds(e.begin - session_start),
+						e.value);
+				}
+				else {
+					fprintf(fp, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						b->tid,
+						Timer::ticksToMicroSeconds(e.begin - session_start),
+						Timer::ticksToMicroSeconds(e.end - e.begin));
+				}
+				first = false;
+			}
+			total += n;
+		}
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	printf("Profiler: wrote %u events to %s.\n", (unsigned)total, filename.c_str());
+
+	return true;
+
+}
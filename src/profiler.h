@@ -0,0 +1,46 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <cstddef>
+
+#include "timer.h"
+
+// Scoped CPU profiling zones. Every thread appends into its own chain of
+// fixed-size event blocks, so recording never takes a lock; the blocks are
+// kept for the whole session and written out as a Chrome/Perfetto trace
+// (load it in chrome://tracing or ui.perfetto.dev). Counters (e.g. GPU pass
+// times) go into the same buffers and show up as their own tracks.
+
+namespace Profiler {
+
+	enum { EVENT_ZONE, EVENT_COUNTER };
+
+	struct event {
+		const char *name;	// must be a string literal (or otherwise outlive the session)
+		timer_tick_t begin;
+		timer_tick_t end;
+		double value;		// counters only
+		int kind;
+	};
+
+	bool init();
+	void record(const char *name, timer_tick_t begin, timer_tick_t end);
+	void counter(const char *name, double value);
+	bool writeChromeTrace(const std::string &filename);
+
+	class Zone {
+		const char *name;
+		timer_tick_t begin;
+	public:
+		Zone(const char *name_) : name(name_), begin(Timer::get()) {}
+		~Zone() { Profiler::record(name, begin, Timer::get()); }
+	};
+
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,121 @@
+#include "range_stats.h"
+
+#include <cmath>
+
+#if defined(_WIN32) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RANGE_STATS_SSE2
+#endif
+
+namespace {
+
+	struct partial {
+		int min, max;
+		double sum_sq;
+	};
+
+	void scan(const short *s, std::size_t n, partial &p) {
+
+		std::size_t i = 0;
+
+#ifdef RANGE_STATS_SSE2
+		if (n >= 8) {
+			__m128i lo = _mm_set1_epi16(32767), hi = _mm_set1_epi16(-32768);
+			__m128i sq = _mm_setzero_si128();
+			const __m128i zero = _mm_setzero_si128();
+
+			for (; i + 8 <= n; i += 8) {
+				const __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+				lo = _mm_min_epi16(lo, v);
+				hi = _mm_max_epi16(hi, v);
+				// sums of two squares, up to 2^31: fine as unsigned, widened to 64 bits
+				const __m128i pairs = _mm_madd_epi16(v, v);
+				sq = _mm_add_epi64(sq, _mm_add_epi64(_mm_unpacklo_epi32(pairs, zero), _mm_unpackhi_epi32(pairs, zero)));
+			}
+
+			short l[8], h[8];
+			unsigned long long q[2];
+			_mm_storeu_si128((__m128i*)l, lo);
+			_mm_storeu_si128((__m128i*)h, hi);
+			_mm_storeu_si128((__m128i*)q, sq);
+			for (int k = 0; k < 8; ++k) {
+				if (l[k] < p.min) p.min = l[k];
+				if (h[k] > p.max) p.max = h[k];
+			}
+			p.sum_sq += (double)(q[0] + q[1]);
+		}
+#endif
+
+		for (; i < n; ++i) {
+			const int v = s[i];
+			if (v < p.min) p.min = v;
+			if (v > p.max) p.max = v;
+			p.sum_sq += (double)(v*v);
+		}
+
+	}
+
+	// straight from the mapping when it's mono, a bin at a time through a downmix otherwise
+	void scanRange(const WavSource &source, std::size_t first, std::size_t last, partial &p) {
+
+		if (first >= last) return;
+
+		if (source.direct()) {
+			scan(source.direct() + first, last - first, p);
+			return;
+		}
+
+		short buffer[LOD_BASE_BIN];
+		while (first < last) {
+			const std::size_t n = source.read(first, (last - first < LOD_BASE_BIN) ? last - first : LOD_BASE_BIN, buffer);
+			if (!n) break;
+			scan(buffer, n, p);
+			first += n;
+		}
+
+	}
+
+	inline void addBin(const lod_bin &b, std::size_t width, partial &p) {
+		if (b.min < p.min) p.min = b.min;
+		if (b.max > p.max) p.max = b.max;
+		p.sum_sq += (double)b.rms*b.rms*width;
+	}
+
+}
+
+bool RangeStats::query(const WavSource &source, const lod_pyramid &lod, std::size_t first, std::size_t last, range_stats *out) {
+
+	const std::size_t num_samples = source.sampleCount();
+	if (last > num_samples) last = num_samples;
+	if (first >= last) return false;
+
+	partial p = { 32767, -32768, 0.0 };
+
+	// the whole level 0 bins [a, b) in the middle, the samples on either side of them scanned
+	const std::size_t bin = lod.level_count ? lod.bin_size : 0;
+	std::size_t a = bin ? (first + bin - 1)/bin : 0, b = bin ? last/bin : 0;
+
+	if (a >= b) {
+		scanRange(source, first, last, p);
+	}
+	else {
+		scanRange(source, first, a*bin, p);
+		scanRange(source, b*bin, last, p);
+
+		// up the pyramid, taking the odd bins at either end on the way. the bins
+		// taken are all full ones, the short one at the end of a level is never inside [a, b).
+		for (int level = 0; a < b; ++level, a >>= 1, b >>= 1) {
+			const std::size_t width = lod.samplesPerBin(level);
+			if (a & 1) addBin(lod.levels[level][a++], width, p);
+			if (b & 1) addBin(lod.levels[level][--b], width, p);
+		}
+	}
+
+	out->min = (short)p.min;
+	out->max = (short)p.max;
+	out->count = last - first;
+	out->rms = (float)sqrt(p.sum_sq/out->count);
+
+	return true;
+
+}
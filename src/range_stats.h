@@ -0,0 +1,30 @@
+#ifndef RANGE_STATS_H
+#define RANGE_STATS_H
+
+#include <cstddef>
+
+#include "lod.h"
+#include "wav_source.h"
+
+// min/max/rms of any range of samples without touching more than a few
+// hundred of them: the whole bins inside the range come from the LOD
+// pyramid, at most two per level (the coarsest ones that fit, like a
+// segment tree), and only the partial level 0 bins at both ends are read
+// from the source, with SSE2. So a query is O(log n) bins plus at most
+// 2*LOD_BASE_BIN samples, whatever the length of the range.
+
+struct range_stats {
+	short min, max;		// int16 units, like the LOD
+	float rms;
+	std::size_t count;	// samples in the range
+};
+
+namespace RangeStats {
+
+	// samples [first, last), clamped to the file; false if that's empty.
+	// without a pyramid the whole range is scanned.
+	bool query(const WavSource &source, const lod_pyramid &lod, std::size_t first, std::size_t last, range_stats *out);
+
+};
+
+#endif
@@ -1,7 +1,17 @@
 #include "shader.h"
 
 
-ShaderProgram::ShaderProgram(const std::string& VS_filename, const std::string &FS_filename, const std::string &GS_filename) {
+namespace {
+
+	void insertDefines(std::string &source, const std::string &defines) {
+		if (defines.empty()) return;
+		const std::size_t eol = source.find('\n');
+		source.insert(eol == std::string::npos ? source.length() : eol + 1, defines);
+	}
+
+}
+
+ShaderProgram::ShaderProgram(const std::string& VS_filename, const std::string &FS_filename, const std::string &GS_filename, const std::string &defines) {
 
 	std::ofstream logfile(Shader::logfilename, std::ios::ate);
 	logfile << "";
@@ -32,6 +42,9 @@ ShaderProgram::ShaderProgram(const std::string& VS_filename, const std::string &
 	}
 	buffer << input.rdbuf();
 	std::string FS_contents(buffer.str());
+
+	insertDefines(VS_contents, defines);
+	insertDefines(FS_contents, defines);
 	
 	//printf("%s", fs_contents.c_str());
 	if (GS_filename != "") {
@@ -22,7 +22,8 @@ class ShaderProgram {
 public:
 	
 	GLint checkLinkStatus();
-	ShaderProgram(const std::string& vs_filename, const std::string& fs_filename, const std::string &gs_filename);
+	// defines (e.g. "#define FOO\n") go in right after the #version line of both stages
+	ShaderProgram(const std::string& vs_filename, const std::string& fs_filename, const std::string &gs_filename, const std::string &defines = "");
 
 	bool valid() const;
 
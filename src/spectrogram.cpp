@@ -0,0 +1,428 @@
+#include "spectrogram.h"
+#include "definitions.h"
+#include "shader.h"
+#include "fft.h"
+#include "job_pool.h"
+#include "mem_stats.h"
+#include "profiler.h"
+#include "timer.h"
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#define BUFFER_OFFSET(i) (reinterpret_cast<void*>(i))
+
+namespace {
+
+	// a slot goes FREE -> QUEUED (main thread) -> DONE (worker) -> UPLOADED (main thread),
+	// and only an UPLOADED one is taken over for another block
+	enum { SLOT_FREE, SLOT_QUEUED, SLOT_DONE, SLOT_UPLOADED };
+
+	const int SLOTS_ACROSS = SPECTROGRAM_ATLAS_SIZE/SPECTROGRAM_BLOCK_COLUMNS;
+	const int SLOT_COUNT = SLOTS_ACROSS*(SPECTROGRAM_ATLAS_SIZE/SPECTROGRAM_ROWS);
+	const int PLAN_COUNT = 5;	// SPECTROGRAM_MIN_FFT to SPECTROGRAM_MAX_FFT
+	const int MAX_COARSER = 3;	// hops up to 8x as long stand in for a missing block
+
+	struct slot {
+		spectrogram_key key;
+		std::atomic<int> state;
+		unsigned int last_used;
+		unsigned char *pixels;	// SPECTROGRAM_ROWS rows of SPECTROGRAM_BLOCK_COLUMNS, the lowest frequency first
+	};
+
+	slot slots[SLOT_COUNT];
+	unsigned char *pixels = NULL;
+	fft_plan plans[PLAN_COUNT];
+	unsigned int row_bins[PLAN_COUNT][SPECTROGRAM_ROWS + 1];	// the first bin of every row, and one past the last
+
+	const WavSource *source = NULL;
+	std::size_t num_samples = 0;
+	std::size_t fft_size = 1024;
+	std::size_t last_hop = 0;
+	std::size_t queued = 0;
+
+	std::atomic<int> in_flight(0);		// blocks submitted whose job hasn't returned yet
+	std::atomic<unsigned long long> columns_done(0);
+	std::atomic<long long> compute_ticks(0);
+
+	ShaderProgram *program = NULL;
+	GLuint atlas = 0;
+
+	int planIndex(std::size_t n) {
+		int i = 0;
+		while ((SPECTROGRAM_MIN_FFT << i) < n) ++i;
+		return i;
+	}
+
+	// rows evenly spaced in log frequency up to nyquist, however many bins that makes each
+	void makeRowBins(double rate) {
+
+		const double lo = SPECTROGRAM_MIN_HZ, hi = 0.5*rate;
+
+		for (int p = 0; p < PLAN_COUNT; ++p) {
+			const std::size_t n = SPECTROGRAM_MIN_FFT << p;
+			for (std::size_t r = 0; r < SPECTROGRAM_ROWS; ++r) {
+				const double f = lo*pow(hi/lo, (double)r/SPECTROGRAM_ROWS);
+				row_bins[p][r] = (unsigned int)(f*n/rate);
+			}
+			row_bins[p][SPECTROGRAM_ROWS] = (unsigned int)(n/2 + 1);
+		}
+
+	}
+
+#ifdef WAVEPLOT_GL33
+
+	GLuint quad = 0;
+	GLint texture_loc, uv_rect_loc, uv_clamp_loc;
+	unsigned int current_frame = 0;
+
+	// this draw()'s view
+	double view_first = 0.0, pixels_per_sample = 0.0;
+	int band_y = 0, band_height = 0;
+
+	const float background[3] = { 0.95f, 0.95f, 0.97f };	// the same as an empty texel in the shader
+
+	bool sameKey(const spectrogram_key &a, const spectrogram_key &b) {
+		return a.fft_size == b.fft_size && a.hop == b.hop && a.block == b.block;
+	}
+
+	// on a worker: the block's columns, straight into the slot's pixels
+	void computeBlock(void *user) {
+
+		slot &s = *static_cast<slot*>(user);
+		const timer_tick_t t0 = Timer::get();
+
+		const std::size_t n = s.key.fft_size;
+		const int p = planIndex(n);
+		const unsigned int *bins = row_bins[p];
+
+		thread_local std::vector<float> frame, power, scratch;
+		frame.resize(n);
+		power.resize(n/2 + 1);
+		scratch.resize(FFT::scratchSize(n));
+
+		const float db_scale = 255.0f/-SPECTROGRAM_FLOOR_DB;
+
+		for (std::size_t c = 0; c < SPECTROGRAM_BLOCK_COLUMNS; ++c) {
+
+			// centered on the column, zeros past either end of the file
+			const long long column = s.key.block*(long long)SPECTROGRAM_BLOCK_COLUMNS + (long long)c;
+			const long long start = column*(long long)s.key.hop - (long long)(n/2);
+			const std::size_t skip = start < 0 ? (std::size_t)-start : 0;
+
+			std::fill(frame.begin(), frame.end(), 0.0f);
+			if (skip < n) source->read((std::size_t)(start + (long long)skip), n - skip, &frame[skip]);
+
+			FFT::power(plans[p], &frame[0], &power[0], &scratch[0]);
+
+			for (std::size_t r = 0; r < SPECTROGRAM_ROWS; ++r) {
+				const unsigned int b0 = bins[r], b1 = std::max(bins[r + 1], b0 + 1);
+				float peak = power[b0];
+				for (unsigned int b = b0 + 1; b < b1; ++b) peak = std::max(peak, power[b]);
+
+				const float level = (10.0f*log10f(peak + 1e-20f) - SPECTROGRAM_FLOOR_DB)*db_scale;
+				s.pixels[r*SPECTROGRAM_BLOCK_COLUMNS + c] = (unsigned char)std::min(std::max(level, 0.0f), 255.0f);
+			}
+		}
+
+		columns_done += SPECTROGRAM_BLOCK_COLUMNS;
+		compute_ticks += Timer::get() - t0;
+		s.state.store(SLOT_DONE, std::memory_order_release);
+		in_flight.fetch_sub(1, std::memory_order_release);
+
+	}
+
+	int findSlot(const spectrogram_key &k) {
+
+		for (int i = 0; i < SLOT_COUNT; ++i) {
+			if (slots[i].state.load(std::memory_order_relaxed) != SLOT_FREE && sameKey(slots[i].key, k)) return i;
+		}
+		return -1;
+
+	}
+
+	// an empty slot, or else the least recently used one not on screen this frame
+	int victimSlot() {
+
+		int victim = -1;
+		for (int i = 0; i < SLOT_COUNT; ++i) {
+			const int state = slots[i].state.load(std::memory_order_relaxed);
+			if (state == SLOT_FREE) return i;
+			if (state != SLOT_UPLOADED || slots[i].last_used == current_frame) continue;
+			if (victim < 0 || slots[i].last_used < slots[victim].last_used) victim = i;
+		}
+		return victim;
+
+	}
+
+	// the block's slot, queued if it wasn't there; -1 when there's no room for it this frame
+	int request(const spectrogram_key &k) {
+
+		int i = findSlot(k);
+		if (i < 0) {
+			if (queued >= SPECTROGRAM_MAX_QUEUED || (i = victimSlot()) < 0) return -1;
+			slots[i].key = k;
+			slots[i].state.store(SLOT_QUEUED, std::memory_order_relaxed);
+			++queued;
+			in_flight.fetch_add(1, std::memory_order_relaxed);
+			JobPool::submit(computeBlock, &slots[i]);
+		}
+		slots[i].last_used = current_frame;
+		return i;
+
+	}
+
+	bool uploaded(int i) {
+		return i >= 0 && slots[i].state.load(std::memory_order_relaxed) == SLOT_UPLOADED;
+	}
+
+	// samples [first, last) of the view, from the slot that covers [slot_first, slot_last)
+	void drawPart(int i, double slot_first, double slot_last, double first, double last) {
+
+		// whole pixels, so that neighbours neither overlap nor leave a gap
+		int xa = (int)floor((first - view_first)*pixels_per_sample + 0.5);
+		int xb = (int)floor((last - view_first)*pixels_per_sample + 0.5);
+		if (xa < 0) xa = 0;
+		if (xb > (int)WIN_W) xb = (int)WIN_W;
+		if (xb <= xa) return;
+
+		// and back to samples for the texture coordinates
+		const double sa = view_first + xa/pixels_per_sample, sb = view_first + xb/pixels_per_sample;
+
+		const float du = (float)SPECTROGRAM_BLOCK_COLUMNS/SPECTROGRAM_ATLAS_SIZE, dv = (float)SPECTROGRAM_ROWS/SPECTROGRAM_ATLAS_SIZE;
+		const float u0 = (i % SLOTS_ACROSS)*du, v0 = (i / SLOTS_ACROSS)*dv;
+		const float ua = u0 + du*(float)((sa - slot_first)/(slot_last - slot_first));
+		const float ub = u0 + du*(float)((sb - slot_first)/(slot_last - slot_first));
+
+		// half a texel in, so the filtering doesn't pull in the neighbouring slots
+		const float half = 0.5f/SPECTROGRAM_ATLAS_SIZE;
+		glUniform4f(uv_rect_loc, ua, v0, ub - ua, dv);
+		glUniform4f(uv_clamp_loc, u0 + half, v0 + half, u0 + du - half, v0 + dv - half);
+
+		glViewport(xa, band_y, xb - xa, band_height);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+	}
+
+	// a block spans its columns' centers, half a hop either way
+	double blockFirst(const spectrogram_key &k) {
+		return ((double)k.block*SPECTROGRAM_BLOCK_COLUMNS - 0.5)*k.hop;
+	}
+
+#endif
+
+}
+
+bool Spectrogram::init(GLuint quad_VBOid) {
+
+#ifdef WAVEPLOT_GL33
+
+	quad = quad_VBOid;
+
+	program = new ShaderProgram("shaders/quad_passthrough.shader.win", "shaders/spectrogram_fragment.shader.win", "");
+	if (!program->valid()) {
+		printf("Spectrogram: couldn't build the shader, the spectrogram is unavailable.\n");
+		destroy();
+		return false;
+	}
+
+	texture_loc = glGetUniformLocation(program->programHandle(), "texture_1");
+	uv_rect_loc = glGetUniformLocation(program->programHandle(), "uv_rect");
+	uv_clamp_loc = glGetUniformLocation(program->programHandle(), "uv_clamp");
+
+	for (int p = 0; p < PLAN_COUNT; ++p) {
+		FFT::plan(SPECTROGRAM_MIN_FFT << p, &plans[p]);
+	}
+
+	pixels = MemStats::allocArray<unsigned char>(MEM_OTHER, SPECTROGRAM_ATLAS_SIZE*SPECTROGRAM_ATLAS_SIZE);
+	for (int i = 0; i < SLOT_COUNT; ++i) {
+		slots[i].pixels = pixels + i*SPECTROGRAM_BLOCK_COLUMNS*SPECTROGRAM_ROWS;
+		slots[i].state.store(SLOT_FREE);
+		slots[i].last_used = 0;
+	}
+
+	glGenTextures(1, &atlas);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, SPECTROGRAM_ATLAS_SIZE, SPECTROGRAM_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	MemStats::trackTexture(atlas, MEM_TEXTURES, SPECTROGRAM_ATLAS_SIZE*SPECTROGRAM_ATLAS_SIZE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return true;
+
+#else
+	return false;
+#endif
+
+}
+
+void Spectrogram::destroy() {
+
+	setSource(NULL);
+
+	if (atlas) {
+		MemStats::untrackTexture(atlas);
+		glDeleteTextures(1, &atlas);
+		atlas = 0;
+	}
+
+	for (int p = 0; p < PLAN_COUNT; ++p) {
+		FFT::release(&plans[p]);
+	}
+	MemStats::release(pixels);
+	pixels = NULL;
+
+	delete program;
+	program = NULL;
+
+}
+
+void Spectrogram::setSource(const WavSource *source_) {
+
+	// nothing of the old file may still be in the works; the other owners' jobs can carry on
+	JobPool::wait(in_flight);
+
+	for (int i = 0; i < SLOT_COUNT; ++i) {
+		slots[i].state.store(SLOT_FREE);
+	}
+	queued = 0;
+	source = NULL;
+	num_samples = 0;
+
+	if (!source_ || !source_->sampleCount()) return;
+
+	source = source_;
+	num_samples = source->sampleCount();
+	makeRowBins(source->header().sampleRate > 0 ? source->header().sampleRate : 44100);
+
+}
+
+void Spectrogram::setFFTSize(std::size_t n) {
+
+	if (n < SPECTROGRAM_MIN_FFT) n = SPECTROGRAM_MIN_FFT;
+	if (n > SPECTROGRAM_MAX_FFT) n = SPECTROGRAM_MAX_FFT;
+	fft_size = SPECTROGRAM_MIN_FFT << planIndex(n);
+
+}
+
+std::size_t Spectrogram::fftSize() {
+	return fft_size;
+}
+
+void Spectrogram::draw(double first_sample, double last_sample, int y, int height, GLuint framebuffer) {
+
+#ifdef WAVEPLOT_GL33
+
+	if (!program || !source || last_sample <= first_sample) return;
+
+	PROFILE_ZONE("spectrogram");
+
+	++current_frame;
+
+	// whatever the workers finished since the last frame goes up first
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	for (int i = 0; i < SLOT_COUNT; ++i) {
+		if (slots[i].state.load(std::memory_order_acquire) != SLOT_DONE) continue;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, (i % SLOTS_ACROSS)*SPECTROGRAM_BLOCK_COLUMNS, (i / SLOTS_ACROSS)*SPECTROGRAM_ROWS,
+			SPECTROGRAM_BLOCK_COLUMNS, SPECTROGRAM_ROWS, GL_RED, GL_UNSIGNED_BYTE, slots[i].pixels);
+		slots[i].state.store(SLOT_UPLOADED, std::memory_order_relaxed);
+		--queued;
+	}
+
+	// about a column a pixel when zoomed out, never less than 75% overlap zoomed in
+	const double samples_per_pixel = (last_sample - first_sample)/WIN_W;
+	std::size_t h = fft_size/4;
+	while (h < samples_per_pixel) h *= 2;
+	last_hop = h;
+
+	view_first = first_sample;
+	pixels_per_sample = WIN_W/(last_sample - first_sample);
+	band_y = y;
+	band_height = height;
+
+	const double block_samples = (double)SPECTROGRAM_BLOCK_COLUMNS*h;
+	const long long last_block = (long long)((num_samples - 1)/h/SPECTROGRAM_BLOCK_COLUMNS);
+	long long b0 = (long long)floor((first_sample + 0.5*h)/block_samples);
+	long long b1 = (long long)floor((last_sample + 0.5*h)/block_samples);
+	if (b0 < 0) b0 = 0;
+	if (b1 > last_block) b1 = last_block;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, y, WIN_W, height);
+	glClearColor(background[0], background[1], background[2], 1.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glClearColor(1.0, 1.0, 1.0, 1.0);
+	glDisable(GL_SCISSOR_TEST);
+
+	glDisable(GL_BLEND);
+	glBindBuffer(GL_ARRAY_BUFFER, quad);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
+	glUseProgram(program->programHandle());
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(texture_loc, 0);
+
+	for (long long b = b0; b <= b1; ++b) {
+
+		spectrogram_key k = { fft_size, h, b };
+		const int i = request(k);
+		const double first = blockFirst(k), last = first + block_samples;
+
+		if (uploaded(i)) {
+			drawPart(i, first, last, first, last);
+			continue;
+		}
+
+		// not there yet; a coarser one of the same stretch will do for now
+		for (int up = 1; up <= MAX_COARSER; ++up) {
+			spectrogram_key c = { fft_size, h << up, b >> up };
+			const int j = findSlot(c);
+			if (!uploaded(j)) continue;
+			const double c_first = blockFirst(c);
+			drawPart(j, c_first, c_first + block_samples*(1 << up), first, last);
+			slots[j].last_used = current_frame;
+			break;
+		}
+	}
+
+	// and one either side for panning, after everything on screen
+	if (b0 > 0) {
+		spectrogram_key k = { fft_size, h, b0 - 1 };
+		request(k);
+	}
+	if (b1 < last_block) {
+		spectrogram_key k = { fft_size, h, b1 + 1 };
+		request(k);
+	}
+
+	glViewport(0, 0, WIN_W, WIN_H);
+	glEnable(GL_BLEND);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+
+#endif
+
+}
+
+std::size_t Spectrogram::hop() {
+	return last_hop;
+}
+
+std::size_t Spectrogram::queuedBlocks() {
+	return queued;
+}
+
+std::size_t Spectrogram::columnsComputed() {
+	return (std::size_t)columns_done.load();
+}
+
+double Spectrogram::computeMilliSeconds() {
+	return Timer::ticksToMicroSeconds(compute_ticks.load())/1000.0;
+}
@@ -0,0 +1,65 @@
+#ifndef SPECTROGRAM_H
+#define SPECTROGRAM_H
+
+#include <cstddef>
+
+#include "gl_includes.h"
+#include "wav_source.h"
+
+// Short-time Fourier transform of the file, as a band under the waveform.
+// Columns are Hann windowed frames hop samples apart, hop being a quarter
+// of the FFT size or, zoomed out, the power of two that keeps them about a
+// pixel wide. Only what's in view gets computed, straight from the mapped
+// file, so the length of the file doesn't matter.
+//
+// Columns go in blocks: a block is one job on the job pool and one slot of
+// a texture atlas (log frequency rows, 8-bit dB). The slots are keyed by
+// (FFT size, hop, block) and reused least recently used, so zooming back
+// and forth or switching the FFT size finds its columns still there. A
+// block shows up as soon as its job is done; until then a coarser block of
+// the same stretch is stretched over it, if there is one.
+//
+// GL 3.3 only.
+
+static const std::size_t SPECTROGRAM_BLOCK_COLUMNS = 64;
+static const std::size_t SPECTROGRAM_ROWS = 256;
+static const std::size_t SPECTROGRAM_ATLAS_SIZE = 2048;		// texels square, 256 blocks
+static const std::size_t SPECTROGRAM_MAX_QUEUED = 32;		// blocks in flight; the rest wait for later frames
+static const std::size_t SPECTROGRAM_MIN_FFT = 256;
+static const std::size_t SPECTROGRAM_MAX_FFT = 4096;
+static const float SPECTROGRAM_FLOOR_DB = -96.0f;			// the bottom of the 8 bits, 0 dB being a full scale sine
+static const float SPECTROGRAM_MIN_HZ = 20.0f;				// the lowest row
+
+struct spectrogram_key {
+	std::size_t fft_size;
+	std::size_t hop;
+	long long block;	// its first column is block*SPECTROGRAM_BLOCK_COLUMNS, centered at that times hop
+};
+
+namespace Spectrogram {
+
+	bool init(GLuint quad_VBOid);
+	void destroy();
+
+	// waits for the jobs still reading the old one. NULL drops it.
+	void setSource(const WavSource *source);
+
+	// a power of two between SPECTROGRAM_MIN_FFT and SPECTROGRAM_MAX_FFT
+	void setFFTSize(std::size_t n);
+	std::size_t fftSize();
+
+	// uploads the finished blocks, queues the missing ones of [first_sample, last_sample),
+	// and draws the band between window rows y and y + height (from the bottom)
+	void draw(double first_sample, double last_sample, int y, int height, GLuint framebuffer);
+
+	// of the last draw()
+	std::size_t hop();
+	std::size_t queuedBlocks();
+
+	// columns computed so far, and the time the jobs took (summed over the workers)
+	std::size_t columnsComputed();
+	double computeMilliSeconds();
+
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "text.h"
+#include "mem_stats.h"
 
 #pragma warning(disable:4996)
 
@@ -120,7 +121,9 @@ void generateTextCommonIndices(void *arg) {
 		j += 4;
 	}
 
+#ifdef _WIN32
 	_endthread();
+#endif
 
 }
 
@@ -142,14 +145,18 @@ void wpstring_holder::append(const wpstring& str, GLuint static_mask) {
 
 void wpstring_holder::createBufferObjects() {
 
-	GLushort *text_common_indices = new GLushort[common_indices_count];
+	GLushort *text_common_indices = MemStats::allocArray<GLushort>(MEM_TEXT, common_indices_count);
+#ifdef _WIN32
 	HANDLE handle;
 	handle = (HANDLE)_beginthread(generateTextCommonIndices, 0, &text_common_indices);
+#else
+	generateTextCommonIndices(&text_common_indices);
+#endif
 
 	glGenBuffers(1, &static_VBOid);
 	glBindBuffer(GL_ARRAY_BUFFER, static_VBOid);
 
-	glyph *glyphs = new glyph[static_strings_total_length];
+	glyph *glyphs = MemStats::allocArray<glyph>(MEM_TEXT, static_strings_total_length);
 
 	float a;
 	
@@ -168,13 +175,14 @@ void wpstring_holder::createBufferObjects() {
 	}
 
 	glBufferData(GL_ARRAY_BUFFER, sizeof(glyph) * static_strings_total_length, (const GLvoid*)glyphs, GL_STATIC_DRAW); 
+	MemStats::trackBuffer(static_VBOid, MEM_TEXT, sizeof(glyph) * static_strings_total_length);
 
-	delete [] glyphs;
+	MemStats::release(glyphs);
 
 	glGenBuffers(1, &dynamic_VBOid);
 	glBindBuffer(GL_ARRAY_BUFFER, dynamic_VBOid);
 
-	glyphs = new glyph[wpstring_max_length*dynamic_strings.size()];
+	glyphs = MemStats::allocArray<glyph>(MEM_TEXT, wpstring_max_length*dynamic_strings.size());
 	
 	i = 0,j = 0, g = 0;
 
@@ -192,17 +200,21 @@ void wpstring_holder::createBufferObjects() {
 	}
 	
 	glBufferData(GL_ARRAY_BUFFER, sizeof(glyph) * dynamic_strings.size()*wpstring_max_length, (const GLvoid*)glyphs, GL_DYNAMIC_DRAW);
+	MemStats::trackBuffer(dynamic_VBOid, MEM_TEXT, sizeof(glyph) * dynamic_strings.size()*wpstring_max_length);
 
-	delete [] glyphs;
+	MemStats::release(glyphs);
+#ifdef _WIN32
 	WaitForSingleObject(handle, INFINITE);
+#endif
 
 
 	glGenBuffers(1, &shared_IBOid);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shared_IBOid);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (common_indices_count-1)*sizeof(GLushort), (const GLvoid*)text_common_indices, GL_STATIC_DRAW);
+	MemStats::trackBuffer(shared_IBOid, MEM_TEXT, (common_indices_count-1)*sizeof(GLushort));
 
 
-	delete [] text_common_indices;
+	MemStats::release(text_common_indices);
 
 }
 
@@ -6,7 +6,9 @@
 #include <string>
 #include <cstring>
 #include <vector>
+#ifdef _WIN32
 #include <process.h>
+#endif
 
 #include "definitions.h"
 #include "precalculated_texcoords.h"
@@ -0,0 +1,87 @@
+#include "texture.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+	unsigned int readLE(const unsigned char *p, int bytes) {
+		unsigned int v = 0;
+		for (int i = bytes - 1; i >= 0; --i) v = (v << 8) | p[i];
+		return v;
+	}
+
+	std::string bmpName(const std::string &filename) {
+		const std::size_t dot = filename.find_last_of('.');
+		if (dot == std::string::npos || filename.compare(dot, std::string::npos, ".png") != 0) return filename;
+		return filename.substr(0, dot) + ".bmp";
+	}
+
+	// to top-down RGBA, false if it isn't a BMP we know
+	bool readBMP(const std::string &filename, int *width, int *height, std::vector<unsigned char> *rgba) {
+
+		FILE *f = fopen(filename.c_str(), "rb");
+		if (!f) {
+			printf("Texture: couldn't open %s\n", filename.c_str());
+			return false;
+		}
+
+		std::vector<unsigned char> file;
+		unsigned char buf[65536];
+		std::size_t got;
+		while ((got = fread(buf, 1, sizeof(buf), f)) > 0) file.insert(file.end(), buf, buf + got);
+		fclose(f);
+
+		if (file.size() < 54 || file[0] != 'B' || file[1] != 'M') {
+			printf("Texture: %s isn't a BMP\n", filename.c_str());
+			return false;
+		}
+
+		const unsigned int offset = readLE(&file[10], 4);
+		const int w = (int)readLE(&file[18], 4), h = (int)readLE(&file[22], 4);
+		const unsigned int bpp = readLE(&file[28], 2), compression = readLE(&file[30], 4);
+		const int rows = h < 0 ? -h : h;
+		const std::size_t stride = ((std::size_t)w*3 + 3) & ~(std::size_t)3;
+
+		if (bpp != 24 || compression != 0 || w <= 0 || rows == 0 || offset + stride*rows > file.size()) {
+			printf("Texture: %s: only uncompressed 24-bit BMPs are supported\n", filename.c_str());
+			return false;
+		}
+
+		rgba->resize((std::size_t)w*rows*4);
+		for (int y = 0; y < rows; ++y) {
+			// rows are stored bottom up unless the height is negative
+			const unsigned char *src = &file[offset + stride*(h < 0 ? y : rows - 1 - y)];
+			unsigned char *dst = &(*rgba)[(std::size_t)y*w*4];
+			for (int x = 0; x < w; ++x) {
+				dst[4*x + 0] = src[3*x + 2];
+				dst[4*x + 1] = src[3*x + 1];
+				dst[4*x + 2] = src[3*x + 0];
+				dst[4*x + 3] = 255;
+			}
+		}
+
+		*width = w;
+		*height = rows;
+		return true;
+
+	}
+
+}
+
+Texture::Texture() : textureId(0), width(0), height(0) {}
+
+Texture::Texture(const std::string &filename, GLint filter) : textureId(0), width(0), height(0) {
+
+	std::vector<unsigned char> rgba;
+	if (!readBMP(bmpName(filename), &width, &height, &rgba)) return;
+
+	glGenTextures(1, &textureId);
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+}
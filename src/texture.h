@@ -0,0 +1,28 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "gl_includes.h"
+
+#include <string>
+
+// A 2D RGBA8 texture from an uncompressed 24-bit BMP. There's no png
+// decoder in the tree, so for "x.png" the "x.bmp" next to it is read
+// (every texture in textures/ has both). The GL texture is left alone on
+// destruction, copies share it; they live as long as the context anyway.
+
+class Texture {
+
+public:
+
+	Texture();
+	Texture(const std::string &filename, GLint filter);
+
+	bool bad() const { return textureId == 0; }
+	GLuint getId() const { return textureId; }
+
+	GLuint textureId;
+	int width, height;
+
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "tile_cache.h"
+#include "definitions.h"
+#include "mem_stats.h"
+
+#include <vector>
+#include <cstdio>
+
+namespace {
+
+	struct tile {
+		tile_key key;
+		GLuint textureid, FBOid;
+		unsigned int last_used;
+		bool valid;
+	};
+
+	std::vector<tile> tiles;
+	unsigned int lookups = 0;
+	unsigned int window_hits = 0, window_lookups = 0;
+
+	bool sameKey(const tile_key &a, const tile_key &b) {
+		return a.zoom == b.zoom && a.index == b.index && a.y == b.y && a.style == b.style;
+	}
+
+}
+
+void TileCache::init(std::size_t capacity) {
+
+	destroy();
+	tiles.resize(capacity);
+
+	for (std::size_t i = 0; i < tiles.size(); ++i) {
+		tile &t = tiles[i];
+
+		glGenTextures(1, &t.textureid);
+		glBindTexture(GL_TEXTURE_2D, t.textureid);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WIN_W, WIN_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		MemStats::trackTexture(t.textureid, MEM_TILES, WIN_W*WIN_H*4);
+
+		glGenFramebuffers(1, &t.FBOid);
+		glBindFramebuffer(GL_FRAMEBUFFER, t.FBOid);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, t.textureid, 0);
+		GLenum m[1] = { GL_COLOR_ATTACHMENT0 };
+		glDrawBuffers(1, m);
+
+		t.last_used = 0;
+		t.valid = false;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	printf("TileCache: %u tiles of %ux%u.\n", (unsigned)tiles.size(), WIN_W, WIN_H);
+
+}
+
+void TileCache::destroy() {
+
+	for (std::size_t i = 0; i < tiles.size(); ++i) {
+		MemStats::untrackTexture(tiles[i].textureid);
+		glDeleteTextures(1, &tiles[i].textureid);
+		glDeleteFramebuffers(1, &tiles[i].FBOid);
+	}
+	tiles.clear();
+
+}
+
+void TileCache::clear() {
+
+	for (std::size_t i = 0; i < tiles.size(); ++i) {
+		tiles[i].valid = false;
+	}
+
+}
+
+GLuint TileCache::acquire(const tile_key &key, GLuint *render_target) {
+
+	++lookups;
+	++window_lookups;
+
+	std::size_t victim = 0;
+	for (std::size_t i = 0; i < tiles.size(); ++i) {
+		tile &t = tiles[i];
+		if (t.valid && sameKey(t.key, key)) {
+			t.last_used = lookups;
+			++window_hits;
+			*render_target = 0;
+			return t.textureid;
+		}
+		// an empty slot, or else the oldest
+		if (!tiles[victim].valid) continue;
+		if (!t.valid || t.last_used < tiles[victim].last_used) victim = i;
+	}
+
+	*render_target = 0;
+	if (tiles.empty()) return 0;
+
+	tile &t = tiles[victim];
+	t.key = key;
+	t.last_used = lookups;
+	t.valid = true;
+	glBindFramebuffer(GL_FRAMEBUFFER, t.FBOid);
+	*render_target = t.FBOid;
+	return t.textureid;
+
+}
+
+double TileCache::takeHitRate() {
+
+	const double rate = window_lookups ? (double)window_hits/window_lookups : 0.0;
+	window_hits = window_lookups = 0;
+	return rate;
+
+}
+
+std::size_t TileCache::capacity() {
+	return tiles.size();
+}
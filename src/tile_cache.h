@@ -0,0 +1,41 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <cstddef>
+
+#include "gl_includes.h"
+
+// Finished renderings of the waveform, one window-sized texture per tile,
+// so that panning at a fixed zoom is a couple of textured quads instead of
+// a full drawWave. A tile is one window width of the view at a given zoom;
+// tile i starts at world x = i*(visible width). Tiles are rendered on a
+// miss into a slot of their own and evicted least recently used.
+
+struct tile_key {
+	float zoom;
+	long long index;
+	int y;		// vertical pan, in whole pixels
+	int style;	// render mode, polygon mode, texture; anything else that changes the look
+};
+
+namespace TileCache {
+
+	void init(std::size_t capacity);
+	void destroy();
+
+	// drops every tile (new document)
+	void clear();
+
+	// the texture holding the tile. on a miss the least recently used slot is
+	// taken over, and *render_target is its framebuffer, left bound for the
+	// caller to render the tile into; 0 on a hit.
+	GLuint acquire(const tile_key &key, GLuint *render_target);
+
+	// hits / lookups since the last call, for the HUD
+	double takeHitRate();
+
+	std::size_t capacity();
+
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "timeline.h"
+#include "bake.h"
+#include "arena.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+#include <vector>
+#include <cstdio>
+
+namespace {
+
+	// the bake leaves its last couple of vertices in a mess, so every chunk
+	// is baked this many samples past its end and those are never drawn
+	static const std::size_t trail = 3;
+
+	const WavSource *source = NULL;
+	bool int16 = true;
+	bool meshes = true;
+	std::size_t budget_bytes = 0;
+
+	std::vector<timeline_chunk> chunks;
+	std::vector<std::size_t> resident;	// indices into chunks, unordered
+	std::size_t resident_bytes = 0;
+	unsigned int frame = 0;
+
+	Arena staging(4*1024*1024);
+
+	void uploadSamples(timeline_chunk &c, const void *samples, std::size_t n) {
+
+#ifdef WAVEPLOT_GL33
+		const std::size_t bytes = n*(int16 ? sizeof(short) : sizeof(float));
+
+		glGenBuffers(1, &c.TBOid);
+		glBindBuffer(GL_TEXTURE_BUFFER, c.TBOid);
+		glBufferData(GL_TEXTURE_BUFFER, bytes, samples, GL_STATIC_DRAW);
+		MemStats::trackBuffer(c.TBOid, int16 ? MEM_IO : MEM_CONVERT, bytes);
+
+		// GL 3.3 has no snorm buffer texture formats, so int16 goes up as R16I and the shader divides by 32768
+		glGenTextures(1, &c.textureid);
+		glBindTexture(GL_TEXTURE_BUFFER, c.textureid);
+		glTexBuffer(GL_TEXTURE_BUFFER, int16 ? GL_R16I : GL_R32F, c.TBOid);
+
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		c.bytes += bytes;
+		resident_bytes += bytes;
+#endif
+
+	}
+
+	template <typename S>
+	void bakeChunk(timeline_chunk &c, std::size_t n) {
+
+		// padded with the last sample, the bake wants at least four
+		const std::size_t padded = n < 4 ? 4 : n;
+		S *samples = staging.allocArray<S>(int16 ? MEM_IO : MEM_CONVERT, padded);
+		const std::size_t got = source->read(c.first, n, samples);
+		for (std::size_t i = got; i < padded; ++i) {
+			samples[i] = got ? samples[got - 1] : 0;
+		}
+
+		c.bytes = 0;
+
+		if (meshes) {
+			const vertex *vertices = bakeWaveVertexBufferUsingLineIntersections(samples, padded, staging);
+			const std::size_t vertex_bytes = (2*padded - 2)*sizeof(vertex);
+
+			glGenBuffers(1, &c.VBOid);
+			glBindBuffer(GL_ARRAY_BUFFER, c.VBOid);
+			glBufferData(GL_ARRAY_BUFFER, vertex_bytes, (const GLvoid*)vertices, GL_STATIC_DRAW);
+			MemStats::trackBuffer(c.VBOid, MEM_BAKE, vertex_bytes);
+
+			c.bytes = vertex_bytes;
+			resident_bytes += vertex_bytes;
+		}
+
+		uploadSamples(c, samples + c.lead, c.count);
+
+	}
+
+	void makeResident(std::size_t i) {
+
+		timeline_chunk &c = chunks[i];
+		if (c.resident) return;
+
+		PROFILE_ZONE("chunk bake");
+
+		const std::size_t begin = i*TIMELINE_CHUNK_SAMPLES;
+		c.first = begin ? begin - 1 : 0;
+		c.lead = begin - c.first;
+
+		const Arena::marker m = staging.mark();
+		if (int16) {
+			bakeChunk<short>(c, c.lead + c.count + trail);
+		}
+		else {
+			bakeChunk<float>(c, c.lead + c.count + trail);
+		}
+		staging.rewind(m);
+
+		c.resident = true;
+		resident.push_back(i);
+
+	}
+
+	void evict(std::size_t r) {
+
+		timeline_chunk &c = chunks[resident[r]];
+
+		if (c.VBOid) {
+			MemStats::untrackBuffer(c.VBOid);
+			glDeleteBuffers(1, &c.VBOid);
+		}
+		if (c.TBOid) {
+			MemStats::untrackBuffer(c.TBOid);
+			glDeleteTextures(1, &c.textureid);
+			glDeleteBuffers(1, &c.TBOid);
+		}
+		c.VBOid = c.TBOid = c.textureid = 0;
+
+		resident_bytes -= c.bytes;
+		c.bytes = 0;
+		c.resident = false;
+
+		resident[r] = resident.back();
+		resident.pop_back();
+
+	}
+
+	void evictOverBudget() {
+
+		while (resident_bytes > budget_bytes) {
+
+			// least recently used, but never anything wanted this frame
+			std::size_t victim = resident.size();
+			unsigned int oldest = frame;
+			for (std::size_t r = 0; r < resident.size(); ++r) {
+				if (chunks[resident[r]].last_used < oldest) {
+					oldest = chunks[resident[r]].last_used;
+					victim = r;
+				}
+			}
+			if (victim == resident.size()) break;	// the budget doesn't even cover the view
+
+			evict(victim);
+		}
+
+	}
+
+}
+
+void Timeline::open(const WavSource *source_, bool int16_samples, bool meshes_, std::size_t budget_) {
+
+	close();
+
+	source = source_;
+	int16 = int16_samples;
+	meshes = meshes_;
+	budget_bytes = budget_;
+
+	const std::size_t n = source->sampleCount();
+	chunks.resize((n + TIMELINE_CHUNK_SAMPLES - 1) / TIMELINE_CHUNK_SAMPLES);
+
+	for (std::size_t i = 0; i < chunks.size(); ++i) {
+		timeline_chunk &c = chunks[i];
+		c.VBOid = c.TBOid = c.textureid = 0;
+		c.first = c.lead = 0;
+		c.count = (i + 1 < chunks.size()) ? TIMELINE_CHUNK_SAMPLES : n - i*TIMELINE_CHUNK_SAMPLES;
+		c.bytes = 0;
+		c.last_used = 0;
+		c.resident = false;
+	}
+
+	printf("Timeline: %u chunks of %u samples, %u MiB budget.\n",
+		(unsigned)chunks.size(), (unsigned)TIMELINE_CHUNK_SAMPLES, (unsigned)(budget_bytes >> 20));
+
+}
+
+void Timeline::close() {
+
+	while (!resident.empty()) {
+		evict(resident.size() - 1);
+	}
+	chunks.clear();
+	staging.reset();
+	source = NULL;
+	frame = 0;
+
+}
+
+void Timeline::update(double first_visible, double last_visible, int direction) {
+
+	if (chunks.empty()) return;
+
+	PROFILE_ZONE("timeline update");
+
+	++frame;
+
+	const std::size_t lo = chunkFor(first_visible), hi = chunkFor(last_visible);
+
+	for (std::size_t i = lo; i <= hi; ++i) {
+		makeResident(i);
+		chunks[i].last_used = frame;
+	}
+
+	// keep the next few chunks along the pan around, and bake at most one of them per frame
+	bool baked = false;
+	for (std::size_t k = 1; k <= TIMELINE_PREFETCH_CHUNKS; ++k) {
+		if (direction > 0 ? hi + k >= chunks.size() : lo < k) break;
+		const std::size_t i = direction > 0 ? hi + k : lo - k;
+		if (!chunks[i].resident) {
+			if (baked) continue;
+			makeResident(i);
+			baked = true;
+		}
+		chunks[i].last_used = frame;
+	}
+
+	evictOverBudget();
+
+}
+
+std::size_t Timeline::chunkCount() {
+	return chunks.size();
+}
+
+std::size_t Timeline::chunkFor(double sample) {
+
+	if (sample <= 0.0 || chunks.empty()) return 0;
+	const std::size_t i = (std::size_t)(sample / TIMELINE_CHUNK_SAMPLES);
+	return i < chunks.size() ? i : chunks.size() - 1;
+
+}
+
+const timeline_chunk &Timeline::chunk(std::size_t i) {
+	return chunks[i];
+}
+
+std::size_t Timeline::residentChunks() {
+	return resident.size();
+}
+
+std::size_t Timeline::residentBytes() {
+	return resident_bytes;
+}
+
+std::size_t Timeline::budget() {
+	return budget_bytes;
+}
+
+std::size_t Timeline::chunksInBudget() {
+
+	// what makeResident() puts up for a chunk that isn't the last one
+	const std::size_t n = 1 + TIMELINE_CHUNK_SAMPLES + trail;
+	std::size_t bytes = 0;
+#ifdef WAVEPLOT_GL33
+	bytes += TIMELINE_CHUNK_SAMPLES*(int16 ? sizeof(short) : sizeof(float));
+#endif
+	if (meshes) bytes += (2*n - 2)*sizeof(vertex);
+
+	return bytes ? budget_bytes/bytes : chunks.size();
+
+}
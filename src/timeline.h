@@ -0,0 +1,54 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <cstddef>
+
+#include "gl_includes.h"
+#include "wav_source.h"
+
+// The waveform split into fixed-size chunks, each baked into its own vertex
+// buffer (plus a buffer texture of its samples) only while it's near the
+// view. update() gets the visible sample range once a frame: visible chunks
+// that are missing are baked right away, one chunk ahead in the pan
+// direction is prefetched per frame, and the least recently used chunks are
+// evicted whenever the GL buffers go over the budget. On the host side
+// there's only the mapped file and one chunk of staging, however long the
+// file is.
+
+static const std::size_t TIMELINE_CHUNK_SAMPLES = 1 << 16;
+static const std::size_t TIMELINE_PREFETCH_CHUNKS = 2;
+
+struct timeline_chunk {
+	GLuint VBOid;
+	GLuint TBOid, textureid;	// the chunk's samples, R16I (R32F with float samples)
+	std::size_t first;		// first baked sample, one before the chunk so the joins line up
+	std::size_t lead;		// samples baked ahead of the chunk's own first one
+	std::size_t count;		// samples of the chunk itself
+	std::size_t bytes;
+	unsigned int last_used;
+	bool resident;
+};
+
+namespace Timeline {
+
+	// without meshes only the sample buffer textures are made (for the shader renderer)
+	void open(const WavSource *source, bool int16_samples, bool meshes, std::size_t budget_bytes);
+	void close();
+
+	// direction > 0 when panning towards the end of the file
+	void update(double first_visible, double last_visible, int direction);
+
+	std::size_t chunkCount();
+	std::size_t chunkFor(double sample);
+	const timeline_chunk &chunk(std::size_t i);
+
+	std::size_t residentChunks();
+	std::size_t residentBytes();
+	std::size_t budget();
+
+	// how many full chunks the budget holds at once
+	std::size_t chunksInBudget();
+
+};
+
+#endif
@@ -1,7 +1,7 @@
 #include "timer.h"
 
 double Timer::cpu_freq = 0;
-__int64 Timer::counter_start = 0;
+timer_tick_t Timer::counter_start = 0;
 
 #ifdef _WIN32
 bool Timer::init() {
@@ -21,7 +21,7 @@ void Timer::start() {
 	counter_start = li.QuadPart;
 }
 
-__int64 Timer::get() {
+timer_tick_t Timer::get() {
 	LARGE_INTEGER li;
 	QueryPerformanceCounter(&li);
 	return li.QuadPart;
@@ -29,8 +29,28 @@ __int64 Timer::get() {
 
 #elif __linux__
 
-bool Timer::init() { }// stub
-void Timer::start() { } // stub
-long int Timer::get() { } // stub
+// CLOCK_MONOTONIC isn't affected by settimeofday/ntp jumps, and the ticks are
+// always nanoseconds, so the "frequency" is a constant 1 GHz.
 
-#endif
\ No newline at end of file
+bool Timer::init() {
+	struct timespec res;
+	if (clock_getres(CLOCK_MONOTONIC, &res) != 0) {
+		printf("Timer initialization failed.\n");
+		return false;
+	}
+	cpu_freq = 1000000000.0;
+
+	return true;
+}
+
+void Timer::start() {
+	counter_start = Timer::get();
+}
+
+timer_tick_t Timer::get() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (timer_tick_t)ts.tv_sec*1000000000LL + (timer_tick_t)ts.tv_nsec;
+}
+
+#endif
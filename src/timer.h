@@ -1,21 +1,29 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#ifdef _WIN32
 #include <Windows.h>
+typedef __int64 timer_tick_t;
+
+#elif __linux__
+#include <time.h>
+typedef long long timer_tick_t;
+#endif
+
 #include <stdio.h>
 
 class Timer {
 
-	static double cpu_freq;	// in kHz
-	static __int64 counter_start;
+	static double cpu_freq;	// ticks per second
+	static timer_tick_t counter_start;
 
 public:
-	
+
 	static bool init();
 	static void start();
-	static __int64 get();
+	static timer_tick_t get();
 
-	static inline double getSeconds() {	
+	static inline double getSeconds() {
 		return double(Timer::get()-Timer::counter_start)/Timer::cpu_freq;
 	}
 	static inline double getMilliSeconds() {
@@ -25,9 +33,14 @@ public:
 		return double(1000000*(Timer::getSeconds()));
 	}
 
+	// for converting raw get() deltas, doesn't touch counter_start
+	static inline double ticksToMicroSeconds(timer_tick_t ticks) {
+		return double(1000000*(double(ticks)/Timer::cpu_freq));
+	}
+
 };
 
 
 
 
-#endif
\ No newline at end of file
+#endif
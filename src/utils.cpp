@@ -1,4 +1,6 @@
 #include "utils.h"
+#include "profiler.h"
+#include "mem_stats.h"
 
 std::size_t cpp_getfilesize(std::ifstream& input) {
 
@@ -10,7 +12,9 @@ std::size_t cpp_getfilesize(std::ifstream& input) {
 
 }
 
-float* readSampleData_int16(std::ifstream& input, std::size_t* const num_samples) {
+float* readSampleData_int16(std::ifstream& input, std::size_t* const num_samples, Arena &arena) {
+
+		PROFILE_ZONE("readSampleData_int16");
 
         std::size_t filesize = cpp_getfilesize(input);
        
@@ -21,7 +25,7 @@ float* readSampleData_int16(std::ifstream& input, std::size_t* const num_samples
 		}
 
 		const std::size_t numsamples = (filesize-44)/2;
-		short *sampledata = new short[numsamples];
+		short *sampledata = MemStats::allocArray<short>(MEM_IO, numsamples);
 
 		WAVHEADERINFO info;
 		input.seekg(0, std::ios::beg);
@@ -31,17 +35,23 @@ float* readSampleData_int16(std::ifstream& input, std::size_t* const num_samples
 	
 		input.seekg(44, std::ios::beg); // perhaps redundant, but better to be sure
 
-        input.read((char*)sampledata, filesize-44);
+		{
+			PROFILE_ZONE("read");
+			input.read((char*)sampledata, filesize-44);
+		}
 
         static const float max = (float)(0x1 << 15);
-		__declspec(align(16)) float *samples = new float[numsamples];
+		float *samples = arena.allocArray<float>(MEM_CONVERT, numsamples);
 		
 		// this conversion can be done with SSE.
 		// - tested this, was slow as hell with SSE as well as with SSE4.
 		// Even without any kind of optimization the vanilla version seems to be a lot faster
 
-        for (unsigned int i = 0; i < numsamples; i++) 
-                samples[i] = ((float)(sampledata[i]) / max);
+		{
+			PROFILE_ZONE("convert");
+			for (unsigned int i = 0; i < numsamples; i++) 
+				samples[i] = ((float)(sampledata[i]) / max);
+		}
 		
 		if (info.numChannels == 2) {
 			samples = downMixStereoToMono(samples, numsamples);
@@ -53,48 +63,98 @@ float* readSampleData_int16(std::ifstream& input, std::size_t* const num_samples
                   << "# of samples: " << *num_samples << "\n";
 		
 
-		delete [] sampledata;
+		MemStats::release(sampledata);
 
         return samples;
 }
 
 float* downMixStereoToMono(float *stereodata, const std::size_t& num_samples) {
 
+	PROFILE_ZONE("downmix");
+
+	// done in place: mono sample i only depends on stereo samples 2i and 2i+1,
+	// which have been read by the time it's written.
+	float *monodata = stereodata;
 	const std::size_t num_monosamples = num_samples/2;
+	std::size_t i = 0;
 
 #ifdef _WIN32
 	
-	__declspec(align(16)) float *monodata = new float[num_monosamples];
 	// a great spot for some SSE (or even OpenCL) wizardry as well :P
 	__m128 a, b;
 	const __m128 half = _mm_set1_ps(0.5);	// fill whole register. mul is always faster than div 
 	
-	// find out how many full 16-byte cycles can be done
+	// 8 stereo samples in, 4 mono samples out per cycle
+	const std::size_t num_full_cycles = num_samples/8;
+
+	for (std::size_t c = 0; c < num_full_cycles; c++) {
+		a = _mm_load_ps((const float*)&stereodata[8*c]);	// the arena hands out 64-byte aligned blocks, see arena.h
+		b = _mm_load_ps((const float*)&stereodata[8*c + 4]);
+		__m128 d = _mm_mul_ps(_mm_hadd_ps(a,b), half);	// horizontal add
+		_mm_store_ps(&monodata[4*c], d);
+	}
+	i = 4*num_full_cycles;
 
-	// this probably expands to just one div instruction
-	const std::size_t f = 8;
-	const std::size_t num_full_cycles = num_samples/f;
-	const std::size_t num_left = num_full_cycles%f;
+#endif
 
-	int i = 0;
-	for (i = 0; i < num_full_cycles; i++) {
-		a = _mm_load_ps((const float*)&stereodata[8*i]);	// the stereodata should be 16-byte aligned: SEE readSampleData_int16 
-		b = _mm_load_ps((const float*)&stereodata[8*i + 4]);
-		__m128 c = _mm_mul_ps(_mm_hadd_ps(a,b), half);	// horizontal add
-		_mm_store_ps(&monodata[4*i], c);
+	for (; i < num_monosamples; i++) {
+		monodata[i] = 0.5*(stereodata[2*i]+stereodata[2*i+1]);
+	}
 
+	return monodata;
+
+}
+
+short* readSampleDataNative_int16(std::ifstream& input, std::size_t* const num_samples, Arena &arena) {
+
+	PROFILE_ZONE("readSampleDataNative_int16");
+
+	std::size_t filesize = cpp_getfilesize(input);
+
+	static const std::size_t FILE_MAX = (0x1 << 24);
+
+	if (filesize > FILE_MAX) {
+		filesize = FILE_MAX;
 	}
-	for (; i < num_full_cycles + num_left; i++) {
-		monodata[i] = 0.5*(stereodata[2*i]+stereodata[2*i+1]);
+
+	const std::size_t numsamples = (filesize-44)/2;
+
+	WAVHEADERINFO info;
+	input.seekg(0, std::ios::beg);
+	input.read((char*)&info, 44);
+
+	// straight into the resident store
+	short *samples = arena.allocArray<short>(MEM_IO, numsamples);
+
+	{
+		PROFILE_ZONE("read");
+		input.seekg(44, std::ios::beg);
+		input.read((char*)samples, filesize-44);
 	}
-	
-#elif __linux__
-	// stub.nyi.
-#endif
 
-	delete [] stereodata;
+	if (info.numChannels == 2) {
+		samples = downMixStereoToMono(samples, numsamples);
+		*num_samples = numsamples/2;
 
-	return monodata;
+	} else { *num_samples = numsamples; }
+
+	std::cout << "filesize: " << filesize << "\n"
+	          << "# of samples: " << *num_samples << " (int16)\n";
+
+	return samples;
+}
+
+short* downMixStereoToMono(short *stereodata, const std::size_t& num_samples) {
+
+	PROFILE_ZONE("downmix");
+
+	// in place as well; the sum is done in int so it can't overflow
+	const std::size_t num_monosamples = num_samples/2;
+	for (std::size_t i = 0; i < num_monosamples; i++) {
+		stereodata[i] = (short)(((int)stereodata[2*i] + (int)stereodata[2*i+1]) >> 1);
+	}
+
+	return stereodata;
 
 }
 
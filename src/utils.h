@@ -11,12 +11,18 @@
 #endif
 
 #include "definitions.h"
+#include "arena.h"
 
 inline std::size_t cpp_getfilesize(std::ifstream& input);
 
 char* readRawWAVBuffer(std::ifstream& input, std::size_t *bufsize);	// useless?
-float* readSampleData_int16(std::ifstream& input, std::size_t* const numsamples); 
+// the samples are allocated from the document arena
+float* readSampleData_int16(std::ifstream& input, std::size_t* const numsamples, Arena &arena); 
+// same, but the samples stay in the file's own int16, no conversion pass
+short* readSampleDataNative_int16(std::ifstream& input, std::size_t* const numsamples, Arena &arena);
+// in place, returns stereodata. expects it 16-byte aligned.
 float* downMixStereoToMono(float *stereodata, const std::size_t& num_samples);
+short* downMixStereoToMono(short *stereodata, const std::size_t& num_samples);
 
 WAVHEADERINFO readHeaderData(std::ifstream& input);
 
@@ -0,0 +1,108 @@
+#include "wav_source.h"
+
+#include <cstdio>
+#include <cstring>
+
+WavSource::WavSource() : pcm(NULL), frames(0) {
+	memset(&info, 0, sizeof(info));
+}
+
+bool WavSource::open(const std::string &filename) {
+
+	close();
+
+	if (!file.open(filename)) {
+		printf("Couldn't map file %s\n", filename.c_str());
+		return false;
+	}
+
+	if (file.size() < 44) {
+		printf("%s is too short to be a WAV file.\n", filename.c_str());
+		file.close();
+		return false;
+	}
+
+	// presuming a plain 44-byte header, signed 16-bit little endian, like the rest of the program
+	memcpy(&info, file.data(), 44);
+	if (info.numChannels != 1 && info.numChannels != 2) {
+		printf("%s: %d channels, only mono and stereo are supported.\n", filename.c_str(), (int)info.numChannels);
+		file.close();
+		return false;
+	}
+
+	pcm = (const short*)(file.data() + 44);
+	frames = (file.size() - 44)/(2*info.numChannels);
+
+	return true;
+
+}
+
+void WavSource::close() {
+
+	file.close();
+	pcm = NULL;
+	frames = 0;
+
+}
+
+std::size_t WavSource::read(std::size_t first, std::size_t count, short *out) const {
+
+	if (first >= frames) return 0;
+	if (count > frames - first) count = frames - first;
+
+	if (info.numChannels == 1) {
+		memcpy(out, pcm + first, count*sizeof(short));
+	}
+	else {
+		const short *in = pcm + 2*first;
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = (short)(((int)in[2*i] + (int)in[2*i+1]) >> 1);
+		}
+	}
+
+	return count;
+
+}
+
+std::size_t WavSource::read(std::size_t first, std::size_t count, float *out) const {
+
+	if (first >= frames) return 0;
+	if (count > frames - first) count = frames - first;
+
+	static const float scale = 1.0f/32768.0f;
+
+	if (info.numChannels == 1) {
+		const short *in = pcm + first;
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = in[i]*scale;
+		}
+	}
+	else {
+		const short *in = pcm + 2*first;
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = 0.5f*scale*((int)in[2*i] + (int)in[2*i+1]);
+		}
+	}
+
+	return count;
+
+}
+
+std::size_t WavSource::readPairs(std::size_t first, std::size_t count, short *out) const {
+
+	if (first >= frames) return 0;
+	if (count > frames - first) count = frames - first;
+
+	if (info.numChannels == 2) {
+		memcpy(out, pcm + 2*first, 2*count*sizeof(short));
+	}
+	else {
+		const short *in = pcm + first;
+		for (std::size_t i = 0; i < count; ++i) {
+			out[2*i] = out[2*i+1] = in[i];
+		}
+	}
+
+	return count;
+
+}
@@ -0,0 +1,48 @@
+#ifndef WAV_SOURCE_H
+#define WAV_SOURCE_H
+
+#include <string>
+
+#include "definitions.h"
+#include "mapped_file.h"
+
+// A 16-bit WAV file mapped into memory, read a range of (mono) samples at a
+// time. Nothing is read up front, so there's no size limit and the pages
+// of a long file only come in for the parts that actually get looked at.
+// Stereo is downmixed as it's read, except by readPairs.
+
+class WavSource {
+
+public:
+
+	WavSource();
+
+	bool open(const std::string &filename);
+	void close();
+
+	bool valid() const { return file.valid(); }
+	const WAVHEADERINFO &header() const { return info; }
+	std::size_t sampleCount() const { return frames; }
+
+	// mono samples [first, first+count), clamped to the end of the file;
+	// returns how many were written
+	std::size_t read(std::size_t first, std::size_t count, short *out) const;
+	std::size_t read(std::size_t first, std::size_t count, float *out) const;
+
+	// left/right pairs [first, first+count), interleaved, without the downmix
+	// (a mono file gives left = right); returns how many pairs were written
+	std::size_t readPairs(std::size_t first, std::size_t count, short *out) const;
+
+	// the samples right in the mapping for mono files, NULL otherwise
+	const short *direct() const { return info.numChannels == 1 ? pcm : NULL; }
+
+private:
+
+	MappedFile file;
+	WAVHEADERINFO info;
+	const short *pcm;
+	std::size_t frames;
+
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "wave_colors.h"
+#include "mem_stats.h"
+
+#include <cstdio>
+
+namespace {
+
+	GLuint program = 0;
+
+#ifdef WAVEPLOT_GL33
+
+	GLuint bands_TBOid = 0, bands_texture = 0;
+
+	const lod_pyramid *pyramid = NULL;
+	std::size_t level_offsets[LOD_MAX_LEVELS];
+	int finest_level = 0;	// the finer ones didn't fit in a buffer texture
+	float gain[3];
+
+	// texture unit 0 is the gradient
+	enum { UNIT_BANDS = 1 };
+
+	struct {
+		GLint bands, use_bands, band_gain, first_bin, bins_per_pixel, bands_offset, bands_count;
+	} loc;
+
+#endif
+
+}
+
+bool WaveColors::init(GLuint wave_program) {
+
+#ifdef WAVEPLOT_GL33
+
+	program = wave_program;
+	loc.bands = glGetUniformLocation(program, "bands");
+	loc.use_bands = glGetUniformLocation(program, "use_bands");
+	loc.band_gain = glGetUniformLocation(program, "band_gain");
+	loc.first_bin = glGetUniformLocation(program, "first_bin");
+	loc.bins_per_pixel = glGetUniformLocation(program, "bins_per_pixel");
+	loc.bands_offset = glGetUniformLocation(program, "bands_offset");
+	loc.bands_count = glGetUniformLocation(program, "bands_count");
+
+	if (loc.bands < 0 || loc.use_bands < 0) {
+		printf("WaveColors: the wave shader has no band uniforms, band colors are unavailable.\n");
+		program = 0;
+		return false;
+	}
+
+	return true;
+
+#else
+	(void)wave_program;
+	return false;
+#endif
+
+}
+
+void WaveColors::destroy() {
+
+	setPyramid(NULL);
+	program = 0;
+
+}
+
+void WaveColors::setPyramid(const lod_pyramid *lod) {
+
+#ifdef WAVEPLOT_GL33
+
+	if (bands_TBOid) {
+		MemStats::untrackBuffer(bands_TBOid);
+		glDeleteTextures(1, &bands_texture);
+		glDeleteBuffers(1, &bands_TBOid);
+		bands_TBOid = bands_texture = 0;
+	}
+
+	pyramid = lod;
+	if (!program || !lod || !lod->level_count) {
+		pyramid = NULL;
+		return;
+	}
+
+	// drop the finest levels until the rest fits into one buffer texture
+	GLint max_texels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+
+	std::size_t total = 0;
+	for (int l = 0; l < lod->level_count; ++l) {
+		total += lod->bin_count[l];
+	}
+	for (finest_level = 0; finest_level < lod->level_count - 1 && total > (std::size_t)max_texels; ++finest_level) {
+		total -= lod->bin_count[finest_level];
+	}
+
+	glGenBuffers(1, &bands_TBOid);
+	glBindBuffer(GL_TEXTURE_BUFFER, bands_TBOid);
+	glBufferData(GL_TEXTURE_BUFFER, total*sizeof(lod_bands), NULL, GL_STATIC_DRAW);
+
+	std::size_t offset = 0;
+	for (int l = finest_level; l < lod->level_count; ++l) {
+		level_offsets[l] = offset;
+		glBufferSubData(GL_TEXTURE_BUFFER, offset*sizeof(lod_bands), lod->bin_count[l]*sizeof(lod_bands), lod->bands[l]);
+		offset += lod->bin_count[l];
+	}
+	MemStats::trackBuffer(bands_TBOid, MEM_LOD, total*sizeof(lod_bands));
+
+	glGenTextures(1, &bands_texture);
+	glBindTexture(GL_TEXTURE_BUFFER, bands_texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA16, bands_TBOid);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// the top level is the whole file, in the texture's 0..1 units
+	const lod_bands &all = lod->bands[lod->level_count - 1][0];
+	const unsigned short whole[3] = { all.low, all.mid, all.high };
+	for (int b = 0; b < 3; ++b) {
+		gain[b] = 65535.0f/(whole[b] ? whole[b] : 1);
+	}
+
+#endif
+
+}
+
+void WaveColors::bind(double first_sample, double samples_per_pixel) {
+
+#ifdef WAVEPLOT_GL33
+
+	if (!pyramid) return;
+
+	// zoomed in past level 0 the bins are blended across pixels
+	int level = LOD::levelFor(*pyramid, samples_per_pixel);
+	if (level < finest_level) level = finest_level;
+
+	const double bin_size = (double)pyramid->samplesPerBin(level);
+
+	glActiveTexture(GL_TEXTURE0 + UNIT_BANDS);
+	glBindTexture(GL_TEXTURE_BUFFER, bands_texture);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform1i(loc.bands, UNIT_BANDS);
+	glUniform1i(loc.use_bands, 1);
+	glUniform4f(loc.band_gain, gain[0], gain[1], gain[2], 0.0f);
+	glUniform1f(loc.first_bin, (float)(first_sample/bin_size));
+	glUniform1f(loc.bins_per_pixel, (float)(samples_per_pixel/bin_size));
+	glUniform1i(loc.bands_offset, (GLint)level_offsets[level]);
+	glUniform1i(loc.bands_count, (GLint)pyramid->bin_count[level]);
+
+#else
+	(void)first_sample;
+	(void)samples_per_pixel;
+#endif
+
+}
+
+void WaveColors::unbind() {
+
+#ifdef WAVEPLOT_GL33
+
+	if (!pyramid) return;
+
+	// the program is shared with the text and the sliders
+	glUniform1i(loc.use_bands, 0);
+
+	glActiveTexture(GL_TEXTURE0 + UNIT_BANDS);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+#endif
+
+}
@@ -0,0 +1,33 @@
+#ifndef WAVE_COLORS_H
+#define WAVE_COLORS_H
+
+#include "gl_includes.h"
+#include "lod.h"
+
+// Tints the line mesh and the envelope by the LOD pyramid's band energies:
+// red for the low band, green for the middle, blue for the high one. All
+// levels' lod_bands go up into one RGBA16 buffer texture; the wave
+// fragment shader finds every pixel column's bin from gl_FragCoord.x and
+// blends the two nearest. Each band is scaled by the whole file's energy
+// in it first, so the colors show what's unusual for the file rather than
+// the bass that's everywhere.
+//
+// GL 3.3 only.
+
+namespace WaveColors {
+
+	// program is the wave program (vertex/fragment.shader.win)
+	bool init(GLuint program);
+	void destroy();
+
+	// NULL drops it
+	void setPyramid(const lod_pyramid *lod);
+
+	// with the wave program in use: tint columns [first_sample + x*samples_per_pixel, ...)
+	// of the framebuffer until unbind()
+	void bind(double first_sample, double samples_per_pixel);
+	void unbind();
+
+};
+
+#endif
@@ -0,0 +1,300 @@
+#include "wave_shader.h"
+#include "definitions.h"
+#include "shader.h"
+#include "timeline.h"
+#include "mem_stats.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstdio>
+
+#define BUFFER_OFFSET(i) (reinterpret_cast<void*>(i))
+
+namespace {
+
+	ShaderProgram *column_program = NULL, *coverage_program = NULL;
+	GLuint columns_texture = 0, columns_FBOid = 0;
+
+#ifdef WAVEPLOT_GL33
+
+	GLuint quad = 0;
+	GLuint lod_TBOid = 0, lod_texture = 0;
+
+	const lod_pyramid *pyramid = NULL;
+	std::size_t level_offsets[LOD_MAX_LEVELS];
+	int finest_level = 0;	// the finer ones didn't fit in a buffer texture
+
+	// texture units of the column pass
+	enum { UNIT_SAMPLES_0 = 1, UNIT_SAMPLES_1, UNIT_LOD };
+
+	struct {
+		GLint samples_0, samples_1, lod_bins, use_lod, first_sample, samples_per_column, count_0, count_1, lod_offset, lod_count;
+	} column_loc;
+
+	struct {
+		GLint columns, y_offset, y_scale, half_width;
+	} coverage_loc;
+
+	void bindQuad() {
+
+		glBindBuffer(GL_ARRAY_BUFFER, quad);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
+
+	}
+
+	void drawColumns(std::size_t begin, std::size_t end) {
+
+		glViewport((GLint)begin, 0, (GLsizei)(end - begin), 1);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+	}
+
+	void bindSamples(GLenum unit, GLuint texture) {
+
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+
+	}
+
+#endif
+
+}
+
+bool WaveShader::init(GLuint quad_VBOid, bool int16_samples) {
+
+#ifdef WAVEPLOT_GL33
+
+	quad = quad_VBOid;
+
+	column_program = new ShaderProgram("shaders/quad_passthrough.shader.win", "shaders/column_fragment.shader.win", "",
+									   int16_samples ? "#define SAMPLES_INT16\n" : "");
+	coverage_program = new ShaderProgram("shaders/quad_passthrough.shader.win", "shaders/coverage_fragment.shader.win", "");
+
+	if (!column_program->valid() || !coverage_program->valid()) {
+		printf("WaveShader: couldn't build the shaders, the shader renderer is unavailable.\n");
+		destroy();
+		return false;
+	}
+
+	const GLuint cp = column_program->programHandle();
+	column_loc.samples_0 = glGetUniformLocation(cp, "samples_0");
+	column_loc.samples_1 = glGetUniformLocation(cp, "samples_1");
+	column_loc.lod_bins = glGetUniformLocation(cp, "lod_bins");
+	column_loc.use_lod = glGetUniformLocation(cp, "use_lod");
+	column_loc.first_sample = glGetUniformLocation(cp, "first_sample");
+	column_loc.samples_per_column = glGetUniformLocation(cp, "samples_per_column");
+	column_loc.count_0 = glGetUniformLocation(cp, "count_0");
+	column_loc.count_1 = glGetUniformLocation(cp, "count_1");
+	column_loc.lod_offset = glGetUniformLocation(cp, "lod_offset");
+	column_loc.lod_count = glGetUniformLocation(cp, "lod_count");
+
+	const GLuint vp = coverage_program->programHandle();
+	coverage_loc.columns = glGetUniformLocation(vp, "columns");
+	coverage_loc.y_offset = glGetUniformLocation(vp, "y_offset");
+	coverage_loc.y_scale = glGetUniformLocation(vp, "y_scale");
+	coverage_loc.half_width = glGetUniformLocation(vp, "half_width");
+
+	// x = min, y = max of every column, in [-1, 1]
+	glGenTextures(1, &columns_texture);
+	glBindTexture(GL_TEXTURE_2D, columns_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, WIN_W, 1, 0, GL_RG, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	MemStats::trackTexture(columns_texture, MEM_OTHER, WIN_W*2*sizeof(float));
+
+	glGenFramebuffers(1, &columns_FBOid);
+	glBindFramebuffer(GL_FRAMEBUFFER, columns_FBOid);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, columns_texture, 0);
+
+	GLenum m[1] = { GL_COLOR_ATTACHMENT0 };
+	glDrawBuffers(1, m);
+
+	const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (!complete) {
+		printf("WaveShader: RG32F render target unsupported, the shader renderer is unavailable.\n");
+		destroy();
+		return false;
+	}
+
+	return true;
+
+#else
+	return false;
+#endif
+
+}
+
+void WaveShader::destroy() {
+
+	setPyramid(NULL);
+
+	if (columns_FBOid) {
+		glDeleteFramebuffers(1, &columns_FBOid);
+		columns_FBOid = 0;
+	}
+	if (columns_texture) {
+		MemStats::untrackTexture(columns_texture);
+		glDeleteTextures(1, &columns_texture);
+		columns_texture = 0;
+	}
+
+	delete column_program;
+	delete coverage_program;
+	column_program = coverage_program = NULL;
+
+}
+
+void WaveShader::setPyramid(const lod_pyramid *lod) {
+
+#ifdef WAVEPLOT_GL33
+
+	if (lod_TBOid) {
+		MemStats::untrackBuffer(lod_TBOid);
+		glDeleteTextures(1, &lod_texture);
+		glDeleteBuffers(1, &lod_TBOid);
+		lod_TBOid = lod_texture = 0;
+	}
+
+	pyramid = lod;
+	if (!lod || !lod->level_count) return;
+
+	// drop the finest levels until the rest fits into one buffer texture
+	GLint max_texels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+
+	std::size_t total = 0;
+	for (int l = 0; l < lod->level_count; ++l) {
+		total += lod->bin_count[l];
+	}
+	for (finest_level = 0; finest_level < lod->level_count - 1 && total > (std::size_t)max_texels; ++finest_level) {
+		total -= lod->bin_count[finest_level];
+	}
+
+	glGenBuffers(1, &lod_TBOid);
+	glBindBuffer(GL_TEXTURE_BUFFER, lod_TBOid);
+	glBufferData(GL_TEXTURE_BUFFER, total*sizeof(lod_bin), NULL, GL_STATIC_DRAW);
+
+	std::size_t offset = 0;
+	for (int l = finest_level; l < lod->level_count; ++l) {
+		level_offsets[l] = offset;
+		glBufferSubData(GL_TEXTURE_BUFFER, offset*sizeof(lod_bin), lod->bin_count[l]*sizeof(lod_bin), lod->levels[l]);
+		offset += lod->bin_count[l];
+	}
+	MemStats::trackBuffer(lod_TBOid, MEM_LOD, total*sizeof(lod_bin));
+
+	glGenTextures(1, &lod_texture);
+	glBindTexture(GL_TEXTURE_BUFFER, lod_texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA16I, lod_TBOid);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+#endif
+
+}
+
+void WaveShader::draw(const wave_shader_view &v, GLuint framebuffer) {
+
+#ifdef WAVEPLOT_GL33
+
+	if (!column_program || !pyramid) return;
+
+	PROFILE_ZONE("wave shader");
+
+	const double first = v.first_sample, spc = v.samples_per_column;
+
+	// only the columns that have samples under them
+	const double begin_column = first < 0 ? ceil(-first/spc) : 0;
+	const double end_column = ceil((pyramid->num_samples - first)/spc);
+	const std::size_t c0 = begin_column < WIN_W ? (std::size_t)begin_column : WIN_W;
+	const std::size_t c1 = end_column < c0 ? c0 : (end_column < WIN_W ? (std::size_t)end_column : WIN_W);
+
+	// pass one, the column spans. empty columns are left min > max.
+	glDisable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, columns_FBOid);
+	glViewport(0, 0, WIN_W, 1);
+	glClearColor(1.0, -1.0, 0.0, 0.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glClearColor(1.0, 1.0, 1.0, 1.0);
+
+	bindQuad();
+	glUseProgram(column_program->programHandle());
+	glUniform1i(column_loc.samples_0, UNIT_SAMPLES_0);
+	glUniform1i(column_loc.samples_1, UNIT_SAMPLES_1);
+	glUniform1i(column_loc.lod_bins, UNIT_LOD);
+
+	int level = LOD::levelFor(*pyramid, spc);
+	if (level >= 0 && level < finest_level) level = finest_level;
+
+	if (c1 > c0 && level >= 0) {
+
+		// in bins of the level rather than samples
+		const double bin_size = (double)pyramid->samplesPerBin(level);
+		bindSamples(UNIT_LOD, lod_texture);
+		glUniform1i(column_loc.use_lod, 1);
+		glUniform1f(column_loc.first_sample, (float)(first/bin_size));
+		glUniform1f(column_loc.samples_per_column, (float)(spc/bin_size));
+		glUniform1i(column_loc.lod_offset, (GLint)level_offsets[level]);
+		glUniform1i(column_loc.lod_count, (GLint)pyramid->bin_count[level]);
+		drawColumns(c0, c1);
+
+	}
+	else if (c1 > c0) {
+
+		glUniform1i(column_loc.use_lod, 0);
+		glUniform1f(column_loc.samples_per_column, (float)spc);
+
+		const std::size_t lo = Timeline::chunkFor(first + c0*spc), hi = Timeline::chunkFor(first + c1*spc);
+
+		for (std::size_t i = lo; i < Timeline::chunkCount() && i <= hi; ++i) {
+
+			const timeline_chunk &c = Timeline::chunk(i);
+			if (!c.resident) continue;
+
+			// the columns whose left edge falls into this chunk
+			const double chunk_begin = (double)(i*TIMELINE_CHUNK_SAMPLES);
+			const double a = ceil((chunk_begin - first)/spc), b = ceil((chunk_begin + c.count - first)/spc);
+			const std::size_t ca = a > c0 ? (std::size_t)a : c0;
+			const std::size_t cb = b < c1 ? (std::size_t)b : c1;
+			if (ca >= cb) continue;
+
+			// the next chunk for columns (and interpolation) running over the end
+			const bool next = i + 1 < Timeline::chunkCount() && Timeline::chunk(i + 1).resident;
+
+			bindSamples(UNIT_SAMPLES_0, c.textureid);
+			bindSamples(UNIT_SAMPLES_1, next ? Timeline::chunk(i + 1).textureid : c.textureid);
+			glUniform1f(column_loc.first_sample, (float)(first - chunk_begin));
+			glUniform1i(column_loc.count_0, (GLint)c.count);
+			glUniform1i(column_loc.count_1, next ? (GLint)Timeline::chunk(i + 1).count : 0);
+			drawColumns(ca, cb);
+		}
+
+	}
+
+	bindSamples(UNIT_SAMPLES_0, 0);
+	bindSamples(UNIT_SAMPLES_1, 0);
+	bindSamples(UNIT_LOD, 0);
+
+	// pass two, coverage
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, WIN_W, WIN_H);
+	glEnable(GL_BLEND);
+
+	glUseProgram(coverage_program->programHandle());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, columns_texture);
+	glUniform1i(coverage_loc.columns, 0);
+	glUniform1f(coverage_loc.y_offset, v.y_offset);
+	glUniform1f(coverage_loc.y_scale, v.y_scale);
+	glUniform1f(coverage_loc.half_width, v.half_width);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+
+	glUseProgram(0);
+
+#endif
+
+}
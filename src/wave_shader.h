@@ -0,0 +1,40 @@
+#ifndef WAVE_SHADER_H
+#define WAVE_SHADER_H
+
+#include "gl_includes.h"
+#include "lod.h"
+
+// The waveform drawn without any geometry of its own, in two fullscreen
+// quad passes. The first reduces the visible range to a min/max per pixel
+// column into a WIN_W x 1 float texture, reading the samples straight from
+// the timeline chunks' buffer textures (or the LOD pyramid, uploaded as one
+// buffer texture, once a column spans a level 0 bin). The second computes
+// every pixel's coverage of its column's span, antialiased along y. Zoom
+// and pan are only ever uniforms; the vertex count is 6 per pass.
+//
+// GL 3.3 only (buffer textures); the timeline has to be opened without
+// meshes for this one.
+
+struct wave_shader_view {
+	double first_sample;		// under the left edge of the window
+	double samples_per_column;
+	float y_offset, y_scale;	// window y (from the bottom) = y_offset + y_scale*sample, sample in [-1, 1]
+	float half_width;			// of the line, in pixels
+};
+
+namespace WaveShader {
+
+	// quad_VBOid holds the fullscreen quad, two triangles in NDC
+	bool init(GLuint quad_VBOid, bool int16_samples);
+	void destroy();
+
+	// min/max of every level, as RGBA16I texels straight from the lod_bins (the rms takes up BA).
+	// NULL drops it.
+	void setPyramid(const lod_pyramid *lod);
+
+	// into the currently bound framebuffer, which is given back bound
+	void draw(const wave_shader_view &v, GLuint framebuffer);
+
+};
+
+#endif
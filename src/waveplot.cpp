@@ -8,7 +8,9 @@
 
 #include "gl_includes.h"
 
-#ifdef __linux__
+#ifdef WAVEPLOT_HEADLESS
+#include "headless.h"
+#elif __linux__
 #include <SDL/SDL.h>
 #endif
 
@@ -23,6 +25,7 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 
 #include "utils.h"
 #include "definitions.h"
@@ -31,6 +34,30 @@
 #include "slider.h"
 #include "lin_alg.h"
 #include "timer.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+#include "bake.h"
+#include "input_trace.h"
+#include "gl_stats.h"
+#include "mem_stats.h"
+#include "lod.h"
+#include "lod_cache.h"
+#include "wav_source.h"
+#include "timeline.h"
+#include "envelope.h"
+#include "wave_shader.h"
+#include "tile_cache.h"
+#include "post_chain.h"
+#include "phosphor.h"
+#include "goniometer.h"
+#include "wave_colors.h"
+#include "range_stats.h"
+#include "clip_index.h"
+#include "loudness.h"
+#include "onsets.h"
+#include "align.h"
+#include "spectrogram.h"
+#include "job_pool.h"
 #include "texture.h"
 
 #define BUFFER_OFFSET(i) (reinterpret_cast<void*>(i))
@@ -78,26 +105,119 @@ static const vertex fullscreen_quad_vertices[6] = {
 
 static std::string input_filename("resources/asdfmono.wav");
 
-extern const vertex sliders[];
+// per-document host memory (the LOD pyramid, staging), reset when the file is closed
+static Arena document_arena(16*1024*1024, true);
 
-static float half_WIN_H = (float) WIN_H / 2.0;
+// the open file, mapped; the timeline pages chunks of it into GL buffers.
+// unless --float-samples is given the samples stay in the file's own int16,
+// on the GPU too (as buffer textures), at half the size of floats.
+static WavSource document_wav;
+static bool resident_samples_int16 = true;
+static std::size_t timeline_budget = 256*1024*1024;	// --budget <MiB>
 
-static float linewidth = 1.8; 
-static float half_linewidth = linewidth/2.0;
+// overview of the whole file, built on first open and cached on disk after that
+static lod_pyramid document_lod;
+static MappedFile document_lod_mapping;
+
+extern const vertex sliders[];
 
 static Texture gradient_texture, font_texture, slider_texture, solid_color_texture;
 
 static std::vector<line> lines;
 
-static GLuint uniform_texture1_loc, uniform_projection_loc, uniform_modelview_loc;
+static GLuint uniform_texture1_loc, uniform_projection_loc, uniform_modelview_loc, uniform_base_color_loc;
 static GLuint uniform_texture1_loc_fullscreen_quad;
-static bufferObject waveData, sliderData, waveVertexArray, fullscreen_quadData;
+static bufferObject waveData, sliderData, waveVertexArray, fullscreen_quadData, envelopeData;
+
+// the envelope is reduced and baked into these every frame it's shown
+static short envelope_min[WIN_W], envelope_max[WIN_W];
+static vertex envelope_vertices[2*WIN_W];
 static mat4 wave_projection, wave_modelview;
 static int wave_polygonMode = GL_FILL;
 static bool wave_solidColorTextureToggle = false;
-static const double dx = 1.0/4.0;
+
+// the mesh (line mesh, or the envelope when zoomed out), the two fullscreen passes of WaveShader,
+// or the visible stretch folded over at its trigger points with persistence (Phosphor).
+// 'r' cycles through them, --render shader|phosphor starts with one of the latter.
+enum { RENDER_MESH, RENDER_SHADER, RENDER_PHOSPHOR, RENDER_MODE_COUNT };
+static int render_mode = RENDER_MESH;
+static bool wave_shader_available = false;
+static bool phosphor_available = false;
+
+// the stereo X/Y panel on the right, and the phase correlation under it. 'g' toggles, --goniometer starts with it.
+static bool goniometer_enabled = false;
+static bool goniometer_available = false;
+static const int goniometer_x = WIN_W - GONIOMETER_SIZE - 15;
+static const int goniometer_y = (WIN_H - GONIOMETER_SIZE)/2;	// from the bottom
+
+// the STFT of the visible range as a band along the bottom of the window. 's' toggles,
+// --spectrogram starts with it, 'f' steps through the FFT sizes.
+static bool spectrogram_enabled = false;
+static bool spectrogram_available = false;
+static const int spectrogram_height = 140;
+
+// the mesh and the envelope tinted by the LOD's band energies. 'b' toggles, --band-colors starts with it.
+static bool band_colors_enabled = false;
+static bool band_colors_available = false;
+
+// R128 loudness is measured on the job pool as each file is opened, and printed once it's in
+static bool loudness_reported = false;
+
+// and the onsets are found the same way, drawn as ticks along the top. '[' and ']' jump between them.
+static bool onsets_reported = false;
+static const int onset_marker_height = 24;	// pixels, for the strongest
+
+// a second file to line the open one up with ('w', or --compare), with a pyramid of its own. Align finds
+// the lag on the job pool; 'd' goes from drawing it over the wave, to the difference instead of the wave, to neither.
+static WavSource reference_wav;
+static Arena reference_arena(16*1024*1024, true);
+static lod_pyramid reference_lod;
+static MappedFile reference_lod_mapping;
+static bool alignment_reported = false;
+
+enum { COMPARE_OVERLAY, COMPARE_DIFFERENCE, COMPARE_OFF, COMPARE_MODE_COUNT };
+static int compare_mode = COMPARE_OVERLAY;
+static const float reference_color[3] = { 0.15f, 0.4f, 0.85f };
+static const float difference_color[3] = { 0.7f, 0.15f, 0.1f };
+
+static const char *compareModeName(int mode) {
+	static const char *names[COMPARE_MODE_COUNT] = { "overlay", "difference", "off" };
+	return names[mode];
+}
+
+static const char *renderModeName(int mode) {
+	static const char *names[RENDER_MODE_COUNT] = { "mesh", "shader", "phosphor" };
+	return names[mode];
+}
+
+static int parseRenderMode(const char *name) {
+	for (int m = 0; m < RENDER_MODE_COUNT; ++m) {
+		if (!strcmp(name, renderModeName(m))) return m;
+	}
+	return RENDER_MESH;
+}
+
+// while the zoom stays put, the waveform is composited from cached window-sized tiles.
+// 'c' toggles, --no-tile-cache starts without.
+static bool tile_cache_enabled = true;
+static const std::size_t tile_cache_tiles = 8;
+
+// the plain copy to the window that draw() always used to end with. it's an identity
+// pass, so PostChain drops it unless --no-elide asks for the old round trip.
+static int resolve_pass = -1;
+static bool post_elision = true;
 static const double frame_interval = 1.0/60.0;	// actually, handled by hardware vsync on my machine
 
+static const int HUD_GPU_STRINGS_BEGIN = 3;	// dynamic wpstring index of the first GPU pass line
+static const int HUD_TILE_STRING = HUD_GPU_STRINGS_BEGIN + GPU_PASS_COUNT;
+static const int HUD_CORRELATION_STRING = HUD_TILE_STRING + 1;
+static const int HUD_SPECTROGRAM_STRING = HUD_CORRELATION_STRING + 1;
+static const int HUD_RANGE_STRING = HUD_SPECTROGRAM_STRING + 1;
+static const int HUD_CLIP_STRING = HUD_RANGE_STRING + 1;
+static const int HUD_LOUDNESS_STRING = HUD_CLIP_STRING + 1;
+static const int HUD_ALIGN_STRING = HUD_LOUDNESS_STRING + 1;
+static const int hud_refresh_interval = 30;	// frames
+
 static ShaderProgram *passthrough_shader_program = NULL;
 static ShaderProgram *fullscreen_quad_shader = NULL;
 
@@ -108,36 +228,71 @@ namespace Text {
 
 namespace View {
 	static bool mbuttondown = false;
-	static LPPOINT mouse_pos0 = new POINT;
-	static LPPOINT prev_mouse_pos = new POINT;
-	static vec4 wave_pos0;
+#ifdef _WIN32
 	static RECT windowRect;
+#endif
+	static int mouse_x, mouse_y;	// latest cursor position (screen coordinates), fed by handleInput
+	static int prev_mouse_x, prev_mouse_y;
 	static float dx, dy, prev_dx, prev_dy;
 	
 	static float zoom = 0.0;
 	static const float zoom_step = 10.0, zoom_min = -64*zoom_step, zoom_max = 24*zoom_step;
+	// past zoom_max the view keeps zooming out (in factors) until the whole file fits,
+	// but the vertical scale stays where it was at zoom_max
+	static const float zoom_factor = 1.5;
+	static float zoom_limit = zoom_max;
 	
-	static vec4 wave_position, // constructed as zero vectors.
-			wave_view_velocity,// used to give the notion of inertia to the motion of the camera
+	// the horizontal camera position is kept in double: as a float it can't tell
+	// adjacent samples apart a few million samples in. only the offset to the
+	// chunk being drawn ever goes to the GPU (see drawWave).
+	static double wave_x;
+	static float wave_y;
+
+	static vec4 wave_view_velocity,// used to give the notion of inertia to the motion of the camera
 			wave_view_velocity_sample1;
 	
 	static Quaternion rot;	// initialized as the identity quaternion (0, 0, 0, 1)
 
 	void zoomIn();
 	void zoomOut();
+	void pan(const vec4 &d);
+
+	inline float zoomY() { return (zoom < zoom_max ? zoom : zoom_max)*aspect_ratio_recip; }
+	inline float panScale() {
+		// with the exp term, the sensitivity scales with zoom level
+		return zoom <= zoom_max ? exp(zoom/290.0) : exp(zoom_max/290.0)*(WIN_W + 2*zoom)/(WIN_W + 2*zoom_max);
+	}
 }
 
 void View::zoomIn() {
 
+	if (View::zoom > View::zoom_max) {
+		const float z = ((WIN_W + 2*View::zoom)/View::zoom_factor - WIN_W)/2;
+		View::zoom = z < View::zoom_max ? View::zoom_max : z;
+		return;
+	}
+
 	View::zoom = View::zoom <= View::zoom_min ? View::zoom_min : View::zoom - View::zoom_step;
 
 }
 
 void View::zoomOut() {
-	View::zoom = View::zoom >= View::zoom_max ? View::zoom_max : View::zoom + View::zoom_step;
+
+	if (View::zoom >= View::zoom_max) {
+		const float z = ((WIN_W + 2*View::zoom)*View::zoom_factor - WIN_W)/2;
+		View::zoom = z > View::zoom_limit ? View::zoom_limit : z;
+		return;
+	}
+
+	View::zoom += View::zoom_step;
 }
 
-static GLuint FBOid, FBOtextureid;	// for post-processing
+void View::pan(const vec4 &d) {
+	View::wave_x += d(0);
+	View::wave_y += d(1);
+}
+
+static GLuint default_framebuffer = 0;	// the window's; the headless build swaps in an offscreen one
 
 
 //bool texture::make_texture(const std::string& filename, GLint filter_flag) {
@@ -228,318 +383,67 @@ void generateWaveVertexArray(triangle* triangles, std::size_t samplecount) {
 	glGenBuffers(1, &waveVertexArray.VBOid);
 	glBindBuffer(GL_ARRAY_BUFFER, waveVertexArray.VBOid);
 	glBufferData(GL_ARRAY_BUFFER, (trianglecount)*sizeof(triangle), triangles, GL_STATIC_DRAW);
+	MemStats::trackBuffer(waveVertexArray.VBOid, MEM_BAKE, (trianglecount)*sizeof(triangle));
 
 	waveVertexArray.IBOid = -1;	// not used
 
 }
 
-GLuint generateWaveVertexBufferObject(vertex* vertices) {
-
-	const std::size_t vertex_count = (2*BUFSIZE-2);
-
-	GLuint ret;
-	glGenBuffers(1, &ret);
-	glBindBuffer(GL_ARRAY_BUFFER, ret);
-	glBufferData(GL_ARRAY_BUFFER, (vertex_count)*sizeof(vertex), (const GLvoid*)vertices, GL_STATIC_DRAW);
-
-	return ret;
-
-}
-
 GLuint generateGlobalIndexBuffer(GLuint *indices) {
 
+	PROFILE_ZONE("upload indices");
+
 	GLuint ret;
 	glGenBuffers(1, &ret);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ret);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, BUFSIZE_MAX*sizeof(GLuint), (const GLvoid*)indices, GL_STATIC_DRAW);
+	MemStats::trackBuffer(ret, MEM_INDEX, BUFSIZE_MAX*sizeof(GLuint));
 
 	return ret;
 
 }
 
-void destroyCurrentWaveVertexBuffer() {
+// the ones with jobs on the pool that may still be reading the open file's
+// mapping; each waits for its own before letting go
+static void dropDocumentJobs() {
 
-	glDeleteBuffers(1, &waveData.VBOid);
-	// the vertex buffer has a static IBO, allocated to BUFSIZE_MAX
-	//glDeleteBuffers(1, &waveVertexArray.IBOid);
+	Spectrogram::setSource(NULL);
+	Loudness::setSource(NULL);
+	Onsets::setSource(NULL);
+	Align::setSources(NULL, NULL);
 
 }
 
-// The drawback of this algorithm is that some of the
-// really "tight turns" in the waveform produce unwanted artifacts.
-
-triangle *bakeWaveVertexArrayUsingLineIntersections(float* samples, const std::size_t& samplecount) {
-	
-	const std::size_t triangle_count = 2*samplecount-1;
-	triangle* triangles = new triangle[triangle_count];
-
-	static const float h = half_linewidth;
-
-	float x1 = 0.0;
-	float y1 = half_WIN_H*samples[0] + half_WIN_H;
-
-	float x2 = x1 + dx;
-	float y2 = half_WIN_H*samples[1] + half_WIN_H;
-
-	float x3 = x2 + dx;
-	float y3 = half_WIN_H*samples[2] + half_WIN_H;
-
-	float k1 = (y2-y1)/dx;
-	float alpha_1 = atan(k1);
-	
-	float k2 = (y3-y2)/dx;
-	float alpha_2 = atan(k2);
-
-	float px_2 = h*sin(alpha_1);
-	float py_2 = h*cos(alpha_1);
-
-	triangles[0].v1 = vertex(x2+px_2, WIN_H - (y2-py_2), 1.0, 0.0);
-	triangles[0].v2 = vertex(x2-px_2, WIN_H - (y2+py_2), 1.0, 1.0);
-	triangles[0].v3 = vertex(x1, y1, 0.0, 0.5);
-	
-	int i = 1, j = 1;
-
-	float x2_c, y2_c;
-	float dk;
-	float px_3, py_3;
-	float res_x2_1, res_y2_1, res_x2_2, res_y2_2;
-
-	while (i < triangle_count - 1) 
-	{
-		//    y - y0 = k(x - x0)
-		// =>      y = k(x - x0) + y0
-
-		x1 = x2; y1 = y2;
-		x2 = x3; y2 = y3;
-		x3 = x2+dx;
-		y3 = half_WIN_H*samples[j+2] + half_WIN_H;
-
-		k1 = (y2-y1)/dx;	// dx = constant
-		alpha_1 = atan(k1);	// can be copied from previous result
-							// also, this temporary isn't necessary
-	
-		k2 = (y3-y2)/dx;
-		alpha_2 = atan(k2);
-
-		px_2 = h*sin(alpha_1);
-		py_2 = h*cos(alpha_1);
-		
-		px_3 = h*sin(alpha_2);
-		py_3 = h*cos(alpha_2);
-
-		dk = k1-k2;
-
-		if (fabs(dk) < 0.3) {
-
-			res_x2_1 = x2 - px_2;
-			res_y2_1 = y2 + py_2;
-
-			res_x2_2 = x2 + px_2;
-			res_y2_2 = y2 - py_2;
-
-		}
-
-		else {
-			
-			x2_c = (x2 - px_2);
-			y2_c = (y2 + py_2);
-			
-			res_x2_1 = (k1*x2_c - y2_c - k2*(x3-px_3) + (y3+py_3))/dk;
-			res_y2_1 = k1*(res_x2_1 - x2_c) + y2_c;
-		
-			x2_c = (x2 + px_2);
-			y2_c = (y2 - py_2);
-
-			res_x2_2 = (k1*x2_c - y2_c - k2*(x3+px_3) + (y3-py_3))/dk;
-			res_y2_2 = k1*(res_x2_2 - x2_c) + y2_c;
-		
-		}
-		
-		// invert computed y values
-
-		res_y2_1 = (WIN_H - res_y2_1);
-		res_y2_2 = (WIN_H - res_y2_2);	
-	
-		triangles[i].v1 = triangles[i-1].v2;
-		triangles[i].v2 = triangles[i-1].v1;
-		triangles[i].v3 = vertex(res_x2_1, res_y2_1, 1.0, 1.0);
-
-		triangles[i+1].v1 = vertex(res_x2_2, res_y2_2, 1.0, 0.0);
-		triangles[i+1].v2 = triangles[i].v3;
-		triangles[i+1].v3 = triangles[i].v2;
-		
-		++j;
-		i += 2;
-
-	}
-
-	triangles[triangle_count-1].v1 = triangles[triangle_count-2].v2;	
-	triangles[triangle_count-1].v2 = triangles[triangle_count-2].v1;	
-	triangles[triangle_count-1].v3 = vertex(triangles[triangle_count-2].v1.x()+dx, half_WIN_H*samples[samplecount-1] + half_WIN_H, 1.0, 0.5);
-
-	return triangles;
-}
-
-
-vertex* bakeWaveVertexBufferUsingLineIntersections(const float* samples, const std::size_t& samplecount) {
-	
-	const std::size_t vertex_count = 2*samplecount-2;
-	vertex* vertices = new vertex[vertex_count];
-	static const float h = half_linewidth;
-
-	float x1 = 0.0;
-	float y1 = half_WIN_H*samples[0] + half_WIN_H;
-
-	float x2 = x1 + dx;
-	float y2 = half_WIN_H*samples[1] + half_WIN_H;
-
-	float x3 = x2 + dx;
-	float y3 = half_WIN_H*samples[2] + half_WIN_H;
-
-	float k1 = (y2-y1)/dx;
-	float alpha_1 = atan(k1);
-	
-	float k2 = (y3-y2)/dx;
-	float alpha_2 = atan(k2);
-
-	float px_2 = h*sin(alpha_2);
-	float py_2 = h*cos(alpha_2);
-
-	// special case
-	vertices[0] = vertex(x1, WIN_H - y1, 0.0, 0.5);
-	vertices[2] = vertex(x2+px_2, WIN_H - (y2-py_2), 0.0, 0.0);
-	vertices[1] = vertex(x2-px_2, WIN_H - (y2+py_2), 0.0, 1.0);
-		
-	int i = 3, j = 3;
-	
-	float alpha_3 = atan(((half_WIN_H*samples[3] + half_WIN_H)-y3)/dx);
-	float x2_c, y2_c;
-	float dk;
-	float px_3 = h*sin(alpha_3), py_3 = h*cos(alpha_3);
-	float res_x2_1, res_y2_1, res_x2_2, res_y2_2;
-
-	while (i < vertex_count - 1) 
-	{
-		//    y - y0 = k(x - x0)
-		// =>      y = k(x - x0) + y0
-
-		x1 = x2; y1 = y2;
-		x2 = x3; y2 = y3;
-		x3 = x2+dx;
-		y3 = half_WIN_H*samples[j] + half_WIN_H;
-
-		//k1 = (y2-y1)/dx;	// dx = constant
-		k1 = k2;
-		alpha_1 = alpha_2;	// can be copied from previous result
-							// also, this temporary isn't necessary
-	
-		k2 = (y3-y2)/dx;
-		alpha_2 = atan(k2);
-
-		//px_2 = h*sin(alpha_1);
-		//py_2 = h*cos(alpha_1);
-		
-		px_2 = px_3;
-		py_2 = py_3;
-
-		px_3 = h*sin(alpha_2);
-		py_3 = h*cos(alpha_2);
-
-		dk = k1-k2;
-
-		if (fabs(dk) < 0.3) {
-
-			res_x2_1 = x2 - px_2;
-			res_y2_1 = y2 + py_2;
-
-			res_x2_2 = x2 + px_2;
-			res_y2_2 = y2 - py_2;
-
-		}
-
-		else {
-			
-			// calculate line intersections
-			
-			//    y - y0 = k(x - x0)
-			// =>      y = k(x - x0) + y0
-			
-			//	  set y1 = y2 
-			// => k1(x - x1) + y01 = k2(x - x2) + y02
-			//
-			// solving for x yields:
-			// x = (k1x1 - y01 - k2x2 + y02)/(k1 - k2).
-			// then solve for y.
-
-			x2_c = (x2 - px_2);
-			y2_c = (y2 + py_2);
-			
-			res_x2_1 = (k1*x2_c - y2_c - k2*(x3-px_3) + (y3+py_3))/dk;
-			res_y2_1 = k1*(res_x2_1 - x2_c) + y2_c;
-		
-			x2_c = (x2 + px_2);
-			y2_c = (y2 - py_2);
-
-			res_x2_2 = (k1*x2_c - y2_c - k2*(x3+px_3) + (y3-py_3))/dk;
-			res_y2_2 = k1*(res_x2_2 - x2_c) + y2_c;
-		
-		}
-		
-		// invert computed y values
-
-		res_y2_1 = (WIN_H - res_y2_1);
-		res_y2_2 = (WIN_H - res_y2_2);	
-	
-		vertices[i] = vertex(res_x2_1, res_y2_1, 1.0, 1.0); 
-		vertices[i+1] = vertex(res_x2_2, res_y2_2, 1.0, 0.0);
-		
-		
-		++j;
-		i += 2;
-
-	}
-	// these are still bugged
-	vertices[vertex_count-2] = vertex(30000, 0, 0, 0);
-	vertices[vertex_count-1] = vertex(vertices[vertex_count-2].x()+dx, half_WIN_H*samples[samplecount-1] + half_WIN_H, 1.0, 0.5);
+void destroyCurrentWaveVertexBuffer() {
 
-	return vertices;
+	Timeline::close();
+	WaveShader::setPyramid(NULL);
+	WaveColors::setPyramid(NULL);
+	ClipIndex::clear();
+	Phosphor::setSource(NULL);
+	Goniometer::setSource(NULL);
+	dropDocumentJobs();
+	Envelope::releaseStaging();
+	document_wav.close();
+	document_lod = lod_pyramid();
+	document_lod_mapping.close();
+	document_arena.reset();
+	// the chunks share a static IBO, allocated to BUFSIZE_MAX
+	//glDeleteBuffers(1, &waveVertexArray.IBOid);
 
 }
 
+// the Texture class doesn't keep its dimensions around, so ask GL.
+// everything under textures/ is loaded as RGBA8.
+static void trackLoadedTexture(Texture &t) {
 
-GLuint *generateIndexBufferWithSharedVertices() {
-
-	// just use BUFSIZE_MAX :D
-	GLuint *indexBuffer = new GLuint[BUFSIZE_MAX];
-
-	indexBuffer[0] = 0;
-	indexBuffer[1] = 2;
-	indexBuffer[2] = 1;
-
-	int i = 3, j = 1;
-
-	while (i < BUFSIZE_MAX - 6) {
+	GLint w = 0, h = 0;
+	glBindTexture(GL_TEXTURE_2D, t.getId());
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+	glBindTexture(GL_TEXTURE_2D, 0);
 
-		// 1, 2, 3, 4, 3, 2
-
-		indexBuffer[i] = j;
-		indexBuffer[i+1] = j+1;
-		indexBuffer[i+2] = j+2;
-
-		indexBuffer[i+3] = j+3;
-		indexBuffer[i+4] = j+2;
-		indexBuffer[i+5] = j+1;
-
-		i += 6;
-		j += 2;
-
-	}
-	// this is probably wrong
-	indexBuffer[i] = j;
-	indexBuffer[i+1] = j+1;
-	indexBuffer[i+2] = j+2;
-
-	return indexBuffer;
+	MemStats::trackTexture(t.getId(), MEM_TEXTURES, (std::size_t)w*h*4);
 
 }
 
@@ -548,9 +452,11 @@ bool InitGL()
 	
 	GLenum err;
 
+#ifdef _WIN32
 	if (!load_GL_extensions()) {
 		return 0;
 	}
+#endif
 	
 	glClearColor(1.0, 1.0, 1.0, 1.0);
 	glDisable(GL_DEPTH_TEST);
@@ -585,6 +491,11 @@ bool InitGL()
 		return false;
 	}
 
+	trackLoadedTexture(gradient_texture);
+	trackLoadedTexture(font_texture);
+	trackLoadedTexture(slider_texture);
+	trackLoadedTexture(solid_color_texture);
+
 #ifdef _WIN32
 	const char* vshadername = "shaders/vertex.shader.win";
 	const char* fshadername = "shaders/fragment.shader.win";
@@ -612,7 +523,7 @@ bool InitGL()
 	Text::modelview_matrix = mat4::identity();
 
 
-#ifdef _WIN32
+#ifdef WAVEPLOT_GL33
 
 	glBindAttribLocation(passthrough_shader_program->programHandle(), 0, "in_position");
 	glBindAttribLocation(passthrough_shader_program->programHandle(), 1, "in_texcoord");
@@ -633,6 +544,7 @@ bool InitGL()
 
 	uniform_projection_loc = glGetUniformLocation(passthrough_shader_program->programHandle(), "projectionMatrix");
 	uniform_modelview_loc = glGetUniformLocation(passthrough_shader_program->programHandle(), "modelviewMatrix");
+	uniform_base_color_loc = glGetUniformLocation(passthrough_shader_program->programHandle(), "base_color");
 	
 	printf("%d\n", uniform_texture1_loc_fullscreen_quad);
 
@@ -653,33 +565,37 @@ bool InitGL()
 
 	// in terms of smoothness, hardware "Always on" VSYNC yields the best results (at least for me, Radeon HD 5770)
 
-	glGenFramebuffers(1, &FBOid);
-	glBindFramebuffer(GL_FRAMEBUFFER, FBOid);
-//
-	glGenTextures(1, &FBOtextureid);
-	glBindTexture(GL_TEXTURE_2D, FBOtextureid);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, WIN_W, WIN_H, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, FBOtextureid, 0);
-
-	GLenum m[2] = { GL_COLOR_ATTACHMENT0 };
-	glDrawBuffers(1, m);
-
-	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-
-		MessageBox(hWnd, "FBO initialization failed!", "error", NULL);
-		return false;
-	}
-	
-	glBindFramebuffer(GL_FRAMEBUFFER, FBOid);
-
 	glGenBuffers(1, &fullscreen_quadData.VBOid);
 	glBindBuffer(GL_ARRAY_BUFFER, fullscreen_quadData.VBOid);
 	glBufferData(GL_ARRAY_BUFFER, 6*sizeof(vertex), fullscreen_quad_vertices, GL_STATIC_DRAW);
+	MemStats::trackBuffer(fullscreen_quadData.VBOid, MEM_OTHER, 6*sizeof(vertex));
+
+	PostChain::init(fullscreen_quadData.VBOid);
+	post_pass resolve = { "resolve", fullscreen_quad_shader, POST_INPUT_PREVIOUS, true, NULL, NULL };
+	resolve_pass = PostChain::add(resolve);
+	PostChain::setElision(post_elision);
+
+	glGenBuffers(1, &envelopeData.VBOid);
+	glBindBuffer(GL_ARRAY_BUFFER, envelopeData.VBOid);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(envelope_vertices), NULL, GL_STREAM_DRAW);
+	MemStats::trackBuffer(envelopeData.VBOid, MEM_BAKE, sizeof(envelope_vertices));
+
+	// not fatal either, there's always the mesh
+	wave_shader_available = WaveShader::init(fullscreen_quadData.VBOid, resident_samples_int16);
+	phosphor_available = Phosphor::init(fullscreen_quadData.VBOid, resident_samples_int16);
+	goniometer_available = Goniometer::init(fullscreen_quadData.VBOid);
+	goniometer_enabled = goniometer_enabled && goniometer_available;
+	spectrogram_available = Spectrogram::init(fullscreen_quadData.VBOid);
+	spectrogram_enabled = spectrogram_enabled && spectrogram_available;
+	band_colors_available = WaveColors::init(passthrough_shader_program->programHandle());
+	band_colors_enabled = band_colors_enabled && band_colors_available;
+	if (render_mode == RENDER_SHADER && !wave_shader_available) render_mode = RENDER_MESH;
+	if (render_mode == RENDER_PHOSPHOR && !phosphor_available) render_mode = RENDER_MESH;
+
+	TileCache::init(tile_cache_tiles);
+
+	// not fatal, the HUD just shows zeros without timer query support
+	GPUTimer::init();
 
 	return true;
 }
@@ -689,12 +605,12 @@ void drawSliders() {
 	
 	glBindBuffer(GL_ARRAY_BUFFER, sliderData.VBOid);
 
-#ifdef _WIN32
+#ifdef WAVEPLOT_GL33
 
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
 
-#elif __linux__	// intel i915 only supports OpenGL up to 1.4 (mesa 8)
+#else	// intel i915 only supports OpenGL up to 1.4 (mesa 8)
 
 	glVertexPointer(2, GL_FLOAT, sizeof(vertex), NULL);
 	glTexCoordPointer(2, GL_FLOAT, sizeof(vertex), BUFFER_OFFSET(8));
@@ -720,92 +636,448 @@ void drawSliders() {
 
 }
 
-void drawWave() {
-	
+// state shared by the line mesh and the envelope
+static void useWaveProgram() {
+
 	glPolygonMode(GL_FRONT_AND_BACK, wave_polygonMode);
-	glBindBuffer(GL_ARRAY_BUFFER, waveData.VBOid);
 
-#ifdef _WIN32
+	wave_projection = mat4::proj_ortho(-View::zoom, WIN_W+View::zoom, WIN_H+View::zoomY(), -View::zoomY(), -1.0f, 1.0f);
+	glUseProgram(passthrough_shader_program->programHandle());
+	glUniform1i(uniform_texture1_loc, 0);
+	glUniformMatrix4fv(uniform_projection_loc, 1, GL_FALSE, (const GLfloat*)wave_projection.rawData());
+
+	glActiveTexture(GL_TEXTURE0);
+	
+	if (wave_solidColorTextureToggle) {
+		glBindTexture(GL_TEXTURE_2D, solid_color_texture.getId());
+	} else {		
+		glBindTexture(GL_TEXTURE_2D, gradient_texture.getId());
+	}
+
+}
+
+// the columns [*c0, *c1) with any of count samples, starting at document sample offset, under them
+static bool visibleColumns(double first_visible, double samples_per_column, double offset, std::size_t count,
+						   std::size_t *c0, std::size_t *c1) {
+
+	const double begin_column = first_visible < offset ? ceil((offset - first_visible)/samples_per_column) : 0;
+	const double end_column = ceil((offset + count - first_visible)/samples_per_column);
+	*c0 = begin_column < WIN_W ? (std::size_t)begin_column : WIN_W;
+	*c1 = end_column < *c0 ? *c0 : (end_column < WIN_W ? (std::size_t)end_column : WIN_W);
+	return *c1 > *c0;
+
+}
+
+// envelope_min/max, reduced for columns [c0, c1), as one strip. in color if there is one, otherwise like the wave
+static void drawEnvelopeColumns(double first_visible, double samples_per_column, std::size_t c0, std::size_t c1, const float *color) {
+
+	// x relative to the camera, so there's no translation to lose precision in
+	const std::size_t columns = c1 - c0;
+	const float column_width = (WIN_W + 2*View::zoom)/WIN_W;
+	const float pixel_height = (WIN_H + 2*View::zoomY())/WIN_H;
+	Envelope::bake(envelope_min, envelope_max, columns, -View::zoom + c0*column_width, column_width,
+				   half_WIN_H/32768.0f, pixel_height, envelope_vertices);
+
+	glBindBuffer(GL_ARRAY_BUFFER, envelopeData.VBOid);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, 2*columns*sizeof(vertex), envelope_vertices);
+
+#ifdef WAVEPLOT_GL33
 
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
 
-#elif __linux__	// intel i915 only supports OpenGL up to 1.4 (mesa 8)
+#else
 
 	glVertexPointer(2, GL_FLOAT, sizeof(vertex), NULL);
 	glTexCoordPointer(2, GL_FLOAT, sizeof(vertex), BUFFER_OFFSET(8));
 
 #endif
 
-	wave_projection = mat4::proj_ortho(-View::zoom, WIN_W+View::zoom, WIN_H+(View::zoom*aspect_ratio_recip), -(View::zoom*aspect_ratio_recip), -1.0f, 1.0f);
+	useWaveProgram();
+	const bool tinted = !color && band_colors_enabled;
+	if (tinted) WaveColors::bind(first_visible, samples_per_column);
+#ifdef WAVEPLOT_GL33
+	if (color) glUniform3fv(uniform_base_color_loc, 1, color);
+#endif
+
 	wave_modelview = mat4::identity();
-	wave_modelview.assign(3, 0, View::wave_position(0));
-	wave_modelview.assign(3, 1, View::wave_position(1));
-	glUseProgram(passthrough_shader_program->programHandle());
-	glUniform1i(uniform_texture1_loc, 0);
-	glUniformMatrix4fv(uniform_projection_loc, 1, GL_FALSE, (const GLfloat*)wave_projection.rawData());
+	wave_modelview.assign(3, 1, View::wave_y);
 	glUniformMatrix4fv(uniform_modelview_loc, 1, GL_FALSE, (const GLfloat*)wave_modelview.rawData());
-	
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, waveData.IBOid);
 
-	glActiveTexture(GL_TEXTURE0);
-	
-	if (wave_solidColorTextureToggle) {
-		glBindTexture(GL_TEXTURE_2D, solid_color_texture.getId());
-	} else {		
-		glBindTexture(GL_TEXTURE_2D, gradient_texture.getId());
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 2*columns);
+
+#ifdef WAVEPLOT_GL33
+	if (color) glUniform3f(uniform_base_color_loc, 0.0f, 0.0f, 0.0f);
+#endif
+	if (tinted) WaveColors::unbind();
+	glUseProgram(0);
+
+}
+
+static void drawEnvelope(double first_visible, double samples_per_column) {
+
+	PROFILE_ZONE("drawEnvelope");
+
+	// only the columns that have samples under them
+	std::size_t c0, c1;
+	if (!visibleColumns(first_visible, samples_per_column, 0, document_wav.sampleCount(), &c0, &c1)) return;
+
+	Envelope::reduce(document_wav, document_lod, first_visible + c0*samples_per_column, samples_per_column,
+					 c1 - c0, envelope_min, envelope_max);
+	drawEnvelopeColumns(first_visible, samples_per_column, c0, c1, NULL);
+
+}
+
+// the reference where Align put it, at the document's level (and polarity)
+static void drawReferenceOverlay(double first_visible, double samples_per_pixel) {
+
+	PROFILE_ZONE("drawReferenceOverlay");
+
+	const align_result &r = Align::result();
+	std::size_t c0, c1;
+	if (!visibleColumns(first_visible, samples_per_pixel, (double)r.lag, reference_wav.sampleCount(), &c0, &c1)) return;
+
+	Envelope::reduce(reference_wav, reference_lod, first_visible - r.lag + c0*samples_per_pixel, samples_per_pixel,
+					 c1 - c0, envelope_min, envelope_max);
+
+	for (std::size_t c = 0; c < c1 - c0; ++c) {
+		float lo = r.gain*envelope_min[c], hi = r.gain*envelope_max[c];
+		if (lo > hi) std::swap(lo, hi);
+		envelope_min[c] = (short)(lo < -32768.0f ? -32768.0f : lo);
+		envelope_max[c] = (short)(hi > 32767.0f ? 32767.0f : hi);
 	}
-#ifdef _WIN32
 
-	static const int spp = 1.0/dx;	// samples per pixel
+	drawEnvelopeColumns(first_visible, samples_per_pixel, c0, c1, reference_color);
+
+}
+
+// the document minus the lined up reference, in place of the wave
+static void drawDifference(double first_visible, double samples_per_pixel) {
+
+	PROFILE_ZONE("drawDifference");
+
+	std::size_t c0, c1;
+	if (!visibleColumns(first_visible, samples_per_pixel, 0, document_wav.sampleCount(), &c0, &c1)) return;
+
+	if (Align::difference(first_visible + c0*samples_per_pixel, samples_per_pixel, c1 - c0, envelope_min, envelope_max)) {
+		drawEnvelopeColumns(first_visible, samples_per_pixel, c0, c1, difference_color);
+	}
+
+}
+
+static void drawWaveShader(double first_visible, double last_visible, double samples_per_pixel, GLuint framebuffer) {
+
+	// below a level 0 bin per pixel the samples come from the timeline chunks
+	if (LOD::levelFor(document_lod, samples_per_pixel) < 0) {
+		Timeline::update(first_visible, last_visible + 1, View::wave_view_velocity(0) > 0 ? -1 : 1);
+	}
+
+	// the same mapping as the mesh: world y = WIN_H - (half_WIN_H*sample + half_WIN_H), then the projection
+	const float k = WIN_H/(WIN_H + 2*View::zoomY());
+
+	wave_shader_view v;
+	v.first_sample = first_visible;
+	v.samples_per_column = samples_per_pixel;
+	v.y_offset = WIN_H - (half_WIN_H + View::wave_y + View::zoomY())*k;
+	v.y_scale = half_WIN_H*k;
+	v.half_width = half_linewidth*k < 0.5f ? 0.5f : half_linewidth*k;
+
+	WaveShader::draw(v, framebuffer);
+
+}
+
+static void drawWavePhosphor(double first_visible, double last_visible, GLuint framebuffer) {
+
+	// sweeps starting near the right edge run on past it
+	double first = first_visible, last = last_visible + Phosphor::sweepLength();
+
+	// zoomed far out there can be more chunks in view than the budget holds (with
+	// the prefetched ones); the sweeps then come from as many as it does, mid view
+	const std::size_t held = Timeline::chunksInBudget();
+	const double span = held > TIMELINE_PREFETCH_CHUNKS + 1 ?
+		(double)(held - TIMELINE_PREFETCH_CHUNKS - 1)*TIMELINE_CHUNK_SAMPLES : (double)Phosphor::sweepLength();
+	if (last - first > span) {
+		const double middle = 0.5*(first + last);
+		first = middle - 0.5*span;
+		last = middle + 0.5*span;
+	}
+
+	Timeline::update(first, last, View::wave_view_velocity(0) > 0 ? -1 : 1);
+
+	const float k = WIN_H/(WIN_H + 2*View::zoomY());
+
+	phosphor_view v;
+	v.first_sample = first;
+	v.last_sample = last;
+	v.y_offset = WIN_H - (half_WIN_H + View::wave_y + View::zoomY())*k;
+	v.y_scale = half_WIN_H*k;
+
+	Phosphor::draw(v, framebuffer);
+
+}
+
+// the pairs of the visible range, whatever the render mode
+static void drawGoniometer(GLuint framebuffer) {
+
+	const double first_visible = (-View::wave_x - View::zoom)/dx;
+	const double last_visible = first_visible + (WIN_W + 2*View::zoom)/dx;
+
+	Goniometer::draw(first_visible, last_visible, goniometer_x, goniometer_y, framebuffer);
 
-	int samples_shown = (WIN_W + 2*View::zoom)*spp;
-	int actual_offset = -(int)(View::wave_position(0)) - (int)View::zoom;
-	if (actual_offset < 0) actual_offset = 0;
-	if (actual_offset*dx + samples_shown > BUFSIZE) {
-		samples_shown -= spp*actual_offset + samples_shown - BUFSIZE + 4;	// the 4 is just an arbitrary constant
-		if (samples_shown < 0) samples_shown = 0;							// to "complement" known bakeWaveVertexBuffer...()
-	}																		// end irregularities 
-																			// (i.e. conceal the manifestation of a bug. :P)
+}
+
+static void drawSpectrogram(GLuint framebuffer) {
+
+	const double first_visible = (-View::wave_x - View::zoom)/dx;
+	const double last_visible = first_visible + (WIN_W + 2*View::zoom)/dx;
+
+	Spectrogram::draw(first_visible, last_visible, 0, spectrogram_height, framebuffer);
+
+}
+
+// the clipped regions in view as light red columns behind the wave, a pixel wide at least
+static void drawClipHighlights(double first_visible, double samples_per_pixel) {
+
+	if (samples_per_pixel <= 0) return;
+
+	std::size_t a, b;
+	ClipIndex::find(first_visible, first_visible + WIN_W*samples_per_pixel, &a, &b);
+	if (a >= b) return;
+
+	glEnable(GL_SCISSOR_TEST);
+	glClearColor(1.0, 0.82, 0.82, 1.0);
+
+	// zoomed out, neighbouring regions land on the same pixels and go in one clear
+	int run_begin = -1, run_end = -1;
+	for (std::size_t i = a; i <= b; ++i) {
+		int x0 = WIN_W, x1 = WIN_W;
+		if (i < b) {
+			const clip_region &r = ClipIndex::region(i);
+			const double l = floor((r.first - first_visible)/samples_per_pixel), h = ceil((r.last - first_visible)/samples_per_pixel);
+			x0 = l < 0 ? 0 : (l > WIN_W ? WIN_W : (int)l);
+			x1 = h < 0 ? 0 : (h > WIN_W ? WIN_W : (int)h);
+			if (x1 <= x0) x1 = x0 + 1;
+			if (run_end >= x0) {
+				if (x1 > run_end) run_end = x1;
+				continue;
+			}
+		}
+		if (run_begin >= 0) {
+			glScissor(run_begin, 0, run_end - run_begin, WIN_H);
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+		run_begin = x0;
+		run_end = x1;
+	}
+
+	glClearColor(1.0, 1.0, 1.0, 1.0);
+	glDisable(GL_SCISSOR_TEST);
+
+}
+
+// a tick down from the top for every onset in view, as long as its strength; the strongest per pixel column
+static void drawOnsetMarkers(double first_visible, double samples_per_pixel) {
+
+	if (samples_per_pixel <= 0 || !Onsets::ready()) return;
+
+	std::size_t a, b;
+	Onsets::find(first_visible, first_visible + WIN_W*samples_per_pixel, &a, &b);
+	if (a >= b) return;
+
+	static float column_strength[WIN_W];
+	std::fill(column_strength, column_strength + WIN_W, 0.0f);
+	for (std::size_t i = a; i < b; ++i) {
+		const onset &o = Onsets::event(i);
+		const int x = (int)((o.sample - first_visible)/samples_per_pixel);
+		if (x >= 0 && x < (int)WIN_W && o.strength > column_strength[x]) column_strength[x] = o.strength;
+	}
+
+	glEnable(GL_SCISSOR_TEST);
+	glClearColor(0.85, 0.45, 0.1, 1.0);
+
+	for (int x = 0; x < (int)WIN_W; ++x) {
+		if (column_strength[x] <= 0.0f) continue;
+		const int h = 4 + (int)(column_strength[x]*(onset_marker_height - 4));
+		glScissor(x, WIN_H - h, 1, h);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	glClearColor(1.0, 1.0, 1.0, 1.0);
+	glDisable(GL_SCISSOR_TEST);
+
+}
+
+// the line mesh of the resident chunks, for when there are few samples per pixel
+static void drawWaveMesh(double first_visible, double last_visible, double samples_per_pixel) {
+
+	// the pan direction decides where the timeline prefetches
+	Timeline::update(first_visible, last_visible, View::wave_view_velocity(0) > 0 ? -1 : 1);
 
-	// when pos < 0, the program still renders samples_shown 
-	// samples even though they're out of the field of view.
+	useWaveProgram();
+	if (band_colors_enabled) WaveColors::bind(first_visible, samples_per_pixel);
 	
-	glDrawElements(GL_TRIANGLES, 6*samples_shown, GL_UNSIGNED_INT, BUFFER_OFFSET(6*spp*(actual_offset)*sizeof(GLuint)));
-#elif __linux__
-	glDrawElements(GL_TRIANGLES, BUFSIZE*2, GL_UNSIGNED_SHORT, NULL);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, waveData.IBOid);
+
+	const std::size_t lo = Timeline::chunkFor(first_visible), hi = Timeline::chunkFor(last_visible);
+
+	for (std::size_t i = lo; i < Timeline::chunkCount() && i <= hi; ++i) {
+
+		const timeline_chunk &c = Timeline::chunk(i);
+		if (!c.resident) continue;
+
+		glBindBuffer(GL_ARRAY_BUFFER, c.VBOid);
+
+#ifdef WAVEPLOT_GL33
+
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
+
+#else	// intel i915 only supports OpenGL up to 1.4 (mesa 8)
+
+		glVertexPointer(2, GL_FLOAT, sizeof(vertex), NULL);
+		glTexCoordPointer(2, GL_FLOAT, sizeof(vertex), BUFFER_OFFSET(8));
+
 #endif
+
+		// every chunk is baked from x = 0 at its first sample, so the offset is
+		// worked out in double and is small by the time it's a float
+		wave_modelview = mat4::identity();
+		wave_modelview.assign(3, 0, (float)(View::wave_x + (double)c.first*dx));
+		wave_modelview.assign(3, 1, View::wave_y);
+		glUniformMatrix4fv(uniform_modelview_loc, 1, GL_FALSE, (const GLfloat*)wave_modelview.rawData());
+
+		// just the visible part of the chunk, six indices per sample
+		const double chunk_begin = (double)(i*TIMELINE_CHUNK_SAMPLES);
+		if (last_visible < chunk_begin) continue;
+		std::size_t a = first_visible > chunk_begin ? (std::size_t)(first_visible - chunk_begin) : 0;
+		std::size_t b = (std::size_t)(last_visible - chunk_begin) + 1;
+		if (b > c.count) b = c.count;
+		if (a >= b) continue;
+
+		glDrawElements(GL_TRIANGLES, 6*(b - a), GL_UNSIGNED_INT, BUFFER_OFFSET(6*(c.lead + a)*sizeof(GLuint)));
+	}
 	
+	if (band_colors_enabled) WaveColors::unbind();
 	glUseProgram(0);
 	
 }
 
-// draw contents of FBO for fullscreen filtering (we have yet to come up with a good one)
-
-void drawFullScreenQuad() {
+// into the bound framebuffer (which the shader and phosphor renderers need to know)
+void drawWave(GLuint framebuffer) {
 	
+	PROFILE_ZONE("drawWave");
+
+	// visible range in samples
+	const double first_visible = (-View::wave_x - View::zoom)/dx;
+	const double last_visible = first_visible + (WIN_W + 2*View::zoom)/dx;
+	const double samples_per_pixel = (last_visible - first_visible)/WIN_W;
+
+	// phosphor keeps what it drew before, there's no background to mark
+	if (render_mode != RENDER_PHOSPHOR) {
+		drawClipHighlights(first_visible, samples_per_pixel);
+		drawOnsetMarkers(first_visible, samples_per_pixel);
+	}
+
+	// the difference takes the place of the wave once it's there
+	const bool comparing = reference_wav.valid() && Align::ready() && Align::result().found && render_mode != RENDER_PHOSPHOR;
+	if (comparing && compare_mode == COMPARE_DIFFERENCE) {
+		drawDifference(first_visible, samples_per_pixel);
+		return;
+	}
+
+	// and the overlay goes under it, so whatever the reference has that the document doesn't shows around the edges
+	if (comparing && compare_mode == COMPARE_OVERLAY) {
+		drawReferenceOverlay(first_visible, samples_per_pixel);
+	}
+
+	if (render_mode == RENDER_SHADER) {
+		drawWaveShader(first_visible, last_visible, samples_per_pixel, framebuffer);
+	}
+	else if (render_mode == RENDER_PHOSPHOR) {
+		drawWavePhosphor(first_visible, last_visible, framebuffer);
+	}
+	// dense enough that the line mesh would mostly be overdraw
+	else if (samples_per_pixel > ENVELOPE_MIN_SAMPLES_PER_PIXEL) {
+		drawEnvelope(first_visible, samples_per_pixel);
+	}
+	else {
+		drawWaveMesh(first_visible, last_visible, samples_per_pixel);
+	}
+
+}
+
+// the one or two tiles under the view, rendering whichever aren't cached yet
+static void drawWaveTiles(GLuint framebuffer) {
+
+	PROFILE_ZONE("drawWaveTiles");
+
+	// a tile is as wide as the view; tile i starts at world x = i*width
+	const double width = WIN_W + 2*View::zoom;
+	const double left = -View::wave_x - View::zoom;
+
+	// zoomed all the way in the view can be no width at all (or inside out), nothing to tile
+	if (width <= 0) {
+		drawWave(framebuffer);
+		return;
+	}
+	const float k = WIN_H/(WIN_H + 2*View::zoomY());
+
+	tile_key key;
+	key.zoom = View::zoom;
+	key.y = (int)floor(View::wave_y*k + 0.5);
+	key.style = render_mode | (wave_polygonMode == GL_LINE) << 1 | wave_solidColorTextureToggle << 2 | band_colors_enabled << 3 | compare_mode << 4;
+
+	const long long first = (long long)floor(left/width);
+	GLuint textures[2];
+
+	for (int t = 0; t < 2; ++t) {
+
+		key.index = first + t;
+		GLuint target;
+		textures[t] = TileCache::acquire(key, &target);
+		if (!target) continue;
+
+		// drawn as if the view started right at the tile, snapped to whole pixels vertically
+		const double x = View::wave_x;
+		const float y = View::wave_y;
+		View::wave_x = -(key.index*width) - View::zoom;
+		View::wave_y = key.y/k;
+
+		glClear(GL_COLOR_BUFFER_BIT);
+		drawWave(target);
+
+		View::wave_x = x;
+		View::wave_y = y;
+	}
+
+	// the tiles are opaque, straight copies at whole pixel offsets
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glDisable(GL_BLEND);
+
 	glBindBuffer(GL_ARRAY_BUFFER, fullscreen_quadData.VBOid);
-	
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
 
 	glUseProgram(fullscreen_quad_shader->programHandle());
 	glUniform1i(uniform_texture1_loc_fullscreen_quad, 0);
-	
-	glUseProgram(fullscreen_quad_shader->programHandle());
-
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, FBOtextureid);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
 
+	const int x0 = (int)floor((first*width - left)/width*WIN_W + 0.5);
+	for (int t = 0; t < 2; ++t) {
+		glBindTexture(GL_TEXTURE_2D, textures[t]);
+		glViewport(x0 + t*WIN_W, 0, WIN_W, WIN_H);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
+
+	glViewport(0, 0, WIN_W, WIN_H);
+	glEnable(GL_BLEND);
 	glUseProgram(0);
 
 }
 
-
 void drawWaveVertexArray() {
 
-#ifdef _WIN32
+#ifdef WAVEPLOT_GL33
 
 	glBindBuffer(GL_ARRAY_BUFFER, waveVertexArray.VBOid);
 	
@@ -817,8 +1089,8 @@ void drawWaveVertexArray() {
 	
 	wave_modelview.identity();
 
-	wave_modelview.assign(3, 0, View::wave_position(0));
-	wave_modelview.assign(3, 1, View::wave_position(1));
+	wave_modelview.assign(3, 0, (float)View::wave_x);
+	wave_modelview.assign(3, 1, View::wave_y);
 
 	glUseProgram(passthrough_shader_program->programHandle());
 	glUniform1i(uniform_texture1_loc, 0);
@@ -830,7 +1102,7 @@ void drawWaveVertexArray() {
 
 	glDrawArrays(GL_TRIANGLES, 0, BUFSIZE*2-1);
 
-#elif __linux__
+#else
 
 	// this code is crap
 	glBindBuffer(GL_ARRAY_BUFFER, waveVertexArray.VBOid); 
@@ -865,15 +1137,17 @@ void drawWaveVertexArray() {
 
 void drawText() {
 	
+	PROFILE_ZONE("drawText");
+
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	
 	
 	glBindBuffer(GL_ARRAY_BUFFER, wpstring_holder::get_static_VBOid());
-#ifdef _WIN32
+#ifdef WAVEPLOT_GL33
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(0));
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, BUFFER_OFFSET(2*sizeof(float)));
 
-#elif __linux__
+#else
 		glVertexPointer(2, GL_FLOAT, sizeof(vertex), NULL);
 		glTexCoordPointer(2, GL_FLOAT, sizeof(vertex), BUFFER_OFFSET(8));
 #endif
@@ -915,55 +1189,191 @@ void drawText() {
 }
 
 
+#ifdef _WIN32
 void GetIndices(void* arg) {
 
 	GLuint **p = (GLuint**)arg;
 	*p = generateIndexBufferWithSharedVertices();
 	_endthread();
 }
+#endif
+
+// once per file, when the jobs are done
+static void reportLoudness() {
+
+	const loudness_result &r = Loudness::result();
+	printf("Loudness: integrated %.1f LUFS, momentary max %.1f, short-term max %.1f, true peak %+.1f dBTP (%u blocks in %.1f ms)\n",
+		r.integrated, r.max_momentary, r.max_short_term, r.true_peak, (unsigned)r.blocks, r.milliseconds);
+	loudness_reported = true;
+
+}
+
+static void reportOnsets() {
+
+	printf("Onsets: %u found in %.1f ms\n", (unsigned)Onsets::count(), Onsets::milliSeconds());
+	onsets_reported = true;
+
+	// the tiles drawn while they were still being found don't have the markers
+	TileCache::clear();
+
+}
+
+// the overview comes from lod_cache/ if this exact file has been opened
+// before, otherwise it's built from the resident samples and stored there.
+// the document's, or the reference's.
+static void loadLOD(const std::string &filename, const WavSource &source, Arena &arena, MappedFile &mapping, lod_pyramid *lod) {
+
+	const timer_tick_t t0 = Timer::get();
+	const std::size_t count = source.sampleCount();
+
+	hash64_t key;
+	const bool keyed = LODCache::fileKey(filename, &key);
+
+	if (keyed && LODCache::load(key, mapping, lod)
+		&& lod->num_samples == count) {
+		printf("LOD: %d levels from the cache in %.3f ms.\n", lod->level_count,
+			Timer::ticksToMicroSeconds(Timer::get() - t0)/1000.0);
+		return;
+	}
+
+	mapping.close();
+	*lod = lod_pyramid();
+
+	// one pass over the whole file; mono is read straight from the mapping,
+	// stereo is downmixed a chunk at a time
+	lod_build_state state;
+	LOD::begin(count, arena, lod, &state, source.header().sampleRate);
+	if (source.direct()) {
+		LOD::add(lod, &state, 0, source.direct(), count);
+	}
+	else {
+		const Arena::marker staging = arena.mark();
+		short *buffer = arena.allocArray<short>(MEM_IO, TIMELINE_CHUNK_SAMPLES);
+		for (std::size_t first = 0; first < count; first += TIMELINE_CHUNK_SAMPLES) {
+			const std::size_t n = source.read(first, TIMELINE_CHUNK_SAMPLES, buffer);
+			LOD::add(lod, &state, first, buffer, n);
+		}
+		arena.rewind(staging);
+	}
+	LOD::finish(arena, lod);
+
+	if (keyed) {
+		LODCache::store(key, *lod, source.header());
+	}
+
+	printf("LOD: built %d levels (%u KiB) in %.3f ms.\n", lod->level_count, (unsigned)(LOD::bytes(*lod)/1024),
+		Timer::ticksToMicroSeconds(Timer::get() - t0)/1000.0);
+
+}
+
+// peak, rms and DC of the whole file are the top bin of the pyramid; the clipped regions come from level 0
+static void indexDocumentClips() {
+
+	ClipIndex::build(document_lod);
+	if (!document_lod.level_count) return;
+
+	const lod_bin &top = document_lod.levels[document_lod.level_count - 1][0];
+	const lod_stats &top_stats = document_lod.stats[document_lod.level_count - 1][0];
+	const int peak = -top.min > top.max ? -top.min : top.max;
+
+	printf("peak %.2f dBFS, rms %.2f dBFS, DC offset %+.5f, %u clipped samples in %u regions\n",
+		peak > 0 ? 20.0*log10(peak/32768.0) : -96.0, top.rms > 0 ? 20.0*log10(top.rms/32768.0) : -96.0,
+		top_stats.mean/32768.0, (unsigned)ClipIndex::clippedSamples(), (unsigned)ClipIndex::regionCount());
+
+}
 
 bool readWAVFile(const std::string& filename) {
 	
-	std::ifstream input(filename, std::ios::binary);
+	PROFILE_ZONE("readWAVFile");
 
-	if (!input.is_open()) {	
-		printf("Couldn't open file %s\n", filename.c_str());
+	// open() unmaps whatever file was open before
+	dropDocumentJobs();
+
+	// nothing is read here but the header; the timeline pages in chunks
+	// of the mapping as they come into view.
+	if (!document_wav.open(filename)) {
 		return false;
+	}
 
+	const std::size_t num_samples = document_wav.sampleCount();
+	BUFSIZE = num_samples;	// no BUFSIZE_MAX ceiling with the timeline
+
+	// zooming out stops with the whole file (and a bit) in view
+	const float whole_file = (float)(1.1*num_samples*dx - WIN_W)/2;
+	View::zoom_limit = whole_file > View::zoom_max ? whole_file : View::zoom_max;
+	if (View::zoom > View::zoom_limit) View::zoom = View::zoom_limit;
+
+	printf("%s: %u samples, %d channel(s)\n", filename.c_str(), (unsigned)num_samples, (int)document_wav.header().numChannels);
+
+	loadLOD(filename, document_wav, document_arena, document_lod_mapping, &document_lod);
+	indexDocumentClips();
+
+	Timeline::open(&document_wav, resident_samples_int16, render_mode == RENDER_MESH, timeline_budget);
+	WaveShader::setPyramid(&document_lod);
+	WaveColors::setPyramid(&document_lod);
+	Phosphor::setSource(&document_wav);
+	Goniometer::setSource(&document_wav);
+	Spectrogram::setSource(&document_wav);
+	Loudness::setSource(&document_wav);
+	loudness_reported = false;
+	Onsets::setSource(&document_wav);
+	onsets_reported = false;
+	// a reference stays open from one document to the next, and gets lined up again
+	if (reference_wav.valid()) {
+		Align::setSources(&document_wav, &reference_wav);
+		alignment_reported = false;
 	}
-	std::size_t num_samples;
+	Phosphor::clear();
+	TileCache::clear();
 
-	// the readSampleData_int16 function actually reads the whole file.
-	float *samples = readSampleData_int16(input, &num_samples);	// presuming signed 16-bit, little endian
+	return true;
 
-	if (num_samples > BUFSIZE_MAX) {
-		BUFSIZE=BUFSIZE_MAX;
-	} else { BUFSIZE = num_samples; }
+}
 
+static void reportAlignment() {
 
-	// the bakeWaveVertexBufferUsingLineIntersections is a bit slow...
-	// for a 110MB stereo WAV file, it takes ~ 18ms for the stereo->mono
-	// downmixing, 20 ms for file I/O, ~32ms for short -> float
-	// conversion with scaling, and another whopping 2532ms for bake.
-	
-	// A solution would be to create an initial vertex buffer object
-	// that only includes the first ~four screenfuls of samples,
-	// meanwhile creating the final, complete buffer.
-	
-	Timer::init();
-	Timer::start();
-	vertex* vertices = bakeWaveVertexBufferUsingLineIntersections(samples, BUFSIZE);
-	
-	delete [] samples;
+	const align_result &r = Align::result();
+	if (r.found) {
+		const double rate = document_wav.header().sampleRate > 0 ? document_wav.header().sampleRate : 44100.0;
+		printf("Align: reference at %+lld samples (%+.3f s), correlation %.3f, gain %+.2f dB%s; %d of %d excerpts agree, coarse %+lld at 1/%u, in %.1f ms\n",
+			r.lag, r.lag/rate, r.correlation, r.gain != 0.0f ? 20.0*log10(fabs(r.gain)) : -96.0, r.gain < 0.0f ? " (polarity flipped)" : "",
+			r.agreeing, r.excerpts, r.coarse_lag, (unsigned)r.decimation, r.milliseconds);
+	}
+	alignment_reported = true;
+
+	// the overlay or the difference goes into the tiles from now on
+	TileCache::clear();
+
+}
+
+static void closeReference() {
+
+	Align::setSources(NULL, NULL);
+	reference_wav.close();
+	reference_lod = lod_pyramid();
+	reference_lod_mapping.close();
+	reference_arena.reset();
+
+}
+
+// the file to compare the open one with, in place of any earlier one; it's lined up on the job pool
+static bool openReference(const std::string &filename) {
+
+	closeReference();
+	if (!reference_wav.open(filename)) {
+		return false;
+	}
+
+	printf("compare with %s: %u samples, %d channel(s)\n", filename.c_str(), (unsigned)reference_wav.sampleCount(),
+		(int)reference_wav.header().numChannels);
+
+	loadLOD(filename, reference_wav, reference_arena, reference_lod_mapping, &reference_lod);
+	if (document_wav.valid()) {
+		Align::setSources(&document_wav, &reference_wav);
+	}
+	alignment_reported = false;
+	TileCache::clear();
 
-	double bake_t = Timer::getMilliSeconds();
-	
-	printf("Baking took %f ms.\n", bake_t);
-	
-	waveData.VBOid = generateWaveVertexBufferObject(vertices);	
-	
-	delete [] vertices;
-		
 	return true;
 
 }
@@ -973,67 +1383,328 @@ inline void control() {
 	// arbitrary timestep
 	static const float dt = 0.5;
 
-	if (View::mbuttondown) {
-			View::prev_dx = View::dx;
-			View::prev_dy = View::dy;
+	if (View::mbuttondown) {
+			View::prev_dx = View::dx;
+			View::prev_dy = View::dy;
+
+			View::dx = -(View::prev_mouse_x - View::mouse_x);
+			View::dy = -(View::prev_mouse_y - View::mouse_y);
+			//printf("%f, %f\n", View::dx, View::dy);
+
+			const float Ddx = View::dx-View::prev_dx;
+			const float Ddy = View::dy-View::prev_dy;
+
+			if (View::dx == 0 && View::dy == 0) {
+				View::wave_view_velocity *= 0.1;
+			}
+			else {
+				float vel_x = View::wave_view_velocity(0) + (Ddx / dt)*View::panScale();
+				View::wave_view_velocity.assign(0, vel_x);
+
+				float vel_y = View::wave_view_velocity(1) + (Ddy / dt)*View::panScale();
+				View::wave_view_velocity.assign(1, vel_y);
+			}
+			// in an attempt to make the velocity vector more "sticky"
+			View::wave_view_velocity_sample1 = 0.5*(View::wave_view_velocity + View::wave_view_velocity_sample1);
+
+			View::pan(View::wave_view_velocity*dt);
+
+			View::prev_mouse_x = View::mouse_x;
+			View::prev_mouse_y = View::mouse_y;
+	}
+
+	else {
+		
+		View::wave_view_velocity *= 0.88;
+		View::wave_view_velocity_sample1 *= 0.88;
+		View::pan(View::wave_view_velocity_sample1*dt);
+
+	}
+
+}
+static void setRenderMode(int mode) {
+
+	if (mode == RENDER_SHADER && !wave_shader_available) return;
+	if (mode == RENDER_PHOSPHOR && !phosphor_available) return;
+	render_mode = mode;
+
+	// the shader and phosphor renderers only want the samples of the chunks, not their meshes
+	if (document_wav.valid()) {
+		Timeline::open(&document_wav, resident_samples_int16, render_mode == RENDER_MESH, timeline_budget);
+	}
+	Phosphor::clear();
+	printf("render mode: %s\n", renderModeName(render_mode));
+
+}
+
+static void handleKey(int key) {
+
+	if (key == 'p') {
+		// kind of bad, since if done this way,
+		// the text will get globbered as well :D
+		if (wave_polygonMode == GL_LINE) {
+			wave_polygonMode = GL_FILL;
+		}
+		else { wave_polygonMode = GL_LINE; }
+	}
+
+	else if (key == 't') {
+		wave_solidColorTextureToggle = !wave_solidColorTextureToggle;
+	}
+
+	else if (key == 'r') {
+		// the next one that's available
+		int mode = render_mode;
+		do {
+			mode = (mode + 1) % RENDER_MODE_COUNT;
+			setRenderMode(mode);
+		} while (render_mode != mode);
+	}
+
+	else if (key == 'c') {
+		tile_cache_enabled = !tile_cache_enabled;
+	}
+
+	else if (key == 'g') {
+		goniometer_enabled = !goniometer_enabled && goniometer_available;
+		if (!goniometer_enabled) Goniometer::unload();
+	}
+
+	else if (key == 's') {
+		spectrogram_enabled = !spectrogram_enabled && spectrogram_available;
+	}
+
+	else if (key == 'b') {
+		band_colors_enabled = !band_colors_enabled && band_colors_available;
+	}
+
+	else if (key == 'n') {
+		// centers the next clipped region after the middle of the view
+		const long long i = ClipIndex::next((WIN_W/2 - View::wave_x)/dx);
+		if (i >= 0) {
+			const clip_region &r = ClipIndex::region((std::size_t)i);
+			View::wave_x = WIN_W/2 - 0.5*(r.first + r.last)*dx;
+			printf("clip %u/%u: samples %u..%u, %u at full scale\n", (unsigned)i + 1, (unsigned)ClipIndex::regionCount(),
+				(unsigned)r.first, (unsigned)r.last, r.clips);
+		}
+	}
+
+	else if (key == ']' || key == '[') {
+		// centers the next (or previous) onset; half a sample off, so the one in the middle isn't found again
+		const double center = (WIN_W/2 - View::wave_x)/dx;
+		const long long i = key == ']' ? Onsets::next(center + 0.5) : Onsets::previous(center - 0.5);
+		if (i >= 0) {
+			const onset &o = Onsets::event((std::size_t)i);
+			View::wave_x = WIN_W/2 - (double)o.sample*dx;
+			printf("onset %u/%u: sample %u, strength %.2f\n", (unsigned)i + 1, (unsigned)Onsets::count(), (unsigned)o.sample, o.strength);
+		}
+	}
+
+	else if (key == 'd') {
+		compare_mode = (compare_mode + 1) % COMPARE_MODE_COUNT;
+		printf("compare: %s\n", compareModeName(compare_mode));
+	}
+
+	else if (key == 'f') {
+		// 256 up to 4096, and around again
+		const std::size_t n = Spectrogram::fftSize();
+		Spectrogram::setFFTSize(n < SPECTROGRAM_MAX_FFT ? 2*n : SPECTROGRAM_MIN_FFT);
+		printf("spectrogram: FFT size %u\n", (unsigned)Spectrogram::fftSize());
+	}
+
+}
+
+// everything that moves the camera or toggles rendering state goes through
+// here, either live (via dispatchInput) or from a recorded trace.
+
+static void handleInput(const input_event &e) {
+
+	switch (e.type) {
+		case INPUT_BUTTON_DOWN:
+			View::mouse_x = View::prev_mouse_x = e.x;
+			View::mouse_y = View::prev_mouse_y = e.y;
+			View::mbuttondown = true;
+			break;
+		case INPUT_BUTTON_UP:
+			View::mbuttondown = false;
+			break;
+		case INPUT_MOUSE_MOVE:
+			View::mouse_x = e.x;
+			View::mouse_y = e.y;
+			break;
+		case INPUT_WHEEL:
+			if (e.x < 0) {
+				View::zoomOut();
+			} else if (e.x > 0) { View::zoomIn(); }
+			break;
+		case INPUT_KEY:
+			handleKey(e.x);
+			break;
+		default:
+			break;
+	}
+
+}
+
+#ifdef _WIN32
+// only the window has live input
+static void dispatchInput(int type, int x, int y) {
 
-			POINT p;
-			GetCursorPos(&p);
-				
-			//View::dx = -(View::mouse_pos0->x - p.x);
-			//View::dy = -(View::mouse_pos0->y - p.y);
-			
-			View::dx = -(View::prev_mouse_pos->x - p.x);
-			View::dy = -(View::prev_mouse_pos->y - p.y);
-			//printf("%f, %f\n", View::dx, View::dy);
+	// live input would just derail the recorded camera path
+	if (InputTrace::replaying()) return;
 
-			const float Ddx = View::dx-View::prev_dx;
-			const float Ddy = View::dy-View::prev_dy;
+	InputTrace::record(type, x, y);
+	handleInput(input_event(0.0, type, x, y));
 
-			if (View::dx == 0 && View::dy == 0) {
-				View::wave_view_velocity *= 0.1;
-			}
-			else {
-				// with the exp term, the sensitivity now scales with zoom level
-				float vel_x = View::wave_view_velocity(0) + (Ddx / dt)*exp(View::zoom / 290.0);
-				View::wave_view_velocity.assign(0, vel_x);
+}
+#endif
 
-				float vel_y = View::wave_view_velocity(1) + (Ddy / dt)*exp(View::zoom / 290.0);
-				View::wave_view_velocity.assign(1, vel_y);
-			}
-			// in an attempt to make the velocity vector more "sticky"
-			View::wave_view_velocity_sample1 = 0.5*(View::wave_view_velocity + View::wave_view_velocity_sample1);
+static const int replay_settle_frames = 60;	// let the inertia die out after the last event
 
-			View::wave_position += View::wave_view_velocity*dt;
+// feeds the events that are due by the virtual clock. returns false once
+// the whole trace has been played.
 
-			*View::prev_mouse_pos = p;
-	}
+static bool replayInput(int frame) {
 
-	else {
-		
-		View::wave_view_velocity *= 0.88;
-		View::wave_view_velocity_sample1 *= 0.88;
-		View::wave_position += View::wave_view_velocity_sample1*dt;
+	static int settle = 0;
 
+	const double t = frame*frame_interval;
+	input_event e;
+	while (InputTrace::next(t, &e)) {
+		handleInput(e);
 	}
 
+	if (InputTrace::finished()) {
+		return ++settle <= replay_settle_frames;
+	}
+	return true;
+
 }
 
+
 inline void draw() {
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, FBOid);
+	PROFILE_ZONE("draw");
+
+	// straight into the window unless some post-processing pass needs the scene as a texture
+	const GLuint scene = PostChain::begin(default_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, scene);
 	glClear(GL_COLOR_BUFFER_BIT);
 	
-	drawWave();
+	GPUTimer::begin(GPU_PASS_WAVE);
+	// the phosphor is all about what the previous frames left behind, nothing to cache there
+	if (tile_cache_enabled && render_mode != RENDER_PHOSPHOR) {
+		drawWaveTiles(scene);
+	}
+	else {
+		drawWave(scene);
+	}
+	if (spectrogram_enabled) {
+		drawSpectrogram(scene);
+	}
+	if (goniometer_enabled) {
+		drawGoniometer(scene);
+	}
+	GPUTimer::end(GPU_PASS_WAVE);
 	//drawWaveVertexArray();
+	GPUTimer::begin(GPU_PASS_TEXT);
 	drawText();
+	GPUTimer::end(GPU_PASS_TEXT);
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	drawFullScreenQuad();
+	GPUTimer::begin(GPU_PASS_RESOLVE);
+	PostChain::end(default_framebuffer);
+	GPUTimer::end(GPU_PASS_RESOLVE);
 	//drawSliders();
 		
 }
 
+// the passes draw() times. the swap isn't one of them: the headless build has
+// none, so leaving it out keeps replay timings comparable between the two
+static double drawGPUMilliSeconds() {
+	return GPUTimer::getMilliSeconds(GPU_PASS_WAVE) + GPUTimer::getMilliSeconds(GPU_PASS_TEXT) + GPUTimer::getMilliSeconds(GPU_PASS_RESOLVE);
+}
+
+
+
+void initializeStrings() {
+
+	// NOTE: it wouldn't be such a bad idea to just take in a vector 
+	// of strings, and to generate one single static VBO for them all.
+
+	std::string string1 = "Filename: " + input_filename;
+	wpstring_holder::append(wpstring(string1, 15, 15), WPS_DYNAMIC);
+
+	std::string frames("Frames per second: ");
+	wpstring_holder::append(wpstring(frames, WIN_W-180, WIN_H-20), WPS_STATIC);
+
+	// reserved index 2 for FPS display.
+	std::string initialfps = "00.00";
+	wpstring_holder::append(wpstring(initialfps, WIN_W-50, WIN_H-20), WPS_DYNAMIC);
+	
+	char buf[16];
+	snprintf(buf, 16, "%d", (int)BUFSIZE);
+	const std::string buffer_size(buf);
+	const std::string bufinfostring = "Buffer size / # of samples: " + buffer_size;
+	wpstring_holder::append(wpstring(bufinfostring, 15, WIN_H-20), WPS_DYNAMIC);
+
+	const std::string help1("Press 'o' to open a new file.");
+	wpstring_holder::append(wpstring(help1, WIN_W-220, 20), WPS_STATIC);
+	const std::string help2("'p' for polygonmode toggle.");
+	wpstring_holder::append(wpstring(help2, WIN_W-220, 35), WPS_STATIC);
+	const std::string help3("'t' for texture toggle.");
+	wpstring_holder::append(wpstring(help3, WIN_W-220, 50), WPS_STATIC);
+	const std::string help4("'m' for memory report.");
+	wpstring_holder::append(wpstring(help4, WIN_W-220, 65), WPS_STATIC);
+	const std::string help5("'r' for renderer toggle.");
+	wpstring_holder::append(wpstring(help5, WIN_W-220, 80), WPS_STATIC);
+	const std::string help6("'c' for tile cache toggle.");
+	wpstring_holder::append(wpstring(help6, WIN_W-220, 95), WPS_STATIC);
+	const std::string help7("'g' for goniometer toggle.");
+	wpstring_holder::append(wpstring(help7, WIN_W-220, 110), WPS_STATIC);
+	const std::string help8("'s' for spectrogram toggle.");
+	wpstring_holder::append(wpstring(help8, WIN_W-220, 125), WPS_STATIC);
+	const std::string help9("'f' for FFT size.");
+	wpstring_holder::append(wpstring(help9, WIN_W-220, 140), WPS_STATIC);
+	const std::string help10("'b' for band colors toggle.");
+	wpstring_holder::append(wpstring(help10, WIN_W-220, 155), WPS_STATIC);
+	const std::string help11("'n' for next clipped region.");
+	wpstring_holder::append(wpstring(help11, WIN_W-220, 170), WPS_STATIC);
+	const std::string help12("'[' ']' for previous/next onset.");
+	wpstring_holder::append(wpstring(help12, WIN_W-220, 185), WPS_STATIC);
+	const std::string help13("'w' for a file to compare with.");
+	wpstring_holder::append(wpstring(help13, WIN_W-220, 200), WPS_STATIC);
+	const std::string help14("'d' for overlay/difference/off.");
+	wpstring_holder::append(wpstring(help14, WIN_W-220, 215), WPS_STATIC);
+
+	// indices HUD_GPU_STRINGS_BEGIN.. for the per-pass GPU times
+	for (int i = 0; i < GPU_PASS_COUNT; ++i) {
+		wpstring_holder::append(wpstring("GPU", 15, WIN_H-35-15*(GPU_PASS_COUNT-i)), WPS_DYNAMIC);
+	}
+
+	// HUD_TILE_STRING, right above them
+	wpstring_holder::append(wpstring("tiles", 15, WIN_H-35-15*(GPU_PASS_COUNT+1)), WPS_DYNAMIC);
+
+	// HUD_CORRELATION_STRING, under the goniometer panel
+	wpstring_holder::append(wpstring("", goniometer_x, WIN_H - goniometer_y + 15), WPS_DYNAMIC);
+
+	// HUD_SPECTROGRAM_STRING, right above the band
+	wpstring_holder::append(wpstring("", 15, WIN_H - spectrogram_height - 15), WPS_DYNAMIC);
+
+	// HUD_RANGE_STRING, above the tile line
+	wpstring_holder::append(wpstring("", 15, WIN_H-35-15*(GPU_PASS_COUNT+2)), WPS_DYNAMIC);
+
+	// HUD_CLIP_STRING, above that
+	wpstring_holder::append(wpstring("", 15, WIN_H-35-15*(GPU_PASS_COUNT+3)), WPS_DYNAMIC);
+
+	// HUD_LOUDNESS_STRING, and above that
+	wpstring_holder::append(wpstring("", 15, WIN_H-35-15*(GPU_PASS_COUNT+4)), WPS_DYNAMIC);
+
+	// HUD_ALIGN_STRING, at the top of the pile
+	wpstring_holder::append(wpstring("", 15, WIN_H-35-15*(GPU_PASS_COUNT+5)), WPS_DYNAMIC);
+
+	wpstring_holder::createBufferObjects();
+
+}
 
 
 #ifdef _WIN32
@@ -1277,17 +1948,16 @@ LRESULT CALLBACK WndProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 				ShowCursor(TRUE);	// for some very odd reason, two calls are needed to
 				ShowCursor(TRUE);	// accomplish the task :D
 
-				View::mbuttondown=false;
+				dispatchInput(INPUT_BUTTON_UP, 0, 0);
 				return 0;
 			}
 		case WM_LBUTTONDOWN:
 			{
 				GetWindowRect(hWnd, &View::windowRect);
 				ClipCursor(&View::windowRect);
-				GetCursorPos(View::mouse_pos0);
-				*View::prev_mouse_pos = *View::mouse_pos0;
-				View::wave_pos0 = View::wave_position;
-				View::mbuttondown = true;
+				POINT p;
+				GetCursorPos(&p);
+				dispatchInput(INPUT_BUTTON_DOWN, p.x, p.y);
 				
 				ShowCursor(FALSE);
 				ShowCursor(FALSE);
@@ -1298,9 +1968,7 @@ LRESULT CALLBACK WndProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			{
 				int fwKeys = GET_KEYSTATE_WPARAM(wParam);
 				int delta = GET_WHEEL_DELTA_WPARAM(wParam);
-				if (delta < 0) {
-					View::zoomOut();
-				} else if (delta > 0) { View::zoomIn(); }
+				dispatchInput(INPUT_WHEEL, delta, 0);
 
 				return 0;
 			}
@@ -1350,7 +2018,6 @@ LRESULT CALLBACK WndProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
 		case WM_CLOSE:
 			{
-				delete View::mouse_pos0;
 				PostQuitMessage(0);
 				return 0;
 			}
@@ -1361,39 +2028,18 @@ LRESULT CALLBACK WndProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 }
 
 
-void initializeStrings() {
-
-	// NOTE: it wouldn't be such a bad idea to just take in a vector 
-	// of strings, and to generate one single static VBO for them all.
-
-	std::string string1 = "Filename: " + input_filename;
-	wpstring_holder::append(wpstring(string1, 15, 15), WPS_DYNAMIC);
-
-	std::string frames("Frames per second: ");
-	wpstring_holder::append(wpstring(frames, WIN_W-180, WIN_H-20), WPS_STATIC);
-
-	// reserved index 2 for FPS display.
-	std::string initialfps = "00.00";
-	wpstring_holder::append(wpstring(initialfps, WIN_W-50, WIN_H-20), WPS_DYNAMIC);
-	
-	char buf[16];
-	sprintf_s(buf, 16, "%d", BUFSIZE);
-	const std::string buffer_size(buf);
-	const std::string bufinfostring = "Buffer size / # of samples: " + buffer_size;
-	wpstring_holder::append(wpstring(bufinfostring, 15, WIN_H-20), WPS_DYNAMIC);
+// min/max/rms of the samples in view for the HUD, in O(log n)
+static bool visibleRangeStats(range_stats *out) {
 
-	const std::string help1("Press 'o' to open a new file.");
-	wpstring_holder::append(wpstring(help1, WIN_W-220, 20), WPS_STATIC);
-	const std::string help2("'p' for polygonmode toggle.");
-	wpstring_holder::append(wpstring(help2, WIN_W-220, 35), WPS_STATIC);
-	const std::string help3("'t' for texture toggle.");
-	wpstring_holder::append(wpstring(help3, WIN_W-220, 50), WPS_STATIC);
+	const double first_visible = (-View::wave_x - View::zoom)/dx;
+	const double last_visible = first_visible + (WIN_W + 2*View::zoom)/dx;
+	if (last_visible <= 0) return false;
 
-	wpstring_holder::createBufferObjects();
+	return RangeStats::query(document_wav, document_lod, first_visible > 0 ? (std::size_t)first_visible : 0,
+							 (std::size_t)ceil(last_visible), out);
 
 }
 
-
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
 
@@ -1419,6 +2065,62 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
 	fullscreen=FALSE;
 
+	Profiler::init();
+	const JobPool::Scope job_pool;
+
+	// "--record file.trace", "--replay file.trace", "--float-samples", "--budget MiB", "--render mesh|shader|phosphor",
+	// "--no-tile-cache", "--no-elide", "--goniometer", "--spectrogram", "--band-colors", "--compare file.wav"
+	char opt[16], trace_filename[MAX_PATH], compare_filename[MAX_PATH] = "";
+	const char *args = lpCmdLine;
+	int consumed = 0;
+	while (sscanf(args, "%15s%n", opt, &consumed) == 1) {
+		args += consumed;
+		if (!strcmp(opt, "--float-samples")) {
+			resident_samples_int16 = false;
+		}
+		else if (!strcmp(opt, "--no-tile-cache")) {
+			tile_cache_enabled = false;
+		}
+		else if (!strcmp(opt, "--no-elide")) {
+			post_elision = false;
+		}
+		else if (!strcmp(opt, "--goniometer")) {
+			goniometer_enabled = true;
+		}
+		else if (!strcmp(opt, "--spectrogram")) {
+			spectrogram_enabled = true;
+		}
+		else if (!strcmp(opt, "--band-colors")) {
+			band_colors_enabled = true;
+		}
+		else if (!strcmp(opt, "--render")) {
+			char mode[16];
+			if (sscanf(args, "%15s%n", mode, &consumed) != 1) break;
+			args += consumed;
+			render_mode = parseRenderMode(mode);
+		}
+		else if (!strcmp(opt, "--budget")) {
+			unsigned mib;
+			if (sscanf(args, "%u%n", &mib, &consumed) != 1) break;
+			args += consumed;
+			timeline_budget = (std::size_t)mib*1024*1024;
+		}
+		else if (!strcmp(opt, "--compare")) {
+			if (sscanf(args, "%259s%n", compare_filename, &consumed) != 1) break;
+			args += consumed;
+		}
+		else if (!strcmp(opt, "--record") || !strcmp(opt, "--replay")) {
+			if (sscanf(args, "%259s%n", trace_filename, &consumed) != 1) break;
+			args += consumed;
+			if (!strcmp(opt, "--record")) {
+				InputTrace::startRecording(trace_filename);
+			}
+			else if (!InputTrace::load(trace_filename)) {
+				return 1;
+			}
+		}
+	}
+
 	if (!CreateGLWindow("waveplot", WIN_W, WIN_H, 32, FALSE)) {
 		return 1;
 	}
@@ -1437,6 +2139,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 		return 1;
 	}
 
+	if (compare_filename[0] && !openReference(compare_filename)) {
+		printf("Couldn't open %s to compare with.\n", compare_filename);
+	}
+
 
 	//float tmpx = 0.0;
 ///	static float step = 0.125;
@@ -1458,10 +2164,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
 	waveData.IBOid = generateGlobalIndexBuffer(indices);
 	
-	delete [] indices;
+	MemStats::release(indices);
 
 	Timer::init();
 
+	int frame = 0;
+
 	while(!done)
 	{
 
@@ -1527,27 +2235,112 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 				}
 
 				if (keys['p']) {
+					dispatchInput(INPUT_KEY, 'p', 0);
+					keys['p'] = false;
+				}
+
+				if (keys['t']) {
+					dispatchInput(INPUT_KEY, 't', 0);
+					keys['t'] = false;
+				}
+
+				if (keys['r']) {
+					dispatchInput(INPUT_KEY, 'r', 0);
+					keys['r'] = false;
+				}
 
-					// kind of bad, since if done this way,
-					// the text will get globbered as well :D
-					if (wave_polygonMode == GL_LINE) {
-						wave_polygonMode = GL_FILL;
+				if (keys['c']) {
+					dispatchInput(INPUT_KEY, 'c', 0);
+					keys['c'] = false;
+				}
+
+				if (keys['g']) {
+					dispatchInput(INPUT_KEY, 'g', 0);
+					keys['g'] = false;
+				}
+
+				if (keys['s']) {
+					dispatchInput(INPUT_KEY, 's', 0);
+					keys['s'] = false;
+				}
+
+				if (keys['f']) {
+					dispatchInput(INPUT_KEY, 'f', 0);
+					keys['f'] = false;
+				}
+
+				if (keys['w']) {
+					// the file to line the open one up with
+					const std::string reference_filename = openFileDialog();
+					if (reference_filename != "" && !openReference(reference_filename)) {
+						MessageBox(NULL, "Couldn't open the file to compare with!", "Error!", NULL);
 					}
-					else { wave_polygonMode = GL_LINE; }
+					keys['w'] = false;
+				}
 
-					keys['p'] = false;
+				if (keys['d']) {
+					dispatchInput(INPUT_KEY, 'd', 0);
+					keys['d'] = false;
+				}
 
+				if (keys['b']) {
+					dispatchInput(INPUT_KEY, 'b', 0);
+					keys['b'] = false;
 				}
 
-				if (keys['t']) {
+				if (keys['n']) {
+					dispatchInput(INPUT_KEY, 'n', 0);
+					keys['n'] = false;
+				}
 
-					wave_solidColorTextureToggle = !wave_solidColorTextureToggle;
-					keys['t'] = false;
+				if (keys['[']) {
+					dispatchInput(INPUT_KEY, '[', 0);
+					keys['['] = false;
+				}
+
+				if (keys[']']) {
+					dispatchInput(INPUT_KEY, ']', 0);
+					keys[']'] = false;
 				}
 
+				if (keys['m']) {
+					MemStats::printReport();
+					keys['m'] = false;
+				}
+
+				if (InputTrace::replaying()) {
+					if (!replayInput(frame)) {
+						done = true;
+					}
+				}
+				else if (View::mbuttondown) {
+					POINT p;
+					GetCursorPos(&p);
+					dispatchInput(INPUT_MOUSE_MOVE, p.x, p.y);
+				}
+
+				const timer_tick_t t0 = Timer::get();
 				control();
 				draw(); 
-				SwapBuffers(hDC);
+				const timer_tick_t t1 = Timer::get();
+				{
+					PROFILE_ZONE("SwapBuffers");
+					GPUTimer::begin(GPU_PASS_SWAP);
+					SwapBuffers(hDC);
+					GPUTimer::end(GPU_PASS_SWAP);
+				}
+				GPUTimer::endFrame();
+				GLStats::endFrame();
+
+				if (InputTrace::replaying()) {
+					frame_timing f;
+					f.t = frame*frame_interval;
+					f.cpu_ms = Timer::ticksToMicroSeconds(t1 - t0)/1000.0;
+					f.gpu_ms = drawGPUMilliSeconds();
+					f.frame_ms = Timer::getMilliSeconds();
+					InputTrace::addFrameTiming(f);
+				}
+				++frame;
 	
 				double t_interval = Timer::getSeconds();
 				
@@ -1560,6 +2353,81 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 				if (wpstring_holder::getDynamicString(1) != fps_str) {
 					wpstring_holder::updateDynamicString(1, buffer);
 				}
+
+				// the per-pass numbers jitter every frame; re-uploading them
+				// each frame would just add to what we're trying to measure
+				static int hud_frame = 0;
+				if (++hud_frame >= hud_refresh_interval) {
+					hud_frame = 0;
+					for (int i = 0; i < GPU_PASS_COUNT; ++i) {
+						char gpubuf[32];
+						sprintf_s(gpubuf, 32, "GPU %-7s %7.3f ms", GPUTimer::passName(i), GPUTimer::getMilliSeconds(i));
+						wpstring_holder::updateDynamicString(HUD_GPU_STRINGS_BEGIN + i, gpubuf);
+					}
+
+					char tilebuf[32];
+					if (tile_cache_enabled) {
+						sprintf_s(tilebuf, 32, "tile cache %5.1f%% hits", 100.0*TileCache::takeHitRate());
+					}
+					else {
+						sprintf_s(tilebuf, 32, "tile cache off");
+					}
+					wpstring_holder::updateDynamicString(HUD_TILE_STRING, tilebuf);
+
+					char corrbuf[32] = "";
+					if (goniometer_enabled) {
+						sprintf_s(corrbuf, 32, "phase correlation %+.2f", Goniometer::correlation());
+					}
+					wpstring_holder::updateDynamicString(HUD_CORRELATION_STRING, corrbuf);
+
+					char spectrobuf[48] = "";
+					if (spectrogram_enabled) {
+						sprintf_s(spectrobuf, 48, "FFT %u hop %u, %u blocks queued", (unsigned)Spectrogram::fftSize(), (unsigned)Spectrogram::hop(), (unsigned)Spectrogram::queuedBlocks());
+					}
+					wpstring_holder::updateDynamicString(HUD_SPECTROGRAM_STRING, spectrobuf);
+
+					char rangebuf[48] = "";
+					range_stats view;
+					if (visibleRangeStats(&view)) {
+						sprintf_s(rangebuf, 48, "view %+.3f..%+.3f, rms %.1f dBFS", view.min/32768.0, view.max/32768.0,
+								  view.rms > 0 ? 20.0*log10(view.rms/32768.0) : -96.0);
+					}
+					wpstring_holder::updateDynamicString(HUD_RANGE_STRING, rangebuf);
+
+					char clipbuf[48] = "";
+					if (ClipIndex::regionCount()) {
+						sprintf_s(clipbuf, 48, "%u clipped samples in %u regions", (unsigned)ClipIndex::clippedSamples(), (unsigned)ClipIndex::regionCount());
+					}
+					wpstring_holder::updateDynamicString(HUD_CLIP_STRING, clipbuf);
+
+					// momentary and short-term at the middle of the view
+					char loudbuf[64] = "loudness: measuring";
+					if (Loudness::ready()) {
+						if (!loudness_reported) reportLoudness();
+						const double center = (WIN_W/2 - View::wave_x)/dx;
+						const loudness_result &r = Loudness::result();
+						sprintf_s(loudbuf, 64, "M %.1f S %.1f I %.1f LUFS, TP %+.1f dBTP", Loudness::momentary(center), Loudness::shortTerm(center),
+								  r.integrated, r.true_peak);
+					}
+					wpstring_holder::updateDynamicString(HUD_LOUDNESS_STRING, loudbuf);
+
+					if (!onsets_reported && Onsets::ready()) reportOnsets();
+
+					char alignbuf[64] = "";
+					if (reference_wav.valid()) {
+						if (!Align::ready()) {
+							sprintf_s(alignbuf, 64, "compare: lining up");
+						}
+						else {
+							if (!alignment_reported) reportAlignment();
+							if (Align::result().found) {
+								sprintf_s(alignbuf, 64, "compare %s: lag %+lld, r %.2f", compareModeName(compare_mode),
+										  Align::result().lag, Align::result().correlation);
+							}
+						}
+					}
+					wpstring_holder::updateDynamicString(HUD_ALIGN_STRING, alignbuf);
+				}
 				
 
 			}
@@ -1567,11 +2435,259 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
 	}
 
+	GPUTimer::destroy();
+	WaveShader::destroy();
+	Phosphor::destroy();
+	Goniometer::destroy();
+	Spectrogram::destroy();
+	WaveColors::destroy();
+	TileCache::destroy();
+	PostChain::destroy();
 	KillGLWindow();
-	glDeleteBuffers(1, &waveData.VBOid);
+	closeReference();
+	destroyCurrentWaveVertexBuffer();
+	JobPool::destroy();
+
+	InputTrace::stopRecording();
+	if (InputTrace::replaying()) {
+		InputTrace::writeFrameTimings("replay_timings.json");
+	}
+
+	GLStats::printReport();
+	MemStats::printReport();
+
+	Profiler::writeChromeTrace("waveplot_trace.json");
+
 	return (msg.wParam);
 }
 
+#elif defined(WAVEPLOT_HEADLESS)
+
+/*
+ * Headless render benchmark: the same draw() as the windowed build, into an
+ * offscreen EGL context (mesa llvmpipe on CI boxes). Replays a fixed pan at
+ * a series of zoom levels and reports CPU submission time, GPU time (from
+ * the timer queries) and frames/sec per level.
+ *
+ * Given a recorded input trace (see input_trace.h) as the third argument,
+ * it replays that instead and writes per-frame timings.
+ *
+ * usage (from the directory with shaders/ and textures/):
+ *	waveplot_headless [--float-samples] [--budget MiB] [--render mesh|shader|phosphor] [--no-tile-cache] [--no-elide] [--goniometer] [--spectrogram] [--band-colors] [file.wav] [results.json] [input.trace]
+ */
+
+static const int bench_warmup_frames = 10;
+static const int bench_frames_per_level = 120;
+static const float bench_pan_step = 8.0;	// world units per frame
+static const float bench_zoom_stride = 8*View::zoom_step;
+
+static void destroyHeadless() {
+
+	GPUTimer::destroy();
+	WaveShader::destroy();
+	Phosphor::destroy();
+	Goniometer::destroy();
+	Spectrogram::destroy();
+	WaveColors::destroy();
+	TileCache::destroy();
+	PostChain::destroy();
+	closeReference();
+	destroyCurrentWaveVertexBuffer();
+	JobPool::destroy();
+	Headless::destroyContext();
+
+	GLStats::printReport();
+	MemStats::printReport();
+	Profiler::writeChromeTrace("waveplot_trace.json");
+
+}
+
+static int runReplay(const std::string &trace_filename, const std::string &output_filename) {
+
+	if (!InputTrace::load(trace_filename)) {
+		return 1;
+	}
+
+	timer_tick_t frame_start = Timer::get();
+
+	for (int frame = 0; replayInput(frame); ++frame) {
+
+		const timer_tick_t t0 = Timer::get();
+		control();
+		draw();
+		const timer_tick_t t1 = Timer::get();
+
+		glFinish();
+		GPUTimer::endFrame();
+		GLStats::endFrame();
+
+		const timer_tick_t frame_end = Timer::get();
+
+		frame_timing f;
+		f.t = frame*frame_interval;
+		f.cpu_ms = Timer::ticksToMicroSeconds(t1 - t0)/1000.0;
+		f.gpu_ms = drawGPUMilliSeconds();
+		f.frame_ms = Timer::ticksToMicroSeconds(frame_end - frame_start)/1000.0;
+		InputTrace::addFrameTiming(f);
+
+		frame_start = frame_end;
+	}
+
+	return InputTrace::writeFrameTimings(output_filename) ? 0 : 1;
+
+}
+
+int main(int argc, char *argv[])
+{
+	// options first, then the positional arguments
+	std::string compare_filename;
+	int arg = 1;
+	for (; arg < argc && !strncmp(argv[arg], "--", 2); ++arg) {
+		if (!strcmp(argv[arg], "--float-samples")) resident_samples_int16 = false;
+		else if (!strcmp(argv[arg], "--no-tile-cache")) tile_cache_enabled = false;
+		else if (!strcmp(argv[arg], "--no-elide")) post_elision = false;
+		else if (!strcmp(argv[arg], "--goniometer")) goniometer_enabled = true;
+		else if (!strcmp(argv[arg], "--spectrogram")) spectrogram_enabled = true;
+		else if (!strcmp(argv[arg], "--band-colors")) band_colors_enabled = true;
+		else if (!strcmp(argv[arg], "--budget") && arg + 1 < argc) timeline_budget = (std::size_t)atoi(argv[++arg])*1024*1024;
+		else if (!strcmp(argv[arg], "--render") && arg + 1 < argc) render_mode = parseRenderMode(argv[++arg]);
+		else if (!strcmp(argv[arg], "--compare") && arg + 1 < argc) compare_filename = argv[++arg];
+	}
+	argc -= arg - 1;
+	argv += arg - 1;
+
+	if (argc > 1) input_filename = argv[1];
+	const std::string output_filename(argc > 2 ? argv[2] : "render_bench.json");
+
+	Profiler::init();
+	const JobPool::Scope job_pool;
+
+	if (!Headless::createContext(WIN_W, WIN_H)) {
+		return 1;
+	}
+	default_framebuffer = Headless::framebuffer();
+
+	if (!InitGL()) {
+		printf("InitGL failed.\n");
+		return 1;
+	}
+
+	if (!readWAVFile(input_filename)) {
+		return 1;
+	}
+
+	// the bench frames shouldn't share the workers with them
+	Loudness::wait();
+	reportLoudness();
+	Onsets::wait();
+	reportOnsets();
+
+	if (!compare_filename.empty()) {
+		if (!openReference(compare_filename)) {
+			printf("Couldn't open %s to compare with.\n", compare_filename.c_str());
+			return 1;
+		}
+		Align::wait();
+		reportAlignment();
+	}
+
+	initializeStrings();
+
+	GLuint *indices = generateIndexBufferWithSharedVertices();
+	waveData.IBOid = generateGlobalIndexBuffer(indices);
+	MemStats::release(indices);
+
+	if (argc > 3) {
+		const int ret = runReplay(argv[3], output_filename);
+		destroyHeadless();
+		return ret;
+	}
+
+	FILE *fp = fopen(output_filename.c_str(), "w");
+	if (!fp) {
+		printf("Couldn't open %s for writing.\n", output_filename.c_str());
+		return 1;
+	}
+	fprintf(fp, "{\"renderer\":\"%s\",\"render_mode\":\"%s\",\"tile_cache\":%s,\"post_elision\":%s,\"goniometer\":%s,\"spectrogram\":%s,\"band_colors\":%s,\"clipped_samples\":%u,\"clip_regions\":%u,\"integrated_lufs\":%.2f,\"true_peak_dbtp\":%.2f,\"loudness_ms\":%.3f,\"onsets\":%u,\"onsets_ms\":%.3f,\"compare\":\"%s\",\"align_lag\":%lld,\"align_ms\":%.3f,\"samples\":%u,\"frames_per_level\":%d,\"levels\":[\n",
+		Headless::renderer(), renderModeName(render_mode), tile_cache_enabled ? "true" : "false", post_elision ? "true" : "false", goniometer_enabled ? "true" : "false", spectrogram_enabled ? "true" : "false", band_colors_enabled ? "true" : "false", (unsigned)ClipIndex::clippedSamples(), (unsigned)ClipIndex::regionCount(),
+		Loudness::result().integrated, Loudness::result().true_peak, Loudness::result().milliseconds,
+		(unsigned)Onsets::count(), Onsets::milliSeconds(),
+		reference_wav.valid() ? compareModeName(compare_mode) : "none", Align::result().lag, Align::result().milliseconds, (unsigned)BUFSIZE, bench_frames_per_level);
+
+	printf("%10s %14s %14s %10s %10s\n", "zoom", "cpu ms/frame", "gpu ms/frame", "fps", "tile hits");
+
+	bool first = true;
+
+	// the zoomed out levels (envelope) a notch at a time from the whole file down, then the linear sweep
+	std::vector<float> zoom_levels;
+	for (View::zoom = View::zoom_limit; View::zoom > View::zoom_max; View::zoomIn()) {
+		zoom_levels.push_back(View::zoom);
+	}
+	// zoom_min is for the wider windows; past WIN_W + 2*z = 0 the projection turns inside out
+	for (float z = View::zoom_max; z >= View::zoom_min && WIN_W + 2*z > 0; z -= bench_zoom_stride) {
+		zoom_levels.push_back(z);
+	}
+
+	for (std::size_t level = 0; level < zoom_levels.size(); ++level) {
+
+		const float z = zoom_levels[level];
+		View::zoom = z;
+		View::wave_x = -z;	// sample 0 at the left edge
+
+		double cpu_ms = 0, gpu_ms = 0;
+		timer_tick_t level_start = Timer::get();
+
+		for (int f = 0; f < bench_warmup_frames + bench_frames_per_level; ++f) {
+
+			if (f == bench_warmup_frames) {
+				cpu_ms = gpu_ms = 0;
+				level_start = Timer::get();
+				TileCache::takeHitRate();
+			}
+
+			View::wave_x -= bench_pan_step;
+
+			const timer_tick_t t0 = Timer::get();
+			draw();
+			const timer_tick_t t1 = Timer::get();
+
+			// stands in for the swap, so fps includes the actual rendering
+			glFinish();
+			GPUTimer::endFrame();
+			GLStats::endFrame();
+
+			if (f >= bench_warmup_frames) {
+				cpu_ms += Timer::ticksToMicroSeconds(t1 - t0)/1000.0;
+				// one frame behind, which is fine since the zoom doesn't change within a level
+				gpu_ms += drawGPUMilliSeconds();
+			}
+		}
+
+		const double wall_s = Timer::ticksToMicroSeconds(Timer::get() - level_start)/1000000.0;
+		const double fps = bench_frames_per_level/wall_s;
+
+		cpu_ms /= bench_frames_per_level;
+		gpu_ms /= bench_frames_per_level;
+		const double tile_hits = TileCache::takeHitRate();
+
+		printf("%10.1f %14.3f %14.3f %10.1f %10.3f\n", z, cpu_ms, gpu_ms, fps, tile_hits);
+		fprintf(fp, "%s{\"zoom\":%.1f,\"cpu_ms\":%.4f,\"gpu_ms\":%.4f,\"fps\":%.2f,\"tile_hits\":%.4f}", first ? "" : ",\n", z, cpu_ms, gpu_ms, fps, tile_hits);
+		first = false;
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	if (spectrogram_enabled) {
+		printf("spectrogram: %u columns in %.1f ms of jobs on %u worker(s)\n",
+			(unsigned)Spectrogram::columnsComputed(), Spectrogram::computeMilliSeconds(), JobPool::threadCount());
+	}
+
+	destroyHeadless();
+
+	return 0;
+}
+
 #elif __linux__
 
 SDL_Surface* createSDLWindow() {
@@ -1608,7 +2724,7 @@ int main(int argc, char *argv[])
 	std::size_t num_samples;
 
 	// the readSampleData_int16 function actually reads the whole file.
-	float *samples = readSampleData_int16(input, &num_samples);	// presuming 16-bit, little endian
+	float *samples = readSampleData_int16(input, &num_samples, document_arena);	// presuming 16-bit, little endian
 
 	num_samples = (num_samples < BUFSIZE) ? num_samples : (std::size_t) BUFSIZE;
 
@@ -1623,8 +2739,6 @@ int main(int argc, char *argv[])
 		tmpx+=step;
 	}
 
-	delete [] samples;
-
 	SDL_Surface *screen = createSDLWindow();	// we should now have a GL context.
 	if (!screen) {
 		std::cout << "Couldn't create SDL window.";
@@ -1643,7 +2757,7 @@ int main(int argc, char *argv[])
 
 	generateWaveVertexArray(triangles, num_samples);
 
-	delete [] triangles;
+	MemStats::release(triangles);
 
 	draw();
 	SDL_GL_SwapBuffers();